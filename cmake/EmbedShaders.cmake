@@ -0,0 +1,9 @@
+# Writes the shaders in SHADERS to the header OUTPUT as raw string literals, each named after its file with a Source
+# suffix, so that the binaries carry their shaders and run from any directory.
+set(content "#pragma once\n\n// Generated from the shaders directory when building. Edit the shaders instead.\n")
+foreach(shader ${SHADERS})
+  get_filename_component(name ${shader} NAME_WE)
+  file(READ ${shader} source)
+  string(APPEND content "\nstatic constexpr char ${name}Source[] = R\"glsl(${source})glsl\";\n")
+endforeach()
+file(WRITE ${OUTPUT} "${content}")
@@ -0,0 +1,41 @@
+#version 450 core
+
+#pragma debug(on)
+
+// Reduces the depth of a frame into a pyramid, where every texel holds the farthest depth of the pixels it covers.
+// Level 0 takes the farthest sample of every pixel, every other level the farthest of the texels it covers in the
+// level below. The last row and column of a level also cover the last row and column of an odd sized level below.
+
+layout(local_size_x = 8, local_size_y = 8) in;
+
+layout(binding = 0) uniform sampler2DMS depthSamples;
+
+layout(r32f, binding = 0) readonly uniform image2D sourceLevel;
+
+layout(r32f, binding = 1) writeonly uniform image2D destinationLevel;
+
+uniform int level;
+
+void main(void) {
+  const ivec2 position = ivec2(gl_GlobalInvocationID.xy);
+  const ivec2 size = imageSize(destinationLevel);
+  if (any(greaterThanEqual(position, size))) {
+    return;
+  }
+  float farthest = 0.0;
+  if (level == 0) {
+    for (int i = 0; i < textureSamples(depthSamples); i++) {
+      farthest = max(farthest, texelFetch(depthSamples, position, i).r);
+    }
+  } else {
+    const ivec2 sourceSize = imageSize(sourceLevel);
+    const ivec2 first = 2 * position;
+    const ivec2 last = mix(first + 1, sourceSize - 1, equal(position, size - 1));
+    for (int y = first.y; y <= last.y; y++) {
+      for (int x = first.x; x <= last.x; x++) {
+        farthest = max(farthest, imageLoad(sourceLevel, ivec2(x, y)).r);
+      }
+    }
+  }
+  imageStore(destinationLevel, position, vec4(farthest));
+}
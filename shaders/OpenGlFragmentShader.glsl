@@ -1,9 +1,7 @@
-#version 460 core
+#version 450 core
 
 #pragma debug(on)
 
-uniform mat4 modelMatrix;
-uniform mat4 modelInverseTransposedMatrix;
 uniform mat4 viewMatrix;
 uniform mat4 projectionMatrix;
 
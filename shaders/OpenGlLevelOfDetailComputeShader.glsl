@@ -0,0 +1,134 @@
+#version 450 core
+
+#pragma debug(on)
+
+// Each level of detail gets its own indirect draw command. The instance indices of a level are written starting at
+// its base instance, which the vertex array uses to offset the instance index attribute.
+//
+// Instances outside of the frustum are dropped and, if the camera did not move since the last frame, so are instances
+// behind the depth of the last frame. As branches are never shed and only get wider, whatever hid an instance in the
+// last frame still hides it.
+
+const uint LevelsOfDetail = 4;
+
+// The minimum projected diameter, in pixels, for each level of detail but the last.
+const float MinimumDiameters[LevelsOfDetail - 1] = float[](24.0, 6.0, 2.0);
+
+// Below this projected area, in square pixels, the cross-section is not discernible and a billboard is used.
+const float MinimumArea = 4.0;
+
+layout(local_size_x = 64) in;
+
+struct DrawElementsIndirectCommand {
+  uint count;
+  uint instanceCount;
+  uint firstIndex;
+  int baseVertex;
+  uint baseInstance;
+};
+
+// Seven floats per instance: beginning, end, and width.
+layout(std430, binding = 0) readonly buffer Instances {
+  float instances[];
+};
+
+layout(std430, binding = 1) writeonly buffer LevelOfDetailInstances {
+  uint levelOfDetailInstances[];
+};
+
+layout(std430, binding = 2) buffer Commands {
+  DrawElementsIndirectCommand commands[LevelsOfDetail];
+};
+
+layout(std430, binding = 3) readonly buffer VisibleInstances {
+  uint visibleInstances[];
+};
+
+// The farthest depth of the last frame, as reduced by the depth pyramid program.
+layout(binding = 1) uniform sampler2D depthPyramid;
+
+// The number of instances or, when the visible instances are used, of visible instances.
+uniform uint instanceCount;
+
+// If false, every instance is a candidate, otherwise only those listed in the visible instances are.
+uniform bool useVisibleInstances;
+
+uniform bool occlusionCulling;
+
+uniform mat4 viewProjectionMatrix;
+
+uniform vec3 cameraPositionInWorld;
+
+// The number of pixels spanned by one meter at one meter from the camera.
+uniform float pixelsPerMeter;
+
+// Returns whether the box is entirely outside of the frustum or, with occlusion culling, behind the last frame.
+bool isCulled(vec3 minimum, vec3 maximum) {
+  // For each clip plane, the number of corners outside of it.
+  ivec3 below = ivec3(0);
+  ivec3 above = ivec3(0);
+  vec3 lowest = vec3(1.0);
+  vec3 highest = vec3(-1.0);
+  bool behindCamera = false;
+  for (uint i = 0; i < 8; i++) {
+    const vec3 corner = mix(minimum, maximum, vec3(i & 1, (i >> 1) & 1, (i >> 2) & 1));
+    const vec4 clip = viewProjectionMatrix * vec4(corner, 1.0);
+    below += ivec3(lessThan(clip.xyz, vec3(-clip.w)));
+    above += ivec3(greaterThan(clip.xyz, vec3(clip.w)));
+    if (clip.w <= 0.0) {
+      behindCamera = true;
+    } else {
+      lowest = min(lowest, clip.xyz / clip.w);
+      highest = max(highest, clip.xyz / clip.w);
+    }
+  }
+  if (any(equal(below, ivec3(8))) || any(equal(above, ivec3(8)))) {
+    return true;
+  }
+  if (!occlusionCulling || behindCamera) {
+    return false;
+  }
+  // The pixels covered by the box span at most two texels in each direction at this level of the pyramid.
+  const vec2 size = vec2(textureSize(depthPyramid, 0));
+  const vec2 lowestPixel = clamp((0.5 * lowest.xy + 0.5) * size, vec2(0.0), size - 1.0);
+  const vec2 highestPixel = clamp((0.5 * highest.xy + 0.5) * size, vec2(0.0), size - 1.0);
+  const vec2 extent = highestPixel - lowestPixel;
+  const int level = min(int(ceil(log2(max(max(extent.x, extent.y), 1.0)))), textureQueryLevels(depthPyramid) - 1);
+  // Every level halves the size of the one below, rounding down.
+  const ivec2 levelSize = max(ivec2(size) >> level, ivec2(1));
+  const ivec2 first = min(ivec2(lowestPixel) >> level, levelSize - 1);
+  const ivec2 last = min(ivec2(highestPixel) >> level, levelSize - 1);
+  float farthest = 0.0;
+  for (int y = first.y; y <= last.y; y++) {
+    for (int x = first.x; x <= last.x; x++) {
+      farthest = max(farthest, texelFetch(depthPyramid, ivec2(x, y), level).r);
+    }
+  }
+  return 0.5 * lowest.z + 0.5 > farthest;
+}
+
+void main(void) {
+  if (gl_GlobalInvocationID.x >= instanceCount) {
+    return;
+  }
+  const uint index = useVisibleInstances ? visibleInstances[gl_GlobalInvocationID.x] : gl_GlobalInvocationID.x;
+  const uint base = 7 * index;
+  const vec3 beginning = vec3(instances[base + 0], instances[base + 1], instances[base + 2]);
+  const vec3 end = vec3(instances[base + 3], instances[base + 4], instances[base + 5]);
+  const float width = instances[base + 6];
+  if (isCulled(min(beginning, end) - width, max(beginning, end) + width)) {
+    return;
+  }
+  const float cameraDistance = max(distance(cameraPositionInWorld, 0.5 * (beginning + end)), 1.0e-3);
+  const float diameter = 2.0 * width * pixelsPerMeter / cameraDistance;
+  const float length = distance(beginning, end) * pixelsPerMeter / cameraDistance;
+  uint level = 0;
+  while (level < LevelsOfDetail - 1 && diameter < MinimumDiameters[level]) {
+    level++;
+  }
+  if (diameter * length < MinimumArea) {
+    level = LevelsOfDetail - 1;
+  }
+  const uint slot = atomicAdd(commands[level].instanceCount, 1);
+  levelOfDetailInstances[commands[level].baseInstance + slot] = index;
+}
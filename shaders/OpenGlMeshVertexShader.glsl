@@ -0,0 +1,24 @@
+#version 450 core
+
+#pragma debug(on)
+
+uniform vec4 vertexColor;
+
+uniform mat4 viewMatrix;
+uniform mat4 projectionMatrix;
+
+// Vertices are already in world space.
+in vec3 vertexPosition;
+in vec3 vertexNormal;
+
+out vec4 pInWorld;
+out vec4 nInWorld;
+
+out vec4 fragmentColor;
+
+void main(void) {
+  pInWorld = vec4(vertexPosition, 1.0);
+  nInWorld = vec4(normalize(vertexNormal), 0.0);
+  gl_Position = projectionMatrix * viewMatrix * pInWorld;
+  fragmentColor = vertexColor;
+}
@@ -1,11 +1,9 @@
-#version 460 core
+#version 450 core
 
 #pragma debug(on)
 
 uniform vec4 vertexColor;
 
-uniform mat4 modelMatrix;
-uniform mat4 modelInverseTransposedMatrix;
 uniform mat4 viewMatrix;
 uniform mat4 projectionMatrix;
 
@@ -18,14 +16,62 @@ uniform float ambientLightIntensity;
 in vec3 vertexPosition;
 in vec3 vertexNormal;
 
+// The index of the instance, written by the level of detail selection.
+in uint instanceIndex;
+
+// Seven floats per instance: beginning, end, and width.
+layout(std430, binding = 0) readonly buffer Instances {
+  float instances[];
+};
+
 out vec4 pInWorld;
 out vec4 nInWorld;
 
 out vec4 fragmentColor;
 
+// Returns the rotation which aligns the Y axis with the specified direction.
+// Uses the formulation proposed in https://math.stackexchange.com/questions/180418/.
+mat3 getAlignmentMatrix(vec3 direction) {
+  const vec3 a = vec3(0.0, 1.0, 0.0);
+  const vec3 b = normalize(direction);
+  const float c = dot(a, b);
+  // If the vector is almost aligned or reversed, do nothing.
+  if (abs(c) > (1.0 - 1.0e-6)) {
+    return mat3(1.0);
+  }
+  const vec3 v = cross(a, b);
+  const mat3 skewSymmetric = mat3(0.0, v.z, -v.y, -v.z, 0.0, v.x, v.y, -v.x, 0.0);
+  return mat3(1.0) + skewSymmetric + skewSymmetric * skewSymmetric / (1.0 + c);
+}
+
+// Returns the rotation which aligns the Y axis with the specified direction and turns the Z axis towards the camera.
+// Billboards lie on the XY plane, so they face the camera. Cylinders look the same under any rotation about their axis.
+mat3 getFacingMatrix(vec3 direction, vec3 center) {
+  const vec3 y = normalize(direction);
+  const vec3 toCamera = cameraPositionInWorld - center;
+  const vec3 z = toCamera - dot(toCamera, y) * y;
+  // If the camera is almost on the axis, any rotation about it works.
+  if (length(z) < 1.0e-6 * length(toCamera)) {
+    return getAlignmentMatrix(direction);
+  }
+  const vec3 normalizedZ = normalize(z);
+  return mat3(cross(y, normalizedZ), y, normalizedZ);
+}
+
 void main(void) {
-  pInWorld = modelMatrix * vec4(vertexPosition, 1.0);
-  nInWorld = normalize(modelInverseTransposedMatrix * vec4(vertexNormal, 0.0));
+  const uint base = 7 * instanceIndex;
+  const vec3 instanceBeginning = vec3(instances[base + 0], instances[base + 1], instances[base + 2]);
+  const vec3 instanceEnd = vec3(instances[base + 3], instances[base + 4], instances[base + 5]);
+  const float instanceWidth = instances[base + 6];
+  // The cylinder is 2 meters high and has 1 meter radius. Its center is at the origin.
+  // Scale it on Y to get the right length, rotate it so that the orientation is correct, and translate it so that the centers match.
+  const vec3 axis = instanceEnd - instanceBeginning;
+  const vec3 scale = vec3(instanceWidth, length(axis) / 2.0, instanceWidth);
+  const vec3 center = instanceBeginning + 0.5 * axis;
+  const mat3 rotation = getFacingMatrix(axis, center);
+  pInWorld = vec4(rotation * (scale * vertexPosition) + center, 1.0);
+  // As the rotation is orthonormal, the inverse transpose of the model matrix is the rotation with the inverse scale.
+  nInWorld = vec4(normalize(rotation * (vertexNormal / scale)), 0.0);
   gl_Position = projectionMatrix * viewMatrix * pInWorld;
   fragmentColor = vertexColor;
 }
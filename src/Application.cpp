@@ -1,39 +1,86 @@
+#include <algorithm>
+#include <deque>
+#include <fstream>
 #include <iomanip>
 #include <iostream>
+#include <limits>
+#include <memory>
 #include <optional>
+#include <stdexcept>
+#include <thread>
 
 #include "Environment.hpp"
+#include "FrameEncoder.hpp"
 #include "Image.hpp"
 #include "OpenGlWindow.hpp"
 #include "Random.hpp"
+#include "SimulationThread.hpp"
+#include "Trace.hpp"
 #include "Tree.hpp"
+#include "TreeSnapshot.hpp"
+#include "VideoSink.hpp"
 
 enum class Mode { Standard, Image, Video };
 
 static constexpr U32 TargetMetamers = 5 * 1000;
 
-void saveFramebuffer(const std::string &filename) {
-  std::vector<uint8_t> imageData(OpenGlWindow::DefaultWindowSide * OpenGlWindow::DefaultWindowSide * 3);
-  glReadBuffer(GL_BACK);
-  glReadPixels(0, 0, OpenGlWindow::DefaultWindowSide, OpenGlWindow::DefaultWindowSide, GL_RGB, GL_UNSIGNED_BYTE, imageData.data());
-  std::reverse(std::begin(imageData), std::end(imageData));
-  Image image(imageData, OpenGlWindow::DefaultWindowSide, OpenGlWindow::DefaultWindowSide);
+static constexpr double VideoFramesPerSecond = 30.0;
+
+static std::string getNextArgument(int argc, char *argv[], int &i) {
+  const auto option = std::string(argv[i]);
+  i++;
+  if (i >= argc) {
+    throw std::invalid_argument("Missing value for " + option + ".");
+  }
+  return std::string(argv[i]);
+}
+
+/**
+ * Parses a side of the viewport given to the option, which must be a positive number of pixels.
+ */
+static U32 parseSide(const std::string &option, const std::string &value) {
+  const auto side = std::stoll(value);
+  if (side < 1 || side > std::numeric_limits<I32>::max()) {
+    throw std::invalid_argument("Invalid value for " + option + ": " + value + ".");
+  }
+  return static_cast<U32>(side);
+}
+
+void saveFramebuffer(OpenGlWindow &openGlWindow, const std::string &filename) {
+  TraceScope traceScope("saveFramebuffer", "io");
+  std::vector<uint8_t> imageData;
+  {
+    TraceScope readbackTraceScope("glReadPixels", "io");
+    imageData = openGlWindow.readPixels();
+  }
+  Image image(imageData, openGlWindow.getViewportWidth(), openGlWindow.getViewportHeight());
+  {
+    TraceScope flipTraceScope("Image::flipVertically", "io");
+    image.flipVertically();
+  }
+  TraceScope writeTraceScope("Image::writeToFile", "io");
   image.writeToFile(filename);
 }
 
 int main(int argc, char *argv[]) {
-  if (!glfwInit()) {
-    std::cerr << "Failed to initialize GLFW." << '\n';
-    return 1;
-  }
   Mode mode = Mode::Standard;
   std::optional<BoundingBox> userSpecifiedBoundingBox;
+  std::string statisticsFilename;
+  std::string traceFilename;
+  bool drawTubes = false;
+  auto markerGeneration = MarkerGeneration::Sequential;
+  std::string videoFilename;
+  U32 width = OpenGlWindow::DefaultWindowSide;
+  U32 height = OpenGlWindow::DefaultWindowSide;
   for (int i = 0; i < argc; i++) {
     const auto argument = std::string(argv[i]);
     if (argument == "--image") {
       mode = Mode::Image;
     } else if (argument == "--video") {
       mode = Mode::Video;
+    } else if (argument == "--video-file") {
+      mode = Mode::Video;
+      videoFilename = getNextArgument(argc, argv, i);
     } else if (argument == "--bounding-box") {
       std::stringstream values;
       for (int j = 0; j < 6; j++) {
@@ -44,50 +91,121 @@ int main(int argc, char *argv[]) {
         values << argv[i];
       }
       userSpecifiedBoundingBox = BoundingBox(values.str());
+    } else if (argument == "--statistics") {
+      statisticsFilename = getNextArgument(argc, argv, i);
+    } else if (argument == "--trace") {
+      traceFilename = getNextArgument(argc, argv, i);
+      Trace::enable();
+    } else if (argument == "--tubes") {
+      drawTubes = true;
+    } else if (argument == "--resolution") {
+      width = parseSide(argument, getNextArgument(argc, argv, i));
+      height = parseSide(argument, getNextArgument(argc, argv, i));
+    } else if (argument == "--marker-generation") {
+      markerGeneration = getMarkerGenerationForName(getNextArgument(argc, argv, i));
     }
   }
+  std::ofstream statisticsStream;
+  if (!statisticsFilename.empty()) {
+    statisticsStream.open(statisticsFilename);
+    if (statisticsStream.fail()) {
+      std::cerr << "Could not open " << statisticsFilename << "." << '\n';
+      return 1;
+    }
+  }
+  // Images and videos need no display, so they are rendered off-screen when possible.
+  const auto offscreen = mode != Mode::Standard && OpenGlWindow::OffscreenRenderingSupported;
+  if (!offscreen && !glfwInit()) {
+    std::cerr << "Failed to initialize GLFW." << '\n';
+    return 1;
+  }
   const auto begin = std::chrono::steady_clock::now();
   SplitMixGenerator splitMixGenerator;
-  MarkerSet markerSet(splitMixGenerator, 2.0f, 10, 1000 * 1000);
-  Environment environment(splitMixGenerator, markerSet);
+  MarkerSet markerSet(splitMixGenerator, 2.0f, 10, 1000 * 1000, markerGeneration);
+  Environment environment(splitMixGenerator, markerSet, GrowthParameters{});
   Tree tree(environment, Point{});
-  OpenGlWindow openGlWindow;
-  U64 frameIndex = 0;
-  while (!openGlWindow.shouldClose()) {
-    const auto metamerCount = tree.countMetamers();
+  if (statisticsStream.is_open()) {
+    tree.statisticsStream = &statisticsStream;
+  }
+  auto openGlWindowPointer = std::make_unique<OpenGlWindow>(width, height, offscreen);
+  auto &openGlWindow = *openGlWindowPointer;
+  std::shared_ptr<const TreeSnapshot> snapshot;
+  const auto drawTree = [&openGlWindow, &snapshot, &userSpecifiedBoundingBox, drawTubes]() {
     openGlWindow.startDrawing();
     if (userSpecifiedBoundingBox) {
       openGlWindow.setCameraForBoundingBox(userSpecifiedBoundingBox.value());
     } else {
-      openGlWindow.setCameraForBoundingBox(tree.getBoundingBox());
+      openGlWindow.setCameraForBoundingBox(snapshot->boundingBox);
     }
-    if (mode == Mode::Standard || mode == Mode::Video) {
-      openGlWindow.drawTree(tree);
-    }
-    if (metamerCount < TargetMetamers) {
-      tree.performGrowthIteration();
+    if (drawTubes) {
+      openGlWindow.drawTreeAsTubes(*snapshot);
     } else {
-      if (mode == Mode::Image) {
-        openGlWindow.drawTree(tree);
-        const std::chrono::duration<float> duration = std::chrono::steady_clock::now() - begin;
-        std::cout << "Duration: " << std::setprecision(3) << duration.count() << " s" << '\n';
-        saveFramebuffer("image.png");
-      }
-      if (mode == Mode::Image || mode == Mode::Video) {
-        openGlWindow.setShouldClose();
-      }
+      openGlWindow.drawTree(*snapshot);
+    }
+  };
+  U64 frameIndex = 0;
+  // Video frames are read back asynchronously and encoded in the background, in the order they were drawn.
+  std::unique_ptr<VideoSink> videoSink;
+  if (!videoFilename.empty()) {
+    videoSink = std::make_unique<VideoSink>(videoFilename, openGlWindow.getViewportWidth(), openGlWindow.getViewportHeight(), VideoFramesPerSecond);
+    std::cout << "Writing " << videoFilename << " with " << videoSink->getCodec() << '\n';
+  }
+  const auto encoderThreads = std::max(1U, std::thread::hardware_concurrency()) - 1;
+  FrameEncoder frameEncoder(encoderThreads, 2 * std::max(1U, encoderThreads), videoSink.get());
+  std::deque<std::string> requestedFrameFilenames;
+  const auto encodeFrames = [&](U64 maximumPendingFrames) {
+    while (!requestedFrameFilenames.empty() && (requestedFrameFilenames.size() > maximumPendingFrames || openGlWindow.arePixelsReady())) {
+      const auto width = openGlWindow.getViewportWidth();
+      const auto height = openGlWindow.getViewportHeight();
+      frameEncoder.submit(Frame{openGlWindow.takePixels(), static_cast<U32>(width), static_cast<U32>(height), requestedFrameFilenames.front()});
+      requestedFrameFilenames.pop_front();
+    }
+  };
+  // The tree grows on its own thread, so a slow growth iteration never blocks drawing and vsync never slows growth.
+  // Videos need a frame for every growth iteration, so growth waits for them to be drawn.
+  SimulationThread simulationThread(tree, TargetMetamers, drawTubes, mode == Mode::Video);
+  if (mode == Mode::Image) {
+    while (auto next = simulationThread.waitForSnapshot()) {
+      snapshot = std::move(next);
+    }
+    drawTree();
+    const std::chrono::duration<float> duration = std::chrono::steady_clock::now() - begin;
+    std::cout << "Duration: " << std::setprecision(3) << duration.count() << " s" << '\n';
+    saveFramebuffer(openGlWindow, "image.png");
+    openGlWindow.setShouldClose();
+  }
+  while (!openGlWindow.shouldClose()) {
+    TraceScope frameTraceScope("frame", "application");
+    auto next = mode == Mode::Video ? simulationThread.waitForSnapshot() : simulationThread.takeSnapshot();
+    if (next) {
+      snapshot = std::move(next);
+    } else if (mode == Mode::Video) {
+      break;
     }
+    drawTree();
     if (mode == Mode::Video) {
       frameIndex++;
       std::stringstream frameNumber;
       frameNumber << std::setfill('0') << std::setw(5) << frameIndex;
-      saveFramebuffer("video/frame-" + frameNumber.str() + ".png");
+      encodeFrames(OpenGlWindow::PixelPackBufferCount - 1);
+      openGlWindow.requestPixels();
+      requestedFrameFilenames.push_back("video/frame-" + frameNumber.str() + ".png");
     }
     openGlWindow.swapBuffers();
     openGlWindow.pollEvents();
   }
+  simulationThread.stop();
+  encodeFrames(0);
+  frameEncoder.finish();
   std::cout << "Tree bounding box: " << tree.getBoundingBox().toString() << '\n';
   std::cout << "Metamers: " << tree.countMetamers() << '\n';
-  glfwTerminate();
+  if (!traceFilename.empty()) {
+    Trace::writeChromeJson(traceFilename);
+  }
+  // The window must be destroyed before GLFW is terminated.
+  openGlWindowPointer.reset();
+  if (!offscreen) {
+    glfwTerminate();
+  }
   return 0;
 }
@@ -0,0 +1,280 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <mutex>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "BoundingBox.hpp"
+#include "Environment.hpp"
+#include "GrowthStatistics.hpp"
+#include "MarkerFieldCache.hpp"
+#include "SimulationSettings.hpp"
+#include "SweepSpecification.hpp"
+#include "Trace.hpp"
+#include "Tree.hpp"
+
+class SimulationResult {
+public:
+  U64 metamers{};
+  U64 iterations{};
+  BoundingBox boundingBox{};
+  float markerFieldSeconds{};
+  float setupSeconds{};
+  float growthSeconds{};
+  float totalSeconds{};
+  GrowthStatistics growthStatistics{};
+  std::string error;
+};
+
+static std::string getNextArgument(int argc, char *argv[], int &i) {
+  const auto option = std::string(argv[i]);
+  i++;
+  if (i >= argc) {
+    throw std::invalid_argument("Missing value for " + option + ".");
+  }
+  return std::string(argv[i]);
+}
+
+static float secondsSince(std::chrono::steady_clock::time_point begin) {
+  const std::chrono::duration<float> duration = std::chrono::steady_clock::now() - begin;
+  return duration.count();
+}
+
+/**
+ * Releases a marker field of the cache once the simulation no longer needs it, or when the simulation fails, so that
+ * failed simulations do not keep the field in memory for the rest of the batch.
+ */
+class MarkerFieldUse {
+  MarkerFieldCache &markerFieldCache;
+  const MarkerFieldSettings &settings;
+  bool released = false;
+
+public:
+  MarkerFieldUse(MarkerFieldCache &markerFieldCache, const MarkerFieldSettings &settings)
+      : markerFieldCache(markerFieldCache), settings(settings) {
+  }
+
+  MarkerFieldUse(const MarkerFieldUse &) = delete;
+  MarkerFieldUse &operator=(const MarkerFieldUse &) = delete;
+
+  ~MarkerFieldUse() {
+    release();
+  }
+
+  void release() {
+    if (!released) {
+      released = true;
+      markerFieldCache.release(settings);
+    }
+  }
+};
+
+static SimulationResult runSimulation(const SimulationSettings &settings, MarkerFieldCache &markerFieldCache) {
+  SimulationResult result;
+  const auto begin = std::chrono::steady_clock::now();
+  MarkerFieldUse markerFieldUse(markerFieldCache, settings.markerField);
+  auto markerField = markerFieldCache.acquire(settings.markerField);
+  result.markerFieldSeconds = secondsSince(begin);
+  const auto setupBegin = std::chrono::steady_clock::now();
+  // The shared field is immutable, each simulation removes markers from its own copy.
+  Environment environment(markerField->splitMixGenerator, markerField->markerSet, settings.growthParameters);
+  markerField.reset();
+  markerFieldUse.release();
+  Tree tree(environment, Point{});
+  tree.collectStatistics = true;
+  result.setupSeconds = secondsSince(setupBegin);
+  const auto growthBegin = std::chrono::steady_clock::now();
+  result.metamers = tree.countMetamers();
+  while (result.metamers < settings.targetMetamers) {
+    tree.performGrowthIteration();
+    result.growthStatistics.add(tree.statistics);
+    result.iterations++;
+    const auto previousMetamers = result.metamers;
+    result.metamers = tree.countMetamers();
+    if (result.metamers == previousMetamers) {
+      break;
+    }
+  }
+  result.growthSeconds = secondsSince(growthBegin);
+  result.boundingBox = tree.getBoundingBox();
+  result.totalSeconds = secondsSince(begin);
+  return result;
+}
+
+/**
+ * Quotes the text as a CSV field, doubling the double quotes in it.
+ */
+static std::string quoteCsv(const std::string &text) {
+  std::string quoted = "\"";
+  for (const auto c : text) {
+    if (c == '"') {
+      quoted += '"';
+    }
+    quoted += c;
+  }
+  return quoted + '"';
+}
+
+/**
+ * Quotes the text as a JSON string, escaping double quotes, backslashes, and control characters.
+ */
+static std::string quoteJson(const std::string &text) {
+  std::string quoted = "\"";
+  for (const auto c : text) {
+    if (c == '"' || c == '\\') {
+      quoted += '\\';
+      quoted += c;
+    } else if (c == '\n') {
+      quoted += "\\n";
+    } else if (c == '\t') {
+      quoted += "\\t";
+    } else if (static_cast<U8>(c) < 0x20) {
+      std::stringstream escape;
+      escape << "\\u" << std::hex << std::setw(4) << std::setfill('0') << static_cast<U32>(static_cast<U8>(c));
+      quoted += escape.str();
+    } else {
+      quoted += c;
+    }
+  }
+  return quoted + '"';
+}
+
+static void writeCsv(const std::string &filename, const std::vector<SimulationSettings> &simulations, const std::vector<SimulationResult> &results) {
+  std::ofstream stream(filename);
+  if (stream.fail()) {
+    throw std::runtime_error("Could not open " + filename + ".");
+  }
+  stream << "simulation,seed,side-length,resolution,markers,target-metamers";
+  for (const auto &name : GrowthParameters::getNames()) {
+    stream << ',' << name;
+  }
+  stream << ",metamers,iterations,x-minimum,x-maximum,y-minimum,y-maximum,z-minimum,z-maximum";
+  stream << ",marker-field-seconds,setup-seconds,growth-seconds,total-seconds";
+  stream << ",allocation-seconds,light-propagation-seconds,resource-propagation-seconds,shoot-creation-seconds,marker-removal-seconds,width-update-seconds";
+  stream << ",error" << '\n';
+  for (std::size_t i = 0; i < simulations.size(); i++) {
+    const auto &settings = simulations[i];
+    const auto &result = results[i];
+    stream << i << ',' << settings.markerField.seed << ',' << settings.markerField.sideLength << ',' << settings.markerField.resolution << ',';
+    stream << settings.markerField.markerCount << ',' << settings.targetMetamers;
+    for (const auto &name : GrowthParameters::getNames()) {
+      stream << ',' << settings.growthParameters.get(name);
+    }
+    const auto &box = result.boundingBox;
+    stream << ',' << result.metamers << ',' << result.iterations;
+    stream << ',' << box.xRange.minimum << ',' << box.xRange.maximum << ',' << box.yRange.minimum << ',' << box.yRange.maximum;
+    stream << ',' << box.zRange.minimum << ',' << box.zRange.maximum;
+    stream << ',' << result.markerFieldSeconds << ',' << result.setupSeconds << ',' << result.growthSeconds << ',' << result.totalSeconds;
+    const auto &growth = result.growthStatistics;
+    stream << ',' << growth.allocation.seconds << ',' << growth.lightPropagation.seconds << ',' << growth.resourcePropagation.seconds;
+    stream << ',' << growth.shootCreation.seconds << ',' << growth.markerRemoval.seconds << ',' << growth.widthUpdate.seconds;
+    // Errors can hold paths given by the user, so they are quoted.
+    stream << ',' << quoteCsv(result.error) << '\n';
+  }
+}
+
+static void writeJson(const std::string &filename, const std::vector<SimulationSettings> &simulations, const std::vector<SimulationResult> &results) {
+  std::ofstream stream(filename);
+  if (stream.fail()) {
+    throw std::runtime_error("Could not open " + filename + ".");
+  }
+  stream << "[\n";
+  for (std::size_t i = 0; i < simulations.size(); i++) {
+    const auto &settings = simulations[i];
+    const auto &result = results[i];
+    stream << "  {\"simulation\": " << i << ", \"seed\": " << settings.markerField.seed;
+    stream << ", \"side-length\": " << settings.markerField.sideLength << ", \"resolution\": " << settings.markerField.resolution;
+    stream << ", \"markers\": " << settings.markerField.markerCount << ", \"target-metamers\": " << settings.targetMetamers;
+    for (const auto &name : GrowthParameters::getNames()) {
+      stream << ", \"" << name << "\": " << settings.growthParameters.get(name);
+    }
+    const auto &box = result.boundingBox;
+    stream << ", \"metamers\": " << result.metamers << ", \"iterations\": " << result.iterations;
+    stream << ", \"bounding-box\": [" << box.xRange.minimum << ", " << box.xRange.maximum << ", " << box.yRange.minimum << ", " << box.yRange.maximum;
+    stream << ", " << box.zRange.minimum << ", " << box.zRange.maximum << "]";
+    stream << ", \"seconds\": {\"marker-field\": " << result.markerFieldSeconds << ", \"setup\": " << result.setupSeconds;
+    stream << ", \"growth\": " << result.growthSeconds << ", \"total\": " << result.totalSeconds << "}";
+    stream << ", \"growth-statistics\": " << result.growthStatistics.toJson();
+    stream << ", \"error\": " << quoteJson(result.error) << "}";
+    stream << (i + 1 < simulations.size() ? ",\n" : "\n");
+  }
+  stream << "]\n";
+}
+
+/**
+ * Runs every simulation of a parameter sweep, spread across a bounded number of threads.
+ *
+ * Each thread runs one simulation at a time, so at most one tree and one marker set copy exist per thread. Marker fields
+ * are generated once and shared between the simulations which use the same seed and field settings.
+ */
+int main(int argc, char *argv[]) {
+  std::string specificationFilename;
+  std::string outputPrefix = "batch";
+  std::string traceFilename;
+  std::string markerCacheDirectory;
+  U64 jobs = std::max(1U, std::thread::hardware_concurrency());
+  for (int i = 1; i < argc; i++) {
+    const auto argument = std::string(argv[i]);
+    if (argument == "--jobs") {
+      jobs = std::max(1ULL, std::stoull(getNextArgument(argc, argv, i)));
+    } else if (argument == "--output") {
+      outputPrefix = getNextArgument(argc, argv, i);
+    } else if (argument == "--marker-cache") {
+      markerCacheDirectory = getNextArgument(argc, argv, i);
+    } else if (argument == "--trace") {
+      traceFilename = getNextArgument(argc, argv, i);
+      Trace::enable();
+    } else if (specificationFilename.empty()) {
+      specificationFilename = argument;
+    } else {
+      std::cerr << "Unknown argument: " << argument << '\n';
+      return 1;
+    }
+  }
+  if (specificationFilename.empty()) {
+    std::cerr << "Usage: " << argv[0] << " [--jobs N] [--output PREFIX] [--marker-cache DIRECTORY] [--trace FILE] SPECIFICATION" << '\n';
+    return 1;
+  }
+  const auto simulations = SweepSpecification::fromFile(specificationFilename).expand();
+  std::vector<SimulationResult> results(simulations.size());
+  MarkerFieldCache markerFieldCache(simulations, markerCacheDirectory);
+  std::atomic<std::size_t> nextSimulation{0};
+  std::atomic<std::size_t> finishedSimulations{0};
+  std::mutex outputMutex;
+  const auto work = [&]() {
+    for (auto i = nextSimulation++; i < simulations.size(); i = nextSimulation++) {
+      TraceScope traceScope("runSimulation", "batch");
+      try {
+        results[i] = runSimulation(simulations[i], markerFieldCache);
+      } catch (const std::exception &exception) {
+        results[i].error = exception.what();
+      }
+      const auto finished = ++finishedSimulations;
+      std::lock_guard<std::mutex> lock(outputMutex);
+      std::cout << "Finished simulation " << i << " (" << finished << "/" << simulations.size() << ") in " << results[i].totalSeconds << " s";
+      std::cout << ", " << results[i].metamers << " metamers" << '\n';
+    }
+  };
+  const auto begin = std::chrono::steady_clock::now();
+  std::vector<std::thread> threads;
+  for (U64 i = 0; i < std::min<U64>(jobs, simulations.size()); i++) {
+    threads.emplace_back(work);
+  }
+  for (auto &thread : threads) {
+    thread.join();
+  }
+  std::cout << "Ran " << simulations.size() << " simulations in " << secondsSince(begin) << " s" << '\n';
+  writeCsv(outputPrefix + ".csv", simulations, results);
+  writeJson(outputPrefix + ".json", simulations, results);
+  if (!traceFilename.empty()) {
+    Trace::writeChromeJson(traceFilename);
+  }
+  return 0;
+}
@@ -0,0 +1,350 @@
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <numeric>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "Camera.hpp"
+#include "Environment.hpp"
+#include "GrowthParameters.hpp"
+#include "MarkerField.hpp"
+#include "RayTracer.hpp"
+#include "Tree.hpp"
+#include "TreeSnapshot.hpp"
+#include "TubeMeshBuilder.hpp"
+
+#ifdef BENCHMARK_RENDERING
+#include "OpenGlWindow.hpp"
+#endif
+
+// The side of the images rendered when timing the ray tracer.
+static constexpr U32 RayTracedSide = 256;
+
+/**
+ * A query made by a bud during a growth iteration.
+ */
+class BudQuery {
+public:
+  BudId budId{};
+  Point origin{};
+  Vector direction{};
+  float r{};
+};
+
+class BenchmarkScenario {
+public:
+  U64 markers{};
+  U64 resolution{};
+  U64 targetMetamers{};
+};
+
+class BenchmarkResult {
+public:
+  std::string name;
+  BenchmarkScenario scenario{};
+  U64 metamers{};
+  U64 operations{};
+  std::vector<double> seconds;
+};
+
+/**
+ * Exposes the passes of a growth iteration, which are private to Tree.
+ */
+class TreeBenchmark {
+public:
+  static void allocateMarkers(Tree &tree) {
+    tree.environment.markerSet.resetAllocations();
+    tree.allocateMarkers(tree.root);
+  }
+
+  static void propagateLightBasipetally(Tree &tree) {
+    tree.propagateLightBasipetally(tree.root);
+  }
+
+  static void propagateResourcesAcropetally(Tree &tree) {
+    tree.root->growthResource = tree.environment.parameters.borchertHondaAlpha * tree.root->light;
+    tree.propagateResourcesAcropetally(tree.root);
+  }
+
+  static void appendNewShoots(Tree &tree) {
+    tree.performGrowthIteration(tree.root);
+  }
+
+  static void updateInternodeWidths(Tree &tree) {
+    tree.updateInternodeWidths(tree.root, tree.countMetamers());
+  }
+};
+
+/**
+ * Owns an environment and a tree grown in it up to the scenario size, starting from a shared marker field.
+ */
+class GrownTree {
+public:
+  Environment environment;
+  Tree tree;
+
+  GrownTree(const MarkerField &markerField, U64 targetMetamers)
+      : environment(markerField.splitMixGenerator, markerField.markerSet, GrowthParameters{}), tree(environment, Point{}) {
+    auto metamers = tree.countMetamers();
+    while (metamers < targetMetamers) {
+      tree.performGrowthIteration();
+      const auto previousMetamers = metamers;
+      metamers = tree.countMetamers();
+      if (metamers == previousMetamers) {
+        break;
+      }
+    }
+  }
+};
+
+static std::string getNextArgument(int argc, char *argv[], int &i) {
+  const auto option = std::string(argv[i]);
+  i++;
+  if (i >= argc) {
+    throw std::invalid_argument("Missing value for " + option + ".");
+  }
+  return std::string(argv[i]);
+}
+
+static void collectBudQueries(const GrowthParameters &parameters, const std::unique_ptr<Metamer> &metamer, std::vector<BudQuery> &queries) {
+  if (!metamer) {
+    return;
+  }
+  const auto r = parameters.perceptionRadiusFactor * metamer->getLength();
+  if (!metamer->axillary) {
+    queries.push_back(BudQuery{metamer->axillaryId, metamer->end, metamer->axillaryDirection, r});
+  }
+  if (!metamer->terminal) {
+    queries.push_back(BudQuery{metamer->terminalId, metamer->end, Vector(metamer->beginning, metamer->end), r});
+  }
+  collectBudQueries(parameters, metamer->axillary, queries);
+  collectBudQueries(parameters, metamer->terminal, queries);
+}
+
+static void collectOccupiedSpheres(const GrowthParameters &parameters, const std::unique_ptr<Metamer> &metamer, std::vector<std::pair<Point, float>> &spheres) {
+  if (!metamer) {
+    return;
+  }
+  spheres.emplace_back(metamer->end, parameters.occupancyRadiusFactor * metamer->getLength());
+  collectOccupiedSpheres(parameters, metamer->axillary, spheres);
+  collectOccupiedSpheres(parameters, metamer->terminal, spheres);
+}
+
+/**
+ * Times a function, calling the untimed setup function before every repetition.
+ */
+template <typename Setup, typename Function>
+static std::vector<double> measure(U64 repetitions, Setup setup, Function function) {
+  std::vector<double> seconds;
+  for (U64 i = 0; i < repetitions; i++) {
+    setup();
+    const auto begin = std::chrono::steady_clock::now();
+    function();
+    const std::chrono::duration<double> duration = std::chrono::steady_clock::now() - begin;
+    seconds.push_back(duration.count());
+  }
+  return seconds;
+}
+
+static double getMedian(std::vector<double> values) {
+  std::sort(std::begin(values), std::end(values));
+  const auto middle = values.size() / 2;
+  if (values.size() % 2 == 0) {
+    return 0.5 * (values[middle - 1] + values[middle]);
+  }
+  return values[middle];
+}
+
+static void writeJson(const std::string &filename, const std::vector<BenchmarkResult> &results) {
+  std::ofstream stream(filename);
+  if (stream.fail()) {
+    throw std::runtime_error("Could not open " + filename + ".");
+  }
+  stream << std::setprecision(9);
+  stream << "{\n  \"benchmarks\": [\n";
+  for (std::size_t i = 0; i < results.size(); i++) {
+    const auto &result = results[i];
+    const auto minimum = *std::min_element(std::begin(result.seconds), std::end(result.seconds));
+    const auto mean = std::accumulate(std::begin(result.seconds), std::end(result.seconds), 0.0) / result.seconds.size();
+    stream << "    {\"name\": \"" << result.name << "\", \"markers\": " << result.scenario.markers;
+    stream << ", \"resolution\": " << result.scenario.resolution << ", \"target-metamers\": " << result.scenario.targetMetamers;
+    stream << ", \"metamers\": " << result.metamers << ", \"operations\": " << result.operations;
+    stream << ", \"repetitions\": " << result.seconds.size() << ", \"seconds\": {\"minimum\": " << minimum;
+    stream << ", \"median\": " << getMedian(result.seconds) << ", \"mean\": " << mean << "}}";
+    stream << (i + 1 < results.size() ? ",\n" : "\n");
+  }
+  stream << "  ]\n}\n";
+}
+
+/**
+ * Runs fixed-seed benchmarks of the marker queries, of each growth pass, and of the full growth iteration.
+ *
+ * Every combination of marker count, grid resolution, and tree size is a scenario. Results are written as JSON so that
+ * optimizations can be compared against a baseline.
+ */
+int main(int argc, char *argv[]) {
+  std::string outputFilename = "bench.json";
+  U64 repetitions = 5;
+  std::vector<U64> markerCounts = {200 * 1000, 1000 * 1000};
+  std::vector<U64> resolutions = {5, 10, 20};
+  std::vector<U64> treeSizes = {1000, 5000};
+  for (int i = 1; i < argc; i++) {
+    const auto argument = std::string(argv[i]);
+    if (argument == "--output") {
+      outputFilename = getNextArgument(argc, argv, i);
+    } else if (argument == "--repetitions") {
+      repetitions = std::max(1ULL, std::stoull(getNextArgument(argc, argv, i)));
+    } else if (argument == "--quick") {
+      markerCounts = {200 * 1000};
+      resolutions = {10};
+      treeSizes = {1000};
+    } else {
+      std::cerr << "Unknown argument: " << argument << '\n';
+      return 1;
+    }
+  }
+#ifdef BENCHMARK_RENDERING
+  const auto offscreen = OpenGlWindow::OffscreenRenderingSupported;
+  if (!offscreen && !glfwInit()) {
+    std::cerr << "Failed to initialize GLFW." << '\n';
+    return 1;
+  }
+  const auto side = OpenGlWindow::DefaultWindowSide;
+  auto openGlWindow = std::make_unique<OpenGlWindow>(side, side, offscreen);
+#endif
+  std::vector<BenchmarkResult> results;
+  const auto record = [&results](const std::string &name, const BenchmarkScenario &scenario, U64 metamers, U64 operations, std::vector<double> seconds) {
+    results.push_back(BenchmarkResult{name, scenario, metamers, operations, std::move(seconds)});
+    const auto median = getMedian(results.back().seconds);
+    std::cout << std::left << std::setw(36) << name << std::right << std::setw(9) << scenario.markers << std::setw(4) << scenario.resolution;
+    std::cout << std::setw(7) << metamers << std::setw(14) << std::fixed << std::setprecision(6) << median << " s" << '\n';
+  };
+  for (const auto markerCount : markerCounts) {
+    for (const auto resolution : resolutions) {
+      MarkerFieldSettings markerFieldSettings;
+      markerFieldSettings.markerCount = markerCount;
+      markerFieldSettings.resolution = resolution;
+      const MarkerField markerField(markerFieldSettings);
+      for (const auto treeSize : treeSizes) {
+        const BenchmarkScenario scenario{markerCount, resolution, treeSize};
+        GrownTree grownTree(markerField, treeSize);
+        auto &tree = grownTree.tree;
+        auto &markerSet = grownTree.environment.markerSet;
+        const auto &parameters = grownTree.environment.parameters;
+        const auto metamers = tree.countMetamers();
+        std::vector<BudQuery> queries;
+        collectBudQueries(parameters, tree.root, queries);
+        const auto theta = parameters.perceptionAngle;
+        const auto nothing = []() {};
+        const auto updateAllocated = [&]() {
+          for (const auto &query : queries) {
+            markerSet.updateAllocatedInCone(query.budId, query.origin, query.direction, theta, query.r);
+          }
+        };
+        const auto resetAndUpdateAllocated = [&]() {
+          markerSet.resetAllocations();
+          updateAllocated();
+        };
+        record("updateAllocatedInCone", scenario, metamers, queries.size(), measure(repetitions, [&]() { markerSet.resetAllocations(); }, updateAllocated));
+        const auto getAllocated = [&]() {
+          for (const auto &query : queries) {
+            markerSet.getAllocatedInCone(query.budId, query.origin, query.direction, theta, query.r);
+          }
+        };
+        record("getAllocatedInCone", scenario, metamers, queries.size(), measure(repetitions, resetAndUpdateAllocated, getAllocated));
+        const auto hasAllocated = [&]() {
+          for (const auto &query : queries) {
+            markerSet.hasAllocatedInCone(query.budId, query.origin, query.direction, theta, query.r);
+          }
+        };
+        record("hasAllocatedInCone", scenario, metamers, queries.size(), measure(repetitions, resetAndUpdateAllocated, hasAllocated));
+        std::vector<std::pair<Point, float>> spheres;
+        collectOccupiedSpheres(parameters, tree.root, spheres);
+        auto markerSetCopy = markerSet;
+        const auto copyMarkerSet = [&]() { markerSetCopy = markerSet; };
+        const auto removeMarkers = [&]() {
+          for (const auto &[center, radius] : spheres) {
+            markerSetCopy.removeMarkersInSphere(center, radius);
+          }
+        };
+        record("removeMarkersInSphere", scenario, metamers, spheres.size(), measure(repetitions, copyMarkerSet, removeMarkers));
+        const auto allocate = [&]() { TreeBenchmark::allocateMarkers(tree); };
+        record("Tree::allocateMarkers", scenario, metamers, 1, measure(repetitions, nothing, allocate));
+        const auto propagateLight = [&]() { TreeBenchmark::propagateLightBasipetally(tree); };
+        record("Tree::propagateLightBasipetally", scenario, metamers, 1, measure(repetitions, allocate, propagateLight));
+        const auto propagateResources = [&]() { TreeBenchmark::propagateResourcesAcropetally(tree); };
+        record("Tree::propagateResourcesAcropetally", scenario, metamers, 1, measure(repetitions, propagateLight, propagateResources));
+        const auto updateWidths = [&]() { TreeBenchmark::updateInternodeWidths(tree); };
+        record("Tree::updateInternodeWidths", scenario, metamers, 1, measure(repetitions, nothing, updateWidths));
+        const auto buildTubeMesh = [&]() { TubeMeshBuilder().build(tree); };
+        record("TubeMeshBuilder::build", scenario, metamers, 1, measure(repetitions, nothing, buildTubeMesh));
+        const auto captureSnapshot = [&]() { TreeSnapshot(tree, nullptr, false); };
+        record("TreeSnapshot::TreeSnapshot", scenario, metamers, 1, measure(repetitions, nothing, captureSnapshot));
+        const TreeSnapshot rayTracedSnapshot(tree, nullptr, false);
+        Camera camera;
+        camera.frameBoundingBox(rayTracedSnapshot.boundingBox);
+        // One sample per pixel on a single thread, so that the time does not depend on the number of cores.
+        const RayTracer rayTracer(RayTracedSide, RayTracedSide, 1, 1);
+        const auto rayTrace = [&]() { rayTracer.render(rayTracedSnapshot, camera); };
+        record("RayTracer::render", scenario, metamers, RayTracedSide * RayTracedSide, measure(repetitions, nothing, rayTrace));
+#ifdef BENCHMARK_RENDERING
+        const TreeSnapshot snapshot(tree, nullptr, true);
+        const auto draw = [&]() {
+          openGlWindow->startDrawing();
+          openGlWindow->setCameraForBoundingBox(snapshot.boundingBox);
+          openGlWindow->drawTree(snapshot);
+          glFinish();
+        };
+        record("OpenGlWindow::drawTree", scenario, metamers, 1, measure(repetitions, nothing, draw));
+        // Frames the middle of the crown, so that most of the tree is outside of the frustum.
+        auto closeUpBox = snapshot.boundingBox;
+        for (auto *range : {&closeUpBox.xRange, &closeUpBox.yRange, &closeUpBox.zRange}) {
+          const auto average = range->getAverage();
+          const auto eighth = 0.125f * range->getLength();
+          *range = Range(average - eighth, average + eighth);
+        }
+        const auto drawCloseUp = [&]() {
+          openGlWindow->startDrawing();
+          openGlWindow->setCameraForBoundingBox(closeUpBox);
+          openGlWindow->drawTree(snapshot);
+          glFinish();
+        };
+        record("OpenGlWindow::drawTree (close-up)", scenario, metamers, 1, measure(repetitions, nothing, drawCloseUp));
+        const auto drawTubes = [&]() {
+          openGlWindow->startDrawing();
+          openGlWindow->setCameraForBoundingBox(snapshot.boundingBox);
+          openGlWindow->drawTreeAsTubes(snapshot);
+          glFinish();
+        };
+        record("OpenGlWindow::drawTreeAsTubes", scenario, metamers, 1, measure(repetitions, nothing, drawTubes));
+#endif
+        // Appending shoots changes the tree, so these need a freshly grown tree for every repetition.
+        std::unique_ptr<GrownTree> freshTree;
+        const auto growFreshTree = [&]() { freshTree = std::make_unique<GrownTree>(markerField, treeSize); };
+        const auto growFreshTreeAndPropagate = [&]() {
+          growFreshTree();
+          TreeBenchmark::allocateMarkers(freshTree->tree);
+          TreeBenchmark::propagateLightBasipetally(freshTree->tree);
+          TreeBenchmark::propagateResourcesAcropetally(freshTree->tree);
+        };
+        const auto appendShoots = [&]() { TreeBenchmark::appendNewShoots(freshTree->tree); };
+        record("Tree::appendNewShoots", scenario, metamers, 1, measure(repetitions, growFreshTreeAndPropagate, appendShoots));
+        const auto iterate = [&]() { freshTree->tree.performGrowthIteration(); };
+        record("Tree::performGrowthIteration", scenario, metamers, 1, measure(repetitions, growFreshTree, iterate));
+      }
+    }
+  }
+#ifdef BENCHMARK_RENDERING
+  openGlWindow.reset();
+  if (!offscreen) {
+    glfwTerminate();
+  }
+#endif
+  writeJson(outputFilename, results);
+  return 0;
+}
@@ -22,6 +22,13 @@ BoundingBox BoundingBox::merge(BoundingBox other) const {
   return BoundingBox{xRange.merge(other.xRange), yRange.merge(other.yRange), zRange.merge(other.zRange)};
 }
 
+float BoundingBox::getSurfaceArea() const {
+  const auto x = xRange.getLength();
+  const auto y = yRange.getLength();
+  const auto z = zRange.getLength();
+  return 2.0f * (x * y + y * z + z * x);
+}
+
 std::string BoundingBox::toString() const {
   std::stringstream stream;
   stream << xRange.minimum << ' ';
@@ -23,5 +23,7 @@ public:
 
   BoundingBox merge(BoundingBox other) const;
 
+  float getSurfaceArea() const;
+
   std::string toString() const;
 };
@@ -0,0 +1,197 @@
+#include "BoundingVolumeHierarchy.hpp"
+
+#include <algorithm>
+
+bool BoundingVolumeHierarchy::Node::isLeaf() const {
+  return left < 0;
+}
+
+static const Range &getRange(const BoundingBox &boundingBox, U32 axis) {
+  if (axis == 0) {
+    return boundingBox.xRange;
+  }
+  return axis == 1 ? boundingBox.yRange : boundingBox.zRange;
+}
+
+static U32 getLongestAxis(const BoundingBox &boundingBox) {
+  U32 longest = 0;
+  for (U32 axis = 1; axis < 3; axis++) {
+    if (getRange(boundingBox, axis).getLength() > getRange(boundingBox, longest).getLength()) {
+      longest = axis;
+    }
+  }
+  return longest;
+}
+
+I32 BoundingVolumeHierarchy::addNode(I32 parent) {
+  nodes.emplace_back();
+  nodes.back().parent = parent;
+  return static_cast<I32>(nodes.size() - 1);
+}
+
+void BoundingVolumeHierarchy::clear() {
+  nodes.clear();
+  root = -1;
+  instanceBoundingBoxes.clear();
+  instanceLeaves.clear();
+  instancesAtLastRebuild = 0;
+}
+
+void BoundingVolumeHierarchy::insert(const BoundingBox &boundingBox) {
+  const auto instance = static_cast<U32>(instanceBoundingBoxes.size());
+  instanceBoundingBoxes.push_back(boundingBox);
+  instanceLeaves.push_back(-1);
+  if (instanceBoundingBoxes.size() >= std::max<U64>(2 * instancesAtLastRebuild, 4 * LeafCapacity)) {
+    rebuild();
+    return;
+  }
+  if (root < 0) {
+    root = addNode(-1);
+    nodes[root].boundingBox = boundingBox;
+  }
+  auto node = root;
+  while (true) {
+    nodes[node].boundingBox = nodes[node].boundingBox.merge(boundingBox);
+    if (nodes[node].isLeaf()) {
+      break;
+    }
+    const auto &left = nodes[nodes[node].left].boundingBox;
+    const auto &right = nodes[nodes[node].right].boundingBox;
+    const auto leftGrowth = left.merge(boundingBox).getSurfaceArea() - left.getSurfaceArea();
+    const auto rightGrowth = right.merge(boundingBox).getSurfaceArea() - right.getSurfaceArea();
+    if (leftGrowth < rightGrowth || (leftGrowth == rightGrowth && left.getSurfaceArea() <= right.getSurfaceArea())) {
+      node = nodes[node].left;
+    } else {
+      node = nodes[node].right;
+    }
+  }
+  nodes[node].instances.push_back(instance);
+  instanceLeaves[instance] = node;
+  if (nodes[node].instances.size() > LeafCapacity) {
+    split(node);
+  }
+}
+
+void BoundingVolumeHierarchy::split(I32 leaf) {
+  auto instances = std::move(nodes[leaf].instances);
+  nodes[leaf].instances.clear();
+  const auto axis = getLongestAxis(nodes[leaf].boundingBox);
+  const auto middle = instances.begin() + instances.size() / 2;
+  std::nth_element(instances.begin(), middle, instances.end(), [&](U32 a, U32 b) {
+    return getRange(instanceBoundingBoxes[a], axis).getAverage() < getRange(instanceBoundingBoxes[b], axis).getAverage();
+  });
+  // Adding nodes may move the existing ones, so no reference to a node is kept across it.
+  const auto left = addNode(leaf);
+  const auto right = addNode(leaf);
+  nodes[leaf].left = left;
+  nodes[leaf].right = right;
+  for (auto it = instances.begin(); it != instances.end(); it++) {
+    const auto child = it < middle ? left : right;
+    auto &node = nodes[child];
+    node.boundingBox = node.instances.empty() ? instanceBoundingBoxes[*it] : node.boundingBox.merge(instanceBoundingBoxes[*it]);
+    node.instances.push_back(*it);
+    instanceLeaves[*it] = child;
+  }
+}
+
+void BoundingVolumeHierarchy::rebuild() {
+  nodes.clear();
+  std::vector<U32> instances(instanceBoundingBoxes.size());
+  for (U32 i = 0; i < instances.size(); i++) {
+    instances[i] = i;
+  }
+  root = build(instances, 0, instances.size(), -1);
+  instancesAtLastRebuild = instances.size();
+}
+
+/**
+ * Builds the subtree over a range of instances, splitting at the median along the longest axis until leaves are at most
+ * half full, so that the following insertions do not split them right away.
+ */
+I32 BoundingVolumeHierarchy::build(std::vector<U32> &instances, U64 begin, U64 end, I32 parent) {
+  const auto node = addNode(parent);
+  BoundingBox boundingBox = instanceBoundingBoxes[instances[begin]];
+  for (auto i = begin + 1; i < end; i++) {
+    boundingBox = boundingBox.merge(instanceBoundingBoxes[instances[i]]);
+  }
+  nodes[node].boundingBox = boundingBox;
+  if (end - begin <= LeafCapacity / 2) {
+    nodes[node].instances.assign(instances.begin() + begin, instances.begin() + end);
+    for (auto i = begin; i < end; i++) {
+      instanceLeaves[instances[i]] = node;
+    }
+    return node;
+  }
+  const auto axis = getLongestAxis(boundingBox);
+  const auto middle = begin + (end - begin) / 2;
+  std::nth_element(instances.begin() + begin, instances.begin() + middle, instances.begin() + end, [&](U32 a, U32 b) {
+    return getRange(instanceBoundingBoxes[a], axis).getAverage() < getRange(instanceBoundingBoxes[b], axis).getAverage();
+  });
+  const auto left = build(instances, begin, middle, node);
+  const auto right = build(instances, middle, end, node);
+  nodes[node].left = left;
+  nodes[node].right = right;
+  return node;
+}
+
+void BoundingVolumeHierarchy::enlargeAncestors(I32 node, const BoundingBox &boundingBox) {
+  for (; node >= 0; node = nodes[node].parent) {
+    nodes[node].boundingBox = nodes[node].boundingBox.merge(boundingBox);
+  }
+}
+
+void BoundingVolumeHierarchy::enlarge(U64 instance, const BoundingBox &boundingBox) {
+  instanceBoundingBoxes[instance] = instanceBoundingBoxes[instance].merge(boundingBox);
+  enlargeAncestors(instanceLeaves[instance], boundingBox);
+}
+
+U64 BoundingVolumeHierarchy::countInstances() const {
+  return instanceBoundingBoxes.size();
+}
+
+U64 BoundingVolumeHierarchy::countNodes() const {
+  return nodes.size();
+}
+
+void BoundingVolumeHierarchy::collectSubtree(I32 node, std::vector<U32> &instances) const {
+  std::vector<I32> stack{node};
+  while (!stack.empty()) {
+    const auto &current = nodes[stack.back()];
+    stack.pop_back();
+    if (current.isLeaf()) {
+      instances.insert(instances.end(), current.instances.begin(), current.instances.end());
+    } else {
+      stack.push_back(current.right);
+      stack.push_back(current.left);
+    }
+  }
+}
+
+void BoundingVolumeHierarchy::collectInFrustum(const Frustum &frustum, std::vector<U32> &instances) const {
+  if (root < 0) {
+    return;
+  }
+  // Hierarchies which were not rebuilt recently can be deep, so the traversal uses an explicit stack.
+  std::vector<I32> stack{root};
+  while (!stack.empty()) {
+    const auto node = stack.back();
+    stack.pop_back();
+    const auto containment = frustum.classify(nodes[node].boundingBox);
+    if (containment == Containment::Outside) {
+      continue;
+    }
+    if (containment == Containment::Inside || nodes[node].isLeaf()) {
+      collectSubtree(node, instances);
+    } else {
+      stack.push_back(nodes[node].right);
+      stack.push_back(nodes[node].left);
+    }
+  }
+}
+
+Containment BoundingVolumeHierarchy::classify(const Frustum &frustum) const {
+  if (root < 0) {
+    return Containment::Outside;
+  }
+  return frustum.classify(nodes[root].boundingBox);
+}
@@ -0,0 +1,122 @@
+#pragma once
+
+#include <vector>
+
+#include "BoundingBox.hpp"
+#include "Frustum.hpp"
+#include "Types.hpp"
+
+/**
+ * A binary tree of bounding boxes over instances, numbered in insertion order, whose leaves hold a few instances each.
+ *
+ * Instances are inserted one at a time by descending into the child whose box grows the least, and full leaves are split
+ * in two at the median along their longest axis. As this degrades the hierarchy when instances keep being added on its
+ * outside, as shoots are, it is rebuilt from scratch every time the number of instances doubles, which keeps the
+ * amortized cost of an insertion logarithmic.
+ */
+class BoundingVolumeHierarchy {
+  class Node {
+  public:
+    BoundingBox boundingBox{};
+    I32 parent = -1;
+    // Either both children are set, or the node is a leaf which holds instances.
+    I32 left = -1;
+    I32 right = -1;
+    std::vector<U32> instances;
+
+    bool isLeaf() const;
+  };
+
+  std::vector<Node> nodes;
+  I32 root = -1;
+  std::vector<BoundingBox> instanceBoundingBoxes;
+  // The leaf which holds each instance.
+  std::vector<I32> instanceLeaves;
+  U64 instancesAtLastRebuild = 0;
+
+  I32 addNode(I32 parent);
+
+  void split(I32 leaf);
+
+  I32 build(std::vector<U32> &instances, U64 begin, U64 end, I32 parent);
+
+  void enlargeAncestors(I32 node, const BoundingBox &boundingBox);
+
+  void collectSubtree(I32 node, std::vector<U32> &instances) const;
+
+public:
+  static constexpr U64 LeafCapacity = 16;
+
+  void clear();
+
+  /**
+   * Inserts the next instance, whose index is the number of instances inserted before it.
+   */
+  void insert(const BoundingBox &boundingBox);
+
+  /**
+   * Grows the box of an instance so that it also bounds the specified box.
+   */
+  void enlarge(U64 instance, const BoundingBox &boundingBox);
+
+  /**
+   * Builds the hierarchy again from scratch, which makes it as shallow as it gets until the next insertion.
+   */
+  void rebuild();
+
+  U64 countInstances() const;
+
+  U64 countNodes() const;
+
+  /**
+   * Appends the instances in leaves which intersect the frustum, which includes every instance inside it.
+   *
+   * Subtrees entirely inside the frustum are appended without testing their boxes.
+   */
+  void collectInFrustum(const Frustum &frustum, std::vector<U32> &instances) const;
+
+  /**
+   * Returns how much of the instances lie inside the frustum, judging by the box of the root alone.
+   */
+  Containment classify(const Frustum &frustum) const;
+
+  /**
+   * Walks the hierarchy depth-first, entering only the nodes whose boxes accept returns true for, and calls visit with the
+   * instances of every leaf entered.
+   *
+   * Of two children, the one whose center is closer to the point is entered first. Nodes are tested when they are
+   * reached rather than when their parent is, so that accept can reject more of them as visited leaves narrow a search.
+   */
+  template <typename Accept, typename Visit>
+  void traverse(const Point &point, Accept accept, Visit visit) const;
+};
+
+template <typename Accept, typename Visit>
+void BoundingVolumeHierarchy::traverse(const Point &point, Accept accept, Visit visit) const {
+  if (root < 0) {
+    return;
+  }
+  // Four times the squared distance to the center, which orders children just as well.
+  const auto getSquaredDistance = [&point](const BoundingBox &boundingBox) {
+    const auto dx = boundingBox.xRange.minimum + boundingBox.xRange.maximum - 2.0f * point.x;
+    const auto dy = boundingBox.yRange.minimum + boundingBox.yRange.maximum - 2.0f * point.y;
+    const auto dz = boundingBox.zRange.minimum + boundingBox.zRange.maximum - 2.0f * point.z;
+    return dx * dx + dy * dy + dz * dz;
+  };
+  std::vector<I32> stack{root};
+  while (!stack.empty()) {
+    const auto &node = nodes[stack.back()];
+    stack.pop_back();
+    if (!accept(node.boundingBox)) {
+      continue;
+    }
+    if (node.isLeaf()) {
+      visit(node.instances);
+      continue;
+    }
+    const auto leftDistance = getSquaredDistance(nodes[node.left].boundingBox);
+    const auto rightDistance = getSquaredDistance(nodes[node.right].boundingBox);
+    stack.push_back(leftDistance < rightDistance ? node.right : node.left);
+    stack.push_back(leftDistance < rightDistance ? node.left : node.right);
+  }
+}
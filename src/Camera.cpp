@@ -0,0 +1,16 @@
+#include "Camera.hpp"
+
+#include <algorithm>
+
+void Camera::frameBoundingBox(const BoundingBox &boundingBox) {
+  position.x = boundingBox.xRange.getAverage();
+  position.y = boundingBox.yRange.getAverage();
+  position.z = boundingBox.zRange.minimum;
+  // d = (s/2) / tan(a/2)
+  const auto s = std::max(boundingBox.xRange.getLength(), boundingBox.yRange.getLength());
+  // A magic factor to fill the screen more
+  position.z -= 0.5f * (s / 2.0f) / std::tan(fov / 2.0f);
+  lookAtPosition.x = boundingBox.xRange.getAverage();
+  lookAtPosition.y = boundingBox.yRange.getAverage();
+  lookAtPosition.z = boundingBox.zRange.getAverage();
+}
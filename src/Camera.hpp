@@ -0,0 +1,22 @@
+#pragma once
+
+#include <cmath>
+
+#include "BoundingBox.hpp"
+#include "Point.hpp"
+
+/**
+ * A perspective camera with the Y axis up, shared by the OpenGL and the ray traced renderers so that they frame trees alike.
+ */
+class Camera {
+public:
+  Point position{0.0f, 0.5f, 1.0f};
+  Point lookAtPosition{0.0f, 0.0f, 1.0f};
+  // The vertical field of view, in radians.
+  float fov = 2.0f * std::atan(1.0f);
+
+  /**
+   * Looks at the center of the box from in front of it, along the Z axis, from where the box fills most of the view.
+   */
+  void frameBoundingBox(const BoundingBox &boundingBox);
+};
@@ -0,0 +1,88 @@
+#include "Cone.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+
+#include "GrowthParameters.hpp"
+
+// Relative to the radius for distances, and in radians for angles.
+static constexpr float ClassificationMargin = 1.0e-4f;
+// The cosine and the sine of the margin, to the precision of a float, so that constructing a cone takes a single cosine.
+static constexpr float CosMargin = 1.0f;
+static constexpr float SinMargin = ClassificationMargin;
+
+Cone::Cone(Point apex, Vector direction, float theta, float r)
+    : apex(apex), axis(direction.normalize()), theta(theta), r(r), cosTheta(std::cos(theta)), sinTheta(std::sqrt(std::max(1.0f - cosTheta * cosTheta, 0.0f))),
+      cosInnerTheta(cosTheta * CosMargin + sinTheta * SinMargin), distanceMargin(ClassificationMargin * r), innerRadius(r - distanceMargin),
+      outerRadius(r + distanceMargin) {
+}
+
+static float getNearestOffset(Range range, float x) {
+  return std::clamp(x, range.minimum, range.maximum) - x;
+}
+
+static float getFurthestOffset(Range range, float x) {
+  return std::max(x - range.minimum, range.maximum - x);
+}
+
+// Runs for every cell of every marker query, so it works on components rather than calling into Vector.
+Containment Cone::classify(const BoundingBox &boundingBox) const {
+  const auto &xRange = boundingBox.xRange;
+  const auto &yRange = boundingBox.yRange;
+  const auto &zRange = boundingBox.zRange;
+  const auto nearestX = getNearestOffset(xRange, apex.x);
+  const auto nearestY = getNearestOffset(yRange, apex.y);
+  const auto nearestZ = getNearestOffset(zRange, apex.z);
+  if (nearestX * nearestX + nearestY * nearestY + nearestZ * nearestZ >= outerRadius * outerRadius) {
+    return Containment::Outside;
+  }
+  // The box is outside if its bounding sphere is, which is when the center of the sphere is outside of the angle and
+  // further than the radius of the sphere from the surface of the cone, measured in the plane of the axis and the center.
+  const auto centerX = 0.5f * (xRange.minimum + xRange.maximum) - apex.x;
+  const auto centerY = 0.5f * (yRange.minimum + yRange.maximum) - apex.y;
+  const auto centerZ = 0.5f * (zRange.minimum + zRange.maximum) - apex.z;
+  const auto centerDistanceSquared = centerX * centerX + centerY * centerY + centerZ * centerZ;
+  const auto along = centerX * axis.x + centerY * axis.y + centerZ * axis.z;
+  const auto across = std::sqrt(std::max(centerDistanceSquared - along * along, 0.0f));
+  // The margin is taken from the distance of the center rather than added to the radius, which spares a square root.
+  const auto outsideAngle = across * cosTheta - along * sinTheta - distanceMargin;
+  if (outsideAngle > 0.0f) {
+    const auto xLength = xRange.maximum - xRange.minimum;
+    const auto yLength = yRange.maximum - yRange.minimum;
+    const auto zLength = zRange.maximum - zRange.minimum;
+    const auto boundingRadiusSquared = 0.25f * (xLength * xLength + yLength * yLength + zLength * zLength);
+    // Centers behind the apex are closest to the apex itself.
+    if (along * cosTheta + across * sinTheta >= 0.0f) {
+      if (outsideAngle * outsideAngle >= boundingRadiusSquared) {
+        return Containment::Outside;
+      }
+    } else {
+      const auto apexDistance = std::sqrt(centerDistanceSquared) - distanceMargin;
+      if (apexDistance > 0.0f && apexDistance * apexDistance >= boundingRadiusSquared) {
+        return Containment::Outside;
+      }
+    }
+  }
+  const auto furthestX = getFurthestOffset(xRange, apex.x);
+  const auto furthestY = getFurthestOffset(yRange, apex.y);
+  const auto furthestZ = getFurthestOffset(zRange, apex.z);
+  if (furthestX * furthestX + furthestY * furthestY + furthestZ * furthestZ >= innerRadius * innerRadius || theta > 0.5f * GrowthParameters::Pi) {
+    return Containment::Intersecting;
+  }
+  // A cone no wider than a half-space is convex, so the box is inside if all of its corners are.
+  for (const auto x : std::array<float, 2>{xRange.minimum, xRange.maximum}) {
+    for (const auto y : std::array<float, 2>{yRange.minimum, yRange.maximum}) {
+      for (const auto z : std::array<float, 2>{zRange.minimum, zRange.maximum}) {
+        const auto cornerX = x - apex.x;
+        const auto cornerY = y - apex.y;
+        const auto cornerZ = z - apex.z;
+        const auto cornerDistance = std::sqrt(cornerX * cornerX + cornerY * cornerY + cornerZ * cornerZ);
+        if (!(cornerX * axis.x + cornerY * axis.y + cornerZ * axis.z > cosInnerTheta * cornerDistance)) {
+          return Containment::Intersecting;
+        }
+      }
+    }
+  }
+  return Containment::Inside;
+}
@@ -0,0 +1,37 @@
+#pragma once
+
+#include "BoundingBox.hpp"
+#include "Containment.hpp"
+#include "Point.hpp"
+#include "Types.hpp"
+#include "Vector.hpp"
+
+/**
+ * The perception volume of a bud: the points closer to its apex than the radius, within the half-angle of its axis.
+ */
+class Cone {
+  Point apex;
+  Vector axis;
+  float theta;
+  float r;
+  float cosTheta;
+  float sinTheta;
+  // The cosine of theta less the margin, which the corners of boxes inside of the cone must exceed.
+  float cosInnerTheta;
+  // The distances from the apex which points of boxes inside of the cone must be under, and those outside of it over.
+  float distanceMargin;
+  float innerRadius;
+  float outerRadius;
+
+public:
+  Cone(Point apex, Vector direction, float theta, float r);
+
+  /**
+   * Classifies the box against both the sphere and the angle of the cone.
+   *
+   * Boxes are only reported as outside or inside with a small margin, so that every point of a box reported as inside
+   * passes the exact tests of the marker queries, and no point of a box reported as outside does. Others are reported as
+   * intersecting, as are all boxes not outside of a cone wider than a half-space, which is not convex.
+   */
+  Containment classify(const BoundingBox &boundingBox) const;
+};
@@ -0,0 +1,8 @@
+#pragma once
+
+#include "Types.hpp"
+
+/**
+ * How much of a volume lies within another: none of it, part of it, or all of it.
+ */
+enum class Containment : U32 { Outside, Intersecting, Inside };
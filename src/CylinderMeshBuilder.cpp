@@ -0,0 +1,112 @@
+#include "CylinderMeshBuilder.hpp"
+
+#include <cmath>
+
+static void pushBackVertex(std::vector<Vertex> &vertices, float x, float y, float z, float nx, float ny, float nz) {
+  vertices.push_back(Vertex{Point(x, y, z), Vector(nx, ny, nz)});
+}
+
+static void pushBackTriangle(std::vector<U32> &indices, U32 a, U32 b, U32 c) {
+  indices.push_back(a);
+  indices.push_back(b);
+  indices.push_back(c);
+}
+
+static float getFaceAngle(U32 faces, U32 i) {
+  return 2.0f * 4.0f * std::atan(1.0f) / faces * (i % faces);
+}
+
+static void addDisk(Mesh &mesh, U32 faces, float y) {
+  const auto center = static_cast<U32>(mesh.vertices.size());
+  pushBackVertex(mesh.vertices, 0.0f, y, 0.0f, 0.0f, y, 0.0f);
+  for (U32 i = 0; i < faces; i++) {
+    pushBackVertex(mesh.vertices, std::cos(getFaceAngle(faces, i)), y, std::sin(getFaceAngle(faces, i)), 0.0f, y, 0.0f);
+    const auto current = center + 1 + i;
+    const auto next = center + 1 + (i + 1) % faces;
+    // Triangles are counterclockwise when seen from outside, so the top cap, which faces +Y, goes the other way around.
+    if (y < 0.0f) {
+      pushBackTriangle(mesh.indices, center, current, next);
+    } else {
+      pushBackTriangle(mesh.indices, center, next, current);
+    }
+  }
+}
+
+static void addSide(Mesh &mesh, U32 faces) {
+  // Consecutive faces share their edges, so the normals are smooth around the cylinder.
+  const auto first = static_cast<U32>(mesh.vertices.size());
+  for (U32 i = 0; i < faces; i++) {
+    const auto x = std::cos(getFaceAngle(faces, i));
+    const auto z = std::sin(getFaceAngle(faces, i));
+    pushBackVertex(mesh.vertices, x, -1.0f, z, x, 0.0f, z);
+    pushBackVertex(mesh.vertices, x, +1.0f, z, x, 0.0f, z);
+  }
+  for (U32 i = 0; i < faces; i++) {
+    const auto a = first + 2 * i;
+    const auto b = first + 2 * ((i + 1) % faces);
+    // Counterclockwise when seen from outside, as angles grow from +X towards +Z.
+    pushBackTriangle(mesh.indices, a, b + 1, b);
+    pushBackTriangle(mesh.indices, b + 1, a, a + 1);
+  }
+}
+
+Mesh CylinderMeshBuilder::build() const {
+  Mesh mesh;
+  if (withCaps) {
+    addDisk(mesh, faces, -1.0f);
+  }
+  addSide(mesh, faces);
+  if (withCaps) {
+    addDisk(mesh, faces, +1.0f);
+  }
+  return mesh;
+}
+
+U64 CylinderMeshBuilder::countVertices() const {
+  return 2 * faces + (withCaps ? 2 * (faces + 1) : 0);
+}
+
+U64 CylinderMeshBuilder::countIndices() const {
+  return 6 * faces + (withCaps ? 6 * faces : 0);
+}
+
+void CylinderMeshBuilder::addMetamer(Mesh &mesh, const Mesh &cylinder, const Metamer &metamer) {
+  const auto &b = metamer.beginning;
+  const auto &e = metamer.end;
+  const auto dx = e.x - b.x;
+  const auto dy = e.y - b.y;
+  const auto dz = e.z - b.z;
+  const auto length = std::sqrt(dx * dx + dy * dy + dz * dz);
+  // The rotation which aligns the Y axis with the metamer, which is the identity if they are almost aligned or reversed.
+  // Applies the formulation of the vertex shader to vectors as x c + v × x + v (v · x) / (1 + c), where v = Y × direction.
+  const auto c = length > 0.0f ? dy / length : 1.0f;
+  const auto aligned = std::abs(c) > 1.0f - 1.0e-6f;
+  const auto vx = aligned ? 0.0f : dz / length;
+  const auto vz = aligned ? 0.0f : -dx / length;
+  const auto cosine = aligned ? 1.0f : c;
+  // Writes components in place, as this runs for every vertex of every metamer of the trees being exported.
+  const auto rotate = [vx, vz, cosine](float x, float y, float z, float &rotatedX, float &rotatedY, float &rotatedZ) {
+    const auto k = (vx * x + vz * z) / (1.0f + cosine);
+    rotatedX = x * cosine - vz * y + vx * k;
+    rotatedY = y * cosine + vz * x - vx * z;
+    rotatedZ = z * cosine + vx * y + vz * k;
+  };
+  const auto baseVertex = static_cast<U32>(mesh.vertices.size());
+  mesh.vertices.resize(mesh.vertices.size() + cylinder.vertices.size());
+  auto *placed = mesh.vertices.data() + baseVertex;
+  const auto halfLength = 0.5f * length;
+  for (const auto &vertex : cylinder.vertices) {
+    auto &p = placed->position;
+    rotate(metamer.width * vertex.position.x, halfLength * vertex.position.y, metamer.width * vertex.position.z, p.x, p.y, p.z);
+    p.x += b.x + 0.5f * dx;
+    p.y += b.y + 0.5f * dy;
+    p.z += b.z + 0.5f * dz;
+    // The scale is the same across the axis, and normals are either across or along it, so they only rotate.
+    auto &n = placed->normal;
+    rotate(vertex.normal.x, vertex.normal.y, vertex.normal.z, n.x, n.y, n.z);
+    placed++;
+  }
+  for (const auto index : cylinder.indices) {
+    mesh.indices.push_back(baseVertex + index);
+  }
+}
@@ -0,0 +1,29 @@
+#pragma once
+
+#include "Mesh.hpp"
+#include "Metamer.hpp"
+#include "Types.hpp"
+
+/**
+ * Builds the cylinders which OpenGlWindow draws, one per metamer.
+ *
+ * The unit cylinder has a radius of 1 meter and a height of 2 meters, is centered at the origin, and is aligned with the
+ * Y axis. Placing it on a metamer scales, rotates, and translates it as the cylinder vertex shader does.
+ */
+class CylinderMeshBuilder {
+public:
+  // The number of faces around the side, an even number, so that the silhouette is exact when facing the camera.
+  U32 faces = 16;
+  bool withCaps = true;
+
+  Mesh build() const;
+
+  U64 countVertices() const;
+
+  U64 countIndices() const;
+
+  /**
+   * Appends a copy of the unit cylinder which spans the metamer and whose radius is its width.
+   */
+  static void addMetamer(Mesh &mesh, const Mesh &cylinder, const Metamer &metamer);
+};
@@ -0,0 +1,17 @@
+#pragma once
+
+#include "Types.hpp"
+
+/**
+ * The parameters of an indexed draw, as laid out in an OpenGL indirect command buffer.
+ */
+class DrawElementsIndirectCommand {
+public:
+  U32 count{};
+  U32 instanceCount{};
+  U32 firstIndex{};
+  I32 baseVertex{};
+  U32 baseInstance{};
+};
+
+static_assert(sizeof(DrawElementsIndirectCommand) == 5 * sizeof(U32));
@@ -2,8 +2,20 @@
 
 #include "Environment.hpp"
 
-Environment::Environment(const SplitMixGenerator &splitMixGenerator, MarkerSet markerSet)
-    : splitMixGenerator(splitMixGenerator), markerSet(std::move(markerSet)) {
+Environment::Environment(const SplitMixGenerator &splitMixGenerator, MarkerSet markerSet, const GrowthParameters &parameters)
+    : splitMixGenerator(splitMixGenerator), markerSet(std::move(markerSet)), parameters(parameters) {
+}
+
+Environment::Environment(const SplitMixGenerator &splitMixGenerator, ShadowGrid shadowGrid, const GrowthParameters &parameters)
+    : splitMixGenerator(splitMixGenerator), markerSet(shadowGrid.xRange, shadowGrid.yRange, shadowGrid.zRange, 1), shadowGrid(std::move(shadowGrid)),
+      parameters(parameters) {
+}
+
+EnvironmentModel &Environment::getModel() {
+  if (shadowGrid) {
+    return *shadowGrid;
+  }
+  return markerSet;
 }
 
 BudId Environment::getNextBudId() {
@@ -1,9 +1,13 @@
 #pragma once
 
 #include <cmath>
+#include <optional>
 
+#include "EnvironmentModel.hpp"
+#include "GrowthParameters.hpp"
 #include "MarkerSet.hpp"
 #include "Random.hpp"
+#include "ShadowGrid.hpp"
 #include "Types.hpp"
 
 class Environment {
@@ -11,27 +15,29 @@ private:
   BudId nextBudId = 1;
 
 public:
-  static constexpr auto Pi = 3.1415926535897932384626433832795f;
-
   // In meters.
   static constexpr auto MetamerBaseLength = 0.01f;
 
-  static constexpr auto OccupancyRadiusFactor = 2.0f;
-  static constexpr auto PerceptionRadiusFactor = 4.0f;
-
-  static constexpr auto PerceptionAngle = Pi / 2.0f;
+  SplitMixGenerator splitMixGenerator;
+  MarkerSet markerSet;
 
-  static constexpr auto AxillaryPerturbationAngle = Pi / 18.0f;
+  // If set, buds perceive their environment through shadow propagation instead of the markers.
+  std::optional<ShadowGrid> shadowGrid;
 
-  static constexpr auto BorchertHondaAlpha = 2.0f;
-  static constexpr auto BorchertHondaLambda = 0.5f;
+  GrowthParameters parameters;
 
-  static constexpr auto OptimalGrowthDirectionWeight = 0.2f;
+  Environment(const SplitMixGenerator &SplitMixGenerator, MarkerSet markerSet, const GrowthParameters &parameters);
 
-  SplitMixGenerator splitMixGenerator;
-  MarkerSet markerSet;
+  /**
+   * Creates an environment which uses shadow propagation, whose marker set is empty.
+   */
+  Environment(const SplitMixGenerator &SplitMixGenerator, ShadowGrid shadowGrid, const GrowthParameters &parameters);
 
-  Environment(const SplitMixGenerator &SplitMixGenerator, MarkerSet markerSet);
+  /**
+   * Returns the model through which buds perceive their environment, the shadow grid if there is one, otherwise the
+   * marker set.
+   */
+  EnvironmentModel &getModel();
 
   BudId getNextBudId();
 };
@@ -0,0 +1,55 @@
+#pragma once
+
+#include "MarkerSetStatistics.hpp"
+#include "Point.hpp"
+#include "SpaceAnalysis.hpp"
+#include "Types.hpp"
+#include "Vector.hpp"
+
+/**
+ * Computes the local environment of buds, which is how a tree senses the space and the light around it.
+ *
+ * The paper describes two such models: space colonization, implemented by MarkerSet, and shadow propagation,
+ * implemented by ShadowGrid. A growth iteration first lets every bud allocate its environment, then asks each bud for
+ * its light, and finally asks the buds which may grow for their light and their optimal growth direction, occupying the
+ * space of every metamer it creates.
+ */
+class EnvironmentModel {
+public:
+  // If not null, the work done by each query is added to these statistics.
+  MarkerSetStatistics *statistics = nullptr;
+
+  virtual ~EnvironmentModel() = default;
+
+  /**
+   * Forgets the allocations of the previous growth iteration.
+   */
+  virtual void resetAllocations() = 0;
+
+  /**
+   * Lets the bud claim its part of the environment in the cone of half-angle theta and radius r.
+   */
+  virtual void allocate(BudId budId, Point origin, Vector direction, float theta, float r) = 0;
+
+  /**
+   * Returns the light exposure of the bud, the q of its space analysis.
+   */
+  virtual float getLight(BudId budId, Point origin, Vector direction, float theta, float r) const = 0;
+
+  /**
+   * Returns the light exposure of the bud and its optimal growth direction.
+   */
+  virtual SpaceAnalysis analyze(BudId budId, Point origin, Vector direction, float theta, float r) const = 0;
+
+  /**
+   * Records a new metamer ending at the center, whose buds occupy the sphere of the radius around it.
+   */
+  virtual void occupy(Point center, float radius) = 0;
+
+protected:
+  EnvironmentModel() = default;
+  EnvironmentModel(const EnvironmentModel &) = default;
+  EnvironmentModel(EnvironmentModel &&) = default;
+  EnvironmentModel &operator=(const EnvironmentModel &) = default;
+  EnvironmentModel &operator=(EnvironmentModel &&) = default;
+};
@@ -0,0 +1,20 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "Types.hpp"
+
+/**
+ * BGR pixels and the file they should be written to, if any.
+ */
+class Frame {
+public:
+  std::vector<uint8_t> pixels;
+  U32 width{};
+  U32 height{};
+  std::string filename;
+  // Pixels read back from OpenGL are bottom row first, those of the ray tracer top row first.
+  bool bottomRowFirst = true;
+};
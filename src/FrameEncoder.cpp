@@ -0,0 +1,94 @@
+#include "FrameEncoder.hpp"
+
+#include <algorithm>
+#include <stdexcept>
+
+#include "Image.hpp"
+#include "Trace.hpp"
+
+FrameEncoder::FrameEncoder(U64 workerCount, U64 queueCapacity, VideoSink *videoSink)
+    : queueCapacity(std::max<U64>(1, queueCapacity)), videoSink(videoSink) {
+  // Frames are appended to a video in the order they are taken from the queue, so only one worker may do it.
+  if (videoSink) {
+    workerCount = 1;
+  }
+  for (U64 i = 0; i < std::max<U64>(1, workerCount); i++) {
+    workers.emplace_back(&FrameEncoder::work, this);
+  }
+}
+
+FrameEncoder::~FrameEncoder() {
+  stopWorkers();
+}
+
+void FrameEncoder::stopWorkers() {
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    finishing = true;
+  }
+  queueNotEmpty.notify_all();
+  for (auto &worker : workers) {
+    if (worker.joinable()) {
+      worker.join();
+    }
+  }
+}
+
+void FrameEncoder::encode(Frame &frame) {
+  Image image(frame.pixels, frame.width, frame.height);
+  if (frame.bottomRowFirst) {
+    TraceScope traceScope("Image::flipVertically", "io");
+    image.flipVertically();
+  }
+  if (videoSink) {
+    TraceScope traceScope("VideoSink::write", "io");
+    videoSink->write(image);
+  } else {
+    TraceScope traceScope("Image::writeToFile", "io");
+    image.writeToFile(frame.filename);
+  }
+}
+
+void FrameEncoder::work() {
+  while (true) {
+    Frame frame;
+    {
+      std::unique_lock<std::mutex> lock(mutex);
+      queueNotEmpty.wait(lock, [this]() { return finishing || !queue.empty(); });
+      if (queue.empty()) {
+        return;
+      }
+      frame = std::move(queue.front());
+      queue.pop_front();
+    }
+    queueNotFull.notify_one();
+    try {
+      encode(frame);
+    } catch (...) {
+      std::lock_guard<std::mutex> lock(mutex);
+      if (!error) {
+        error = std::current_exception();
+      }
+    }
+  }
+}
+
+void FrameEncoder::submit(Frame frame) {
+  TraceScope traceScope("FrameEncoder::submit", "io");
+  {
+    std::unique_lock<std::mutex> lock(mutex);
+    if (finishing) {
+      throw std::logic_error("Frames cannot be submitted after finishing.");
+    }
+    queueNotFull.wait(lock, [this]() { return queue.size() < queueCapacity; });
+    queue.push_back(std::move(frame));
+  }
+  queueNotEmpty.notify_one();
+}
+
+void FrameEncoder::finish() {
+  stopWorkers();
+  if (error) {
+    std::rethrow_exception(error);
+  }
+}
@@ -0,0 +1,56 @@
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "Frame.hpp"
+#include "Types.hpp"
+#include "VideoSink.hpp"
+
+/**
+ * Converts and writes frames to image files, or to a video, on a pool of worker threads.
+ *
+ * At most a bounded number of frames wait to be encoded. Submitting blocks while the queue is full, which bounds
+ * memory and slows the producer down to the encoding speed only when encoding cannot keep up.
+ */
+class FrameEncoder {
+  std::vector<std::thread> workers;
+  std::deque<Frame> queue;
+  const U64 queueCapacity;
+  bool finishing = false;
+  std::exception_ptr error;
+  std::mutex mutex;
+  std::condition_variable queueNotEmpty;
+  std::condition_variable queueNotFull;
+  VideoSink *const videoSink;
+
+  void work();
+
+  // Lets the workers drain the queue and waits for them.
+  void stopWorkers();
+
+  void encode(Frame &frame);
+
+public:
+  /**
+   * Frames are written to image files named after them or, if a video sink is specified, appended to it in order.
+   */
+  FrameEncoder(U64 workerCount, U64 queueCapacity, VideoSink *videoSink = nullptr);
+
+  FrameEncoder(const FrameEncoder &) = delete;
+
+  FrameEncoder &operator=(const FrameEncoder &) = delete;
+
+  ~FrameEncoder();
+
+  void submit(Frame frame);
+
+  /**
+   * Waits until every submitted frame is written, rethrowing the first error of any worker.
+   */
+  void finish();
+};
@@ -0,0 +1,42 @@
+#include "Frustum.hpp"
+
+Frustum::Frustum(const std::array<F32, 16> &viewProjectionMatrix) {
+  // A point is inside if -w <= x <= w, -w <= y <= w, and -w <= z <= w in clip space, so every plane is the last row of
+  // the matrix plus or minus one of the others.
+  const auto getRow = [&viewProjectionMatrix](U32 row) {
+    return std::array<F32, 4>{viewProjectionMatrix[row], viewProjectionMatrix[4 + row], viewProjectionMatrix[8 + row], viewProjectionMatrix[12 + row]};
+  };
+  const auto w = getRow(3);
+  for (U32 row = 0; row < 3; row++) {
+    const auto r = getRow(row);
+    for (U32 i = 0; i < 4; i++) {
+      planes[2 * row][i] = w[i] + r[i];
+      planes[2 * row + 1][i] = w[i] - r[i];
+    }
+  }
+}
+
+/**
+ * Tests, for every plane, the corner of the box furthest along its normal and the corner furthest against it.
+ *
+ * Boxes near the edges of the frustum but outside of it may be reported as intersecting, never the opposite.
+ */
+Containment Frustum::classify(const BoundingBox &boundingBox) const {
+  auto containment = Containment::Inside;
+  for (const auto &plane : planes) {
+    const auto &x = boundingBox.xRange;
+    const auto &y = boundingBox.yRange;
+    const auto &z = boundingBox.zRange;
+    const auto furthest = plane[0] * (plane[0] > 0.0f ? x.maximum : x.minimum) + plane[1] * (plane[1] > 0.0f ? y.maximum : y.minimum) +
+                          plane[2] * (plane[2] > 0.0f ? z.maximum : z.minimum) + plane[3];
+    if (furthest < 0.0f) {
+      return Containment::Outside;
+    }
+    const auto nearest = plane[0] * (plane[0] > 0.0f ? x.minimum : x.maximum) + plane[1] * (plane[1] > 0.0f ? y.minimum : y.maximum) +
+                         plane[2] * (plane[2] > 0.0f ? z.minimum : z.maximum) + plane[3];
+    if (nearest < 0.0f) {
+      containment = Containment::Intersecting;
+    }
+  }
+  return containment;
+}
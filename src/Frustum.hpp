@@ -0,0 +1,23 @@
+#pragma once
+
+#include <array>
+
+#include "BoundingBox.hpp"
+#include "Containment.hpp"
+#include "Types.hpp"
+
+/**
+ * The volume seen by a camera, bounded by six planes whose normals point inwards.
+ */
+class Frustum {
+  // The coefficients a, b, c, and d of every plane ax + by + cz + d = 0.
+  std::array<std::array<F32, 4>, 6> planes{};
+
+public:
+  /**
+   * Extracts the planes from a column-major view projection matrix, as laid out by OpenGL.
+   */
+  explicit Frustum(const std::array<F32, 16> &viewProjectionMatrix);
+
+  Containment classify(const BoundingBox &boundingBox) const;
+};
@@ -0,0 +1,38 @@
+#pragma once
+
+#include "Types.hpp"
+
+/**
+ * The layout of growth logs, which GrowthLogWriter appends to and GrowthLogReader replays.
+ *
+ * A log starts with this header and continues with one record per logged state of the tree. A record starts with the
+ * number of growth iterations of the tree, the number of metamers it adds, and the number of widths it changes, as a U64
+ * and two U32. Then come, for each added metamer, in creation order:
+ *
+ * - the index of its parent (U32), NoParent for the root;
+ * - one if it is the axillary child of its parent, zero if it is the terminal one (U8);
+ * - its end relative to the end of its parent, where it begins, as three multiples of the position step (I16);
+ * - its width code (U16).
+ *
+ * and, for each changed width, the index of the metamer (U32) and its new width code (U16). Width code zero stands for
+ * no width, and code c for the minimum width times exp((c - 1) * widthLogStep). Everything is little-endian.
+ */
+class GrowthLogHeader {
+public:
+  static constexpr char Magic[8] = {'S', 'O', 'T', 'M', 'G', 'L', 'O', 'G'};
+  static constexpr U32 CurrentVersion = 1;
+  static constexpr U32 NoParent = 0xFFFFFFFF;
+  static constexpr U64 RecordHeaderSize = sizeof(U64) + 2 * sizeof(U32);
+  static constexpr U64 MetamerSize = sizeof(U32) + 1 + 3 * sizeof(I16) + sizeof(U16);
+  static constexpr U64 WidthChangeSize = sizeof(U32) + sizeof(U16);
+
+  char magic[8];
+  U32 version;
+  U32 reserved;
+  F32 rootBeginning[3];
+  F32 positionStep;
+  F32 minimumWidth;
+  F32 widthLogStep;
+};
+
+static_assert(sizeof(GrowthLogHeader) == 40);
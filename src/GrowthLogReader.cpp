@@ -0,0 +1,73 @@
+#include "GrowthLogReader.hpp"
+
+#include <cmath>
+#include <cstring>
+#include <stdexcept>
+
+#include "Trace.hpp"
+
+template <typename T> static T readValue(const char *&bytes) {
+  T value;
+  std::memcpy(&value, bytes, sizeof(value));
+  bytes += sizeof(value);
+  return value;
+}
+
+GrowthLogReader::GrowthLogReader(const std::string &filename) : stream(filename, std::ios::binary), filename(filename) {
+  if (stream.fail()) {
+    throw std::runtime_error("Could not open " + filename + ".");
+  }
+  stream.read(reinterpret_cast<char *>(&header), sizeof(header));
+  if (!stream || std::memcmp(header.magic, GrowthLogHeader::Magic, sizeof(header.magic)) != 0 || header.version != GrowthLogHeader::CurrentVersion) {
+    throw std::runtime_error(filename + " is not a growth log of version " + std::to_string(GrowthLogHeader::CurrentVersion) + ".");
+  }
+}
+
+float GrowthLogReader::decodeWidth(U16 code) const {
+  return code == 0 ? 0.0f : header.minimumWidth * std::exp(header.widthLogStep * (code - 1));
+}
+
+bool GrowthLogReader::readRecord() {
+  TraceScope traceScope("GrowthLogReader::readRecord", "io");
+  char recordHeader[GrowthLogHeader::RecordHeaderSize];
+  if (!stream.read(recordHeader, sizeof(recordHeader))) {
+    return false;
+  }
+  const char *bytes = recordHeader;
+  const auto recordIterations = readValue<U64>(bytes);
+  const auto created = readValue<U32>(bytes);
+  const auto widthChanges = readValue<U32>(bytes);
+  record.resize(created * GrowthLogHeader::MetamerSize + widthChanges * GrowthLogHeader::WidthChangeSize);
+  if (!stream.read(record.data(), static_cast<std::streamsize>(record.size()))) {
+    return false;
+  }
+  bytes = record.data();
+  const auto logged = instances.size();
+  instances.resize(logged + created);
+  for (auto i = logged; i < instances.size(); i++) {
+    const auto parent = readValue<U32>(bytes);
+    // Whether the metamer is axillary is not needed to draw it.
+    readValue<U8>(bytes);
+    const auto dx = readValue<I16>(bytes);
+    const auto dy = readValue<I16>(bytes);
+    const auto dz = readValue<I16>(bytes);
+    const auto widthCode = readValue<U16>(bytes);
+    if ((i == 0) != (parent == GrowthLogHeader::NoParent) || (i != 0 && parent >= i)) {
+      throw std::runtime_error(filename + " has a metamer which does not come after its parent.");
+    }
+    auto &instance = instances[i];
+    instance.beginning = i == 0 ? Point(header.rootBeginning[0], header.rootBeginning[1], header.rootBeginning[2]) : instances[parent].end;
+    instance.end = instance.beginning.translate(header.positionStep * dx, header.positionStep * dy, header.positionStep * dz);
+    instance.width = decodeWidth(widthCode);
+  }
+  for (U32 i = 0; i < widthChanges; i++) {
+    const auto index = readValue<U32>(bytes);
+    const auto widthCode = readValue<U16>(bytes);
+    if (index >= logged) {
+      throw std::runtime_error(filename + " changes the width of a metamer which does not exist yet.");
+    }
+    instances[index].width = decodeWidth(widthCode);
+  }
+  iterations = recordIterations;
+  return true;
+}
@@ -0,0 +1,37 @@
+#pragma once
+
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include "GrowthLogHeader.hpp"
+#include "MetamerInstance.hpp"
+#include "Types.hpp"
+
+/**
+ * Replays a growth log written by GrowthLogWriter, one record at a time, without simulating anything.
+ *
+ * Only the current state is held in memory, so logs of any length stream through.
+ */
+class GrowthLogReader {
+  std::ifstream stream;
+  const std::string filename;
+  GrowthLogHeader header{};
+  std::string record;
+
+  float decodeWidth(U16 code) const;
+
+public:
+  // The number of growth iterations of the tree in the state read last.
+  U64 iterations{};
+
+  // The metamers of the state read last, in creation order.
+  std::vector<MetamerInstance> instances;
+
+  explicit GrowthLogReader(const std::string &filename);
+
+  /**
+   * Applies the next record to the state. Returns false at the end of the log, or at a record which was cut short.
+   */
+  bool readRecord();
+};
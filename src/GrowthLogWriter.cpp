@@ -0,0 +1,127 @@
+#include "GrowthLogWriter.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <stdexcept>
+
+#include "Environment.hpp"
+#include "GrowthLogHeader.hpp"
+#include "Trace.hpp"
+
+// Shoots split their resource among whole metamers, so metamers are shorter than twice the base length. Deltas are
+// relative to decoded ends, which may be off by half a step, and the range leaves room for that.
+static constexpr float PositionStep = 2.0f * Environment::MetamerBaseLength / 32000.0f;
+
+// Widths span from a tenth of the width of a leaf to far beyond any trunk, to within 0.02% of their value.
+static constexpr float MinimumWidth = 1.0e-5f;
+static constexpr float MaximumWidth = 10.0f;
+static constexpr U32 LargestWidthCode = 65535;
+
+static float getWidthLogStep() {
+  return std::log(MaximumWidth / MinimumWidth) / (LargestWidthCode - 1);
+}
+
+static U16 encodeWidth(float width) {
+  if (width <= 0.0f) {
+    return 0;
+  }
+  const auto code = std::lround(std::log(width / MinimumWidth) / getWidthLogStep());
+  return static_cast<U16>(1 + std::clamp<long>(code, 0, LargestWidthCode - 1));
+}
+
+static I16 quantizeDelta(float delta) {
+  const auto quantized = std::lround(delta / PositionStep);
+  return static_cast<I16>(std::clamp<long>(quantized, std::numeric_limits<I16>::min(), std::numeric_limits<I16>::max()));
+}
+
+template <typename T> static void appendValue(std::string &bytes, T value) {
+  bytes.append(reinterpret_cast<const char *>(&value), sizeof(value));
+}
+
+GrowthLogWriter::GrowthLogWriter(const std::string &filename) : stream(filename, std::ios::binary | std::ios::trunc), filename(filename) {
+  if (stream.fail()) {
+    throw std::runtime_error("Could not open " + filename + ".");
+  }
+}
+
+void GrowthLogWriter::append(const Tree &tree) {
+  TraceScope traceScope("GrowthLogWriter::append", "io");
+  const auto &metamers = tree.metamers;
+  if (metamers.size() >= GrowthLogHeader::NoParent) {
+    throw std::runtime_error("Growth logs hold fewer than " + std::to_string(GrowthLogHeader::NoParent) + " metamers.");
+  }
+  if (!headerWritten) {
+    GrowthLogHeader header{};
+    std::memcpy(header.magic, GrowthLogHeader::Magic, sizeof(header.magic));
+    header.version = GrowthLogHeader::CurrentVersion;
+    const auto &rootBeginning = metamers.front()->beginning;
+    header.rootBeginning[0] = rootBeginning.x;
+    header.rootBeginning[1] = rootBeginning.y;
+    header.rootBeginning[2] = rootBeginning.z;
+    header.positionStep = PositionStep;
+    header.minimumWidth = MinimumWidth;
+    header.widthLogStep = getWidthLogStep();
+    stream.write(reinterpret_cast<const char *>(&header), sizeof(header));
+    headerWritten = true;
+  }
+  const auto logged = decodedEnds.size();
+  const auto created = metamers.size() - logged;
+  record.clear();
+  appendValue<U64>(record, tree.iterations);
+  appendValue<U32>(record, static_cast<U32>(created));
+  // The count of width changes is known once they are filtered, and is written over this placeholder.
+  const auto widthChangeCountOffset = record.size();
+  appendValue<U32>(record, 0);
+  // Metamers do not know their parents, so the parents of all new metamers are found in one pass over their children.
+  std::vector<U32> parents(created, GrowthLogHeader::NoParent);
+  std::vector<U8> axillary(created);
+  for (std::size_t i = 0; i < metamers.size(); i++) {
+    const auto &metamer = *metamers[i];
+    if (metamer.axillary && metamer.axillary->index >= logged) {
+      parents[metamer.axillary->index - logged] = static_cast<U32>(i);
+      axillary[metamer.axillary->index - logged] = 1;
+    }
+    if (metamer.terminal && metamer.terminal->index >= logged) {
+      parents[metamer.terminal->index - logged] = static_cast<U32>(i);
+    }
+  }
+  decodedEnds.resize(metamers.size());
+  widthCodes.resize(metamers.size());
+  for (auto i = logged; i < metamers.size(); i++) {
+    const auto &metamer = *metamers[i];
+    const auto parent = parents[i - logged];
+    auto beginning = parent == GrowthLogHeader::NoParent ? metamer.beginning : decodedEnds[parent];
+    const I16 delta[3] = {quantizeDelta(metamer.end.x - beginning.x), quantizeDelta(metamer.end.y - beginning.y),
+                          quantizeDelta(metamer.end.z - beginning.z)};
+    decodedEnds[i] = beginning.translate(PositionStep * delta[0], PositionStep * delta[1], PositionStep * delta[2]);
+    widthCodes[i] = encodeWidth(metamer.width);
+    appendValue<U32>(record, parent);
+    appendValue<U8>(record, axillary[i - logged]);
+    appendValue<I16>(record, delta[0]);
+    appendValue<I16>(record, delta[1]);
+    appendValue<I16>(record, delta[2]);
+    appendValue<U16>(record, widthCodes[i]);
+  }
+  U32 widthChangeCount = 0;
+  for (const auto index : tree.widthChanges) {
+    if (index >= logged) {
+      continue;
+    }
+    // Most changes are too small to change the code, as every new leaf widens all of its ancestors.
+    const auto code = encodeWidth(metamers[index]->width);
+    if (code != widthCodes[index]) {
+      widthCodes[index] = code;
+      appendValue<U32>(record, static_cast<U32>(index));
+      appendValue<U16>(record, code);
+      widthChangeCount++;
+    }
+  }
+  std::memcpy(record.data() + widthChangeCountOffset, &widthChangeCount, sizeof(widthChangeCount));
+  stream.write(record.data(), static_cast<std::streamsize>(record.size()));
+  stream.flush();
+  if (stream.fail()) {
+    throw std::runtime_error("Could not write " + filename + ".");
+  }
+}
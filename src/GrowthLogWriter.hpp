@@ -0,0 +1,35 @@
+#pragma once
+
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include "Point.hpp"
+#include "Tree.hpp"
+#include "Types.hpp"
+
+/**
+ * Appends the growth of a tree to a log, one record per state, from which GrowthLogReader rebuilds every state.
+ *
+ * Records only hold what changed: the metamers created since the last record and the widths whose code changed. Ends
+ * and widths are quantized as in tree files, but with fixed scales, so the header is written before the tree is known
+ * in full. Every record is flushed as a whole, so a log cut short by a crash still replays up to its last record.
+ */
+class GrowthLogWriter {
+  std::ofstream stream;
+  const std::string filename;
+  bool headerWritten = false;
+  // What the reader will have decoded so far, which quantization is relative to.
+  std::vector<Point> decodedEnds;
+  std::vector<U16> widthCodes;
+  std::string record;
+
+public:
+  explicit GrowthLogWriter(const std::string &filename);
+
+  /**
+   * Appends the state of the tree. The first record holds the whole tree, later ones what changed since the previous
+   * record, which relies on the width changes of the tree if a growth iteration happened in between.
+   */
+  void append(const Tree &tree);
+};
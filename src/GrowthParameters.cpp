@@ -0,0 +1,51 @@
+#include "GrowthParameters.hpp"
+
+#include <sstream>
+#include <stdexcept>
+
+std::vector<std::string> GrowthParameters::getNames() {
+  return {"occupancy-radius-factor", "perception-radius-factor", "perception-angle",           "axillary-perturbation-angle",
+          "borchert-honda-alpha",    "borchert-honda-lambda",    "optimal-growth-direction-weight"};
+}
+
+/**
+ * Returns a reference to the parameter with the specified name, which is const if the parameters are const.
+ */
+template <typename Parameters>
+static auto &getParameter(Parameters &parameters, const std::string &name) {
+  if (name == "occupancy-radius-factor") {
+    return parameters.occupancyRadiusFactor;
+  } else if (name == "perception-radius-factor") {
+    return parameters.perceptionRadiusFactor;
+  } else if (name == "perception-angle") {
+    return parameters.perceptionAngle;
+  } else if (name == "axillary-perturbation-angle") {
+    return parameters.axillaryPerturbationAngle;
+  } else if (name == "borchert-honda-alpha") {
+    return parameters.borchertHondaAlpha;
+  } else if (name == "borchert-honda-lambda") {
+    return parameters.borchertHondaLambda;
+  } else if (name == "optimal-growth-direction-weight") {
+    return parameters.optimalGrowthDirectionWeight;
+  }
+  throw std::invalid_argument("There is no growth parameter named " + name + ".");
+}
+
+float GrowthParameters::get(const std::string &name) const {
+  return getParameter(*this, name);
+}
+
+void GrowthParameters::set(const std::string &name, float value) {
+  getParameter(*this, name) = value;
+}
+
+std::string GrowthParameters::toString() const {
+  std::stringstream stream;
+  for (const auto &name : getNames()) {
+    if (stream.tellp() != 0) {
+      stream << ' ';
+    }
+    stream << name << ' ' << get(name);
+  }
+  return stream.str();
+}
@@ -0,0 +1,47 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+/**
+ * The growth parameters which can be changed between simulations.
+ *
+ * The defaults are the values used by the interactive application.
+ */
+class GrowthParameters {
+public:
+  static constexpr auto Pi = 3.1415926535897932384626433832795f;
+
+  float occupancyRadiusFactor = 2.0f;
+  float perceptionRadiusFactor = 4.0f;
+
+  float perceptionAngle = Pi / 2.0f;
+
+  float axillaryPerturbationAngle = Pi / 18.0f;
+
+  float borchertHondaAlpha = 2.0f;
+  float borchertHondaLambda = 0.5f;
+
+  float optimalGrowthDirectionWeight = 0.2f;
+
+  /**
+   * Returns the names of all parameters, such as "perception-radius-factor".
+   */
+  static std::vector<std::string> getNames();
+
+  /**
+   * Gets a parameter by its name.
+   *
+   * Throws std::invalid_argument if there is no parameter with the specified name.
+   */
+  float get(const std::string &name) const;
+
+  /**
+   * Sets a parameter by its name.
+   *
+   * Throws std::invalid_argument if there is no parameter with the specified name.
+   */
+  void set(const std::string &name, float value);
+
+  std::string toString() const;
+};
@@ -0,0 +1,48 @@
+#include "GrowthStatistics.hpp"
+
+#include <iomanip>
+#include <sstream>
+
+void GrowthPhaseStatistics::add(const GrowthPhaseStatistics &other) {
+  seconds += other.seconds;
+  markerSet.add(other.markerSet);
+}
+
+F64 GrowthStatistics::getTotalSeconds() const {
+  const auto growthSeconds = allocation.seconds + lightPropagation.seconds + resourcePropagation.seconds + shootCreation.seconds;
+  return growthSeconds + markerRemoval.seconds + widthUpdate.seconds;
+}
+
+void GrowthStatistics::add(const GrowthStatistics &other) {
+  iteration = other.iteration;
+  metamers = other.metamers;
+  allocation.add(other.allocation);
+  lightPropagation.add(other.lightPropagation);
+  resourcePropagation.add(other.resourcePropagation);
+  shootCreation.add(other.shootCreation);
+  markerRemoval.add(other.markerRemoval);
+  widthUpdate.add(other.widthUpdate);
+  shootsCreated += other.shootsCreated;
+  metamersCreated += other.metamersCreated;
+}
+
+static void writePhase(std::ostream &stream, const std::string &name, const GrowthPhaseStatistics &phase) {
+  const auto &markerSet = phase.markerSet;
+  stream << ", \"" << name << "\": {\"seconds\": " << phase.seconds << ", \"queries\": " << markerSet.queries;
+  stream << ", \"cells-visited\": " << markerSet.cellsVisited << ", \"markers-tested\": " << markerSet.markersTested;
+  stream << ", \"cone-hits\": " << markerSet.coneHits << ", \"markers-removed\": " << markerSet.markersRemoved << "}";
+}
+
+std::string GrowthStatistics::toJson() const {
+  std::stringstream stream;
+  stream << std::setprecision(9);
+  stream << "{\"iteration\": " << iteration << ", \"metamers\": " << metamers << ", \"seconds\": " << getTotalSeconds();
+  writePhase(stream, "allocation", allocation);
+  writePhase(stream, "light-propagation", lightPropagation);
+  writePhase(stream, "resource-propagation", resourcePropagation);
+  writePhase(stream, "shoot-creation", shootCreation);
+  writePhase(stream, "marker-removal", markerRemoval);
+  writePhase(stream, "width-update", widthUpdate);
+  stream << ", \"shoots-created\": " << shootsCreated << ", \"metamers-created\": " << metamersCreated << "}";
+  return stream.str();
+}
@@ -0,0 +1,47 @@
+#pragma once
+
+#include <string>
+
+#include "MarkerSetStatistics.hpp"
+#include "Types.hpp"
+
+class GrowthPhaseStatistics {
+public:
+  F64 seconds{};
+  MarkerSetStatistics markerSet{};
+
+  void add(const GrowthPhaseStatistics &other);
+};
+
+/**
+ * The wall time and the work counters of each phase of a growth iteration.
+ *
+ * Marker removal happens while new shoots are created, but it is accounted separately.
+ */
+class GrowthStatistics {
+public:
+  U64 iteration{};
+  U64 metamers{};
+
+  GrowthPhaseStatistics allocation{};
+  GrowthPhaseStatistics lightPropagation{};
+  GrowthPhaseStatistics resourcePropagation{};
+  GrowthPhaseStatistics shootCreation{};
+  GrowthPhaseStatistics markerRemoval{};
+  GrowthPhaseStatistics widthUpdate{};
+
+  U64 shootsCreated{};
+  U64 metamersCreated{};
+
+  F64 getTotalSeconds() const;
+
+  /**
+   * Accumulates the statistics of another iteration, keeping the iteration and metamer count of the latest one.
+   */
+  void add(const GrowthStatistics &other);
+
+  /**
+   * Returns the statistics as a single-line JSON object.
+   */
+  std::string toJson() const;
+};
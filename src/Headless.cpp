@@ -0,0 +1,245 @@
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <utility>
+
+#include "Environment.hpp"
+#include "GrowthLogWriter.hpp"
+#include "GrowthParameters.hpp"
+#include "GrowthStatistics.hpp"
+#include "MarkerFieldFile.hpp"
+#include "MarkerSet.hpp"
+#include "MeshExporter.hpp"
+#include "PointCloudImporter.hpp"
+#include "Random.hpp"
+#include "ShadowGrid.hpp"
+#include "Trace.hpp"
+#include "Tree.hpp"
+#include "TreeFile.hpp"
+
+static std::string getNextArgument(int argc, char *argv[], int &i) {
+  const auto option = std::string(argv[i]);
+  i++;
+  if (i >= argc) {
+    throw std::invalid_argument("Missing value for " + option + ".");
+  }
+  return std::string(argv[i]);
+}
+
+static float secondsSince(std::chrono::steady_clock::time_point begin) {
+  const std::chrono::duration<float> duration = std::chrono::steady_clock::now() - begin;
+  return duration.count();
+}
+
+static void writeMetamers(std::ostream &stream, const std::unique_ptr<Metamer> &metamer) {
+  if (!metamer) {
+    return;
+  }
+  const auto &b = metamer->beginning;
+  const auto &e = metamer->end;
+  stream << b.x << ' ' << b.y << ' ' << b.z << ' ' << e.x << ' ' << e.y << ' ' << e.z << ' ' << metamer->width << '\n';
+  writeMetamers(stream, metamer->axillary);
+  writeMetamers(stream, metamer->terminal);
+}
+
+/**
+ * Grows a tree without any windowing or OpenGL dependency.
+ *
+ * Growth iterations run back to back until the target metamer count is reached (or growth stalls), so the simulation
+ * is not limited by the display refresh rate. Timings are printed and the results are written to files.
+ */
+int main(int argc, char *argv[]) {
+  U64 targetMetamers = 5 * 1000;
+  U64 seed = 1;
+  float sideLength = 2.0f;
+  U64 resolution = 10;
+  U64 markerCount = 1000 * 1000;
+  auto markerGeneration = MarkerGeneration::Sequential;
+  std::string markerCacheDirectory;
+  auto shadowPropagation = false;
+  U64 shadowResolution = 200;
+  std::string pointCloudFilename;
+  PointCloudImporter pointCloudImporter;
+  std::string summaryFilename = "headless-summary.txt";
+  std::string metamersFilename;
+  std::string meshFilename;
+  std::string treeFilename;
+  std::string growthLogFilename;
+  auto tubes = false;
+  std::string statisticsFilename;
+  std::string traceFilename;
+  GrowthParameters growthParameters;
+  for (int i = 1; i < argc; i++) {
+    const auto argument = std::string(argv[i]);
+    if (argument == "--metamers") {
+      targetMetamers = std::stoull(getNextArgument(argc, argv, i));
+    } else if (argument == "--seed") {
+      seed = std::stoull(getNextArgument(argc, argv, i));
+    } else if (argument == "--side-length") {
+      sideLength = std::stof(getNextArgument(argc, argv, i));
+    } else if (argument == "--resolution") {
+      resolution = std::stoull(getNextArgument(argc, argv, i));
+    } else if (argument == "--markers") {
+      markerCount = std::stoull(getNextArgument(argc, argv, i));
+    } else if (argument == "--marker-generation") {
+      markerGeneration = getMarkerGenerationForName(getNextArgument(argc, argv, i));
+    } else if (argument == "--environment") {
+      const auto name = getNextArgument(argc, argv, i);
+      if (name != "space-colonization" && name != "shadow-propagation") {
+        throw std::invalid_argument("There is no environment named " + name + ".");
+      }
+      shadowPropagation = name == "shadow-propagation";
+    } else if (argument == "--shadow-resolution") {
+      shadowResolution = std::stoull(getNextArgument(argc, argv, i));
+    } else if (argument == "--marker-cache") {
+      markerCacheDirectory = getNextArgument(argc, argv, i);
+    } else if (argument == "--point-cloud") {
+      pointCloudFilename = getNextArgument(argc, argv, i);
+    } else if (argument == "--voxel-size") {
+      pointCloudImporter.voxelSize = std::stof(getNextArgument(argc, argv, i));
+    } else if (argument == "--z-up") {
+      pointCloudImporter.zUp = true;
+    } else if (argument == "--centered") {
+      pointCloudImporter.centered = true;
+    } else if (argument == "--parameter") {
+      const auto name = getNextArgument(argc, argv, i);
+      growthParameters.set(name, std::stof(getNextArgument(argc, argv, i)));
+    } else if (argument == "--summary") {
+      summaryFilename = getNextArgument(argc, argv, i);
+    } else if (argument == "--metamers-file") {
+      metamersFilename = getNextArgument(argc, argv, i);
+    } else if (argument == "--mesh-file") {
+      meshFilename = getNextArgument(argc, argv, i);
+    } else if (argument == "--tree-file") {
+      treeFilename = getNextArgument(argc, argv, i);
+    } else if (argument == "--growth-log") {
+      growthLogFilename = getNextArgument(argc, argv, i);
+    } else if (argument == "--tubes") {
+      tubes = true;
+    } else if (argument == "--statistics") {
+      statisticsFilename = getNextArgument(argc, argv, i);
+    } else if (argument == "--trace") {
+      traceFilename = getNextArgument(argc, argv, i);
+      Trace::enable();
+    } else {
+      std::cerr << "Unknown argument: " << argument << '\n';
+      return 1;
+    }
+  }
+  std::cout << std::fixed << std::setprecision(3);
+  const auto begin = std::chrono::steady_clock::now();
+  SplitMixGenerator splitMixGenerator(seed);
+  pointCloudImporter.resolution = resolution;
+  pointCloudImporter.threadCount = std::max(1U, std::thread::hardware_concurrency());
+  std::optional<MarkerSet> markerSet;
+  if (shadowPropagation) {
+    markerCount = 0;
+  } else if (!pointCloudFilename.empty()) {
+    // The generator still drives the rest of the simulation.
+    markerSet = pointCloudImporter.read(pointCloudFilename);
+    markerCount = markerSet->countMarkers();
+  } else if (!markerCacheDirectory.empty() && markerGeneration == MarkerGeneration::Sequential) {
+    // Only sequential fields are cached, the others can be generated cell by cell.
+    auto markerField = MarkerFieldFile::loadOrGenerate(MarkerFieldSettings{seed, sideLength, resolution, markerCount}, markerCacheDirectory);
+    splitMixGenerator = markerField.splitMixGenerator;
+    markerSet = std::move(markerField.markerSet);
+  } else {
+    markerSet.emplace(splitMixGenerator, sideLength, resolution, markerCount, markerGeneration);
+  }
+  auto environment = shadowPropagation ? Environment(splitMixGenerator, ShadowGrid(sideLength, shadowResolution), growthParameters)
+                                        : Environment(splitMixGenerator, std::move(markerSet.value()), growthParameters);
+  Tree tree(environment, Point{});
+  tree.collectStatistics = true;
+  std::ofstream statisticsStream;
+  if (!statisticsFilename.empty()) {
+    statisticsStream.open(statisticsFilename);
+    if (statisticsStream.fail()) {
+      std::cerr << "Could not open " << statisticsFilename << "." << '\n';
+      return 1;
+    }
+    tree.statisticsStream = &statisticsStream;
+  }
+  std::unique_ptr<GrowthLogWriter> growthLog;
+  if (!growthLogFilename.empty()) {
+    growthLog = std::make_unique<GrowthLogWriter>(growthLogFilename);
+    // The seedling is the first state, and every growth iteration appends the next one.
+    growthLog->append(tree);
+    tree.growthLog = growthLog.get();
+  }
+  GrowthStatistics totalStatistics;
+  const auto markerGenerationDuration = secondsSince(begin);
+  std::cout << "Marker generation: " << markerGenerationDuration << " s" << '\n';
+  std::cout << "Markers: " << markerCount << '\n';
+  const auto growthBegin = std::chrono::steady_clock::now();
+  U64 iterations = 0;
+  auto metamerCount = tree.countMetamers();
+  while (metamerCount < targetMetamers) {
+    const auto iterationBegin = std::chrono::steady_clock::now();
+    tree.performGrowthIteration();
+    totalStatistics.add(tree.statistics);
+    iterations++;
+    const auto previousMetamerCount = metamerCount;
+    metamerCount = tree.countMetamers();
+    std::cout << "Iteration " << iterations << ": " << metamerCount << " metamers in " << secondsSince(iterationBegin) << " s" << '\n';
+    if (metamerCount == previousMetamerCount) {
+      std::cout << "Growth stalled before reaching the target." << '\n';
+      break;
+    }
+  }
+  const auto growthDuration = secondsSince(growthBegin);
+  std::cout << "Growth: " << growthDuration << " s" << '\n';
+  std::cout << "  Allocation: " << totalStatistics.allocation.seconds << " s" << '\n';
+  std::cout << "  Light propagation: " << totalStatistics.lightPropagation.seconds << " s" << '\n';
+  std::cout << "  Resource propagation: " << totalStatistics.resourcePropagation.seconds << " s" << '\n';
+  std::cout << "  Shoot creation: " << totalStatistics.shootCreation.seconds << " s" << '\n';
+  std::cout << "  Marker removal: " << totalStatistics.markerRemoval.seconds << " s" << '\n';
+  std::cout << "  Width update: " << totalStatistics.widthUpdate.seconds << " s" << '\n';
+  std::cout << "Tree bounding box: " << tree.getBoundingBox().toString() << '\n';
+  std::cout << "Metamers: " << metamerCount << '\n';
+  std::ofstream summary(summaryFilename);
+  if (summary.fail()) {
+    std::cerr << "Could not open " << summaryFilename << "." << '\n';
+    return 1;
+  }
+  summary << "Seed: " << seed << '\n';
+  summary << "Markers: " << markerCount << '\n';
+  summary << "Growth parameters: " << growthParameters.toString() << '\n';
+  summary << "Iterations: " << iterations << '\n';
+  summary << "Metamers: " << metamerCount << '\n';
+  summary << "Tree bounding box: " << tree.getBoundingBox().toString() << '\n';
+  summary << "Marker generation: " << markerGenerationDuration << " s" << '\n';
+  summary << "Growth: " << growthDuration << " s" << '\n';
+  summary << "Growth statistics: " << totalStatistics.toJson() << '\n';
+  if (!metamersFilename.empty()) {
+    std::ofstream metamers(metamersFilename);
+    if (metamers.fail()) {
+      std::cerr << "Could not open " << metamersFilename << "." << '\n';
+      return 1;
+    }
+    writeMetamers(metamers, tree.root);
+  }
+  if (!treeFilename.empty()) {
+    TreeFile::write(tree, treeFilename);
+  }
+  if (!meshFilename.empty()) {
+    const auto exportBegin = std::chrono::steady_clock::now();
+    MeshExporter meshExporter;
+    meshExporter.format = MeshExporter::getFormatForFilename(meshFilename);
+    meshExporter.tubes = tubes;
+    meshExporter.threadCount = std::max(1U, std::thread::hardware_concurrency());
+    meshExporter.write(tree, meshFilename);
+    std::cout << "Mesh export: " << secondsSince(exportBegin) << " s" << '\n';
+  }
+  if (!traceFilename.empty()) {
+    Trace::writeChromeJson(traceFilename);
+  }
+  std::cout << "Total: " << secondsSince(begin) << " s" << '\n';
+  return 0;
+}
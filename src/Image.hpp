@@ -7,11 +7,24 @@
 
 #include <opencv2/core/mat.hpp>
 
+/**
+ * An image with 8-bit BGR pixels, wrapping memory owned by someone else.
+ */
 class Image {
   cv::Mat image;
 
 public:
-  Image(std::vector<uint8_t> array, const uint32_t width, const uint32_t height);
+  /**
+   * Wraps the pixels without copying them, so the vector must outlive the image and must not be resized.
+   */
+  Image(std::vector<uint8_t> &pixels, const uint32_t width, const uint32_t height);
+
+  /**
+   * Reverses the order of the rows in place, turning images read from OpenGL (bottom row first) upright.
+   */
+  void flipVertically();
+
+  const cv::Mat &getMat() const;
 
   void writeToFile(const std::string &filename) const;
 };
@@ -0,0 +1,47 @@
+#include "MappedFile.hpp"
+
+#include <stdexcept>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+MappedFile::MappedFile(const std::string &filename) {
+  const auto descriptor = open(filename.c_str(), O_RDONLY);
+  if (descriptor < 0) {
+    throw std::runtime_error("Could not open " + filename + ".");
+  }
+  struct stat status {};
+  if (fstat(descriptor, &status) != 0) {
+    close(descriptor);
+    throw std::runtime_error("Could not read the size of " + filename + ".");
+  }
+  size = static_cast<U64>(status.st_size);
+  // Empty files cannot be mapped, and have no data to point to.
+  if (size == 0) {
+    close(descriptor);
+    return;
+  }
+  void *mapping = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, descriptor, 0);
+  // The mapping keeps the file open on its own.
+  close(descriptor);
+  if (mapping == MAP_FAILED) {
+    throw std::runtime_error("Could not map " + filename + ".");
+  }
+  data = static_cast<const U8 *>(mapping);
+}
+
+MappedFile::~MappedFile() {
+  if (data) {
+    munmap(const_cast<U8 *>(data), size);
+  }
+}
+
+const U8 *MappedFile::getData() const {
+  return data;
+}
+
+U64 MappedFile::getSize() const {
+  return size;
+}
@@ -0,0 +1,26 @@
+#pragma once
+
+#include <string>
+
+#include "Types.hpp"
+
+/**
+ * A whole file mapped read-only into memory, unmapped on destruction.
+ */
+class MappedFile {
+  const U8 *data = nullptr;
+  U64 size = 0;
+
+public:
+  explicit MappedFile(const std::string &filename);
+
+  MappedFile(const MappedFile &) = delete;
+
+  MappedFile &operator=(const MappedFile &) = delete;
+
+  ~MappedFile();
+
+  const U8 *getData() const;
+
+  U64 getSize() const;
+};
@@ -0,0 +1,20 @@
+#include "MarkerField.hpp"
+
+#include <tuple>
+#include <utility>
+
+bool MarkerFieldSettings::operator<(const MarkerFieldSettings &other) const {
+  return std::tie(seed, sideLength, resolution, markerCount) < std::tie(other.seed, other.sideLength, other.resolution, other.markerCount);
+}
+
+bool MarkerFieldSettings::operator==(const MarkerFieldSettings &other) const {
+  return std::tie(seed, sideLength, resolution, markerCount) == std::tie(other.seed, other.sideLength, other.resolution, other.markerCount);
+}
+
+MarkerField::MarkerField(const MarkerFieldSettings &settings)
+    : settings(settings), splitMixGenerator(settings.seed), markerSet(splitMixGenerator, settings.sideLength, settings.resolution, settings.markerCount) {
+}
+
+MarkerField::MarkerField(const MarkerFieldSettings &settings, const SplitMixGenerator &splitMixGenerator, MarkerSet markerSet)
+    : settings(settings), splitMixGenerator(splitMixGenerator), markerSet(std::move(markerSet)) {
+}
@@ -0,0 +1,37 @@
+#pragma once
+
+#include "MarkerSet.hpp"
+#include "Random.hpp"
+#include "Types.hpp"
+
+/**
+ * The parameters which fully determine a generated marker field.
+ */
+class MarkerFieldSettings {
+public:
+  U64 seed = 1;
+  float sideLength = 2.0f;
+  U64 resolution = 10;
+  U64 markerCount = 1000 * 1000;
+
+  bool operator<(const MarkerFieldSettings &other) const;
+
+  bool operator==(const MarkerFieldSettings &other) const;
+};
+
+/**
+ * A generated marker set together with the state of the generator after generating it.
+ *
+ * Simulations which start from the same marker field and copy the generator state are identical to simulations which
+ * generated the marker field themselves.
+ */
+class MarkerField {
+public:
+  MarkerFieldSettings settings;
+  SplitMixGenerator splitMixGenerator;
+  MarkerSet markerSet;
+
+  explicit MarkerField(const MarkerFieldSettings &settings);
+
+  MarkerField(const MarkerFieldSettings &settings, const SplitMixGenerator &splitMixGenerator, MarkerSet markerSet);
+};
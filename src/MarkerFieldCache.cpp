@@ -0,0 +1,57 @@
+#include "MarkerFieldCache.hpp"
+
+#include <stdexcept>
+#include <utility>
+
+#include "MarkerFieldFile.hpp"
+
+MarkerFieldCache::MarkerFieldCache(const std::vector<SimulationSettings> &simulations, std::string cacheDirectory)
+    : cacheDirectory(std::move(cacheDirectory)) {
+  for (const auto &simulation : simulations) {
+    entries[simulation.markerField].remainingUses++;
+  }
+}
+
+std::shared_ptr<const MarkerField> MarkerFieldCache::acquire(const MarkerFieldSettings &settings) {
+  std::promise<std::shared_ptr<const MarkerField>> promise;
+  std::shared_future<std::shared_ptr<const MarkerField>> field;
+  auto mustGenerate = false;
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    const auto iterator = entries.find(settings);
+    if (iterator == std::end(entries)) {
+      throw std::logic_error("Acquired a marker field which was not expected.");
+    }
+    auto &entry = iterator->second;
+    if (!entry.field.valid()) {
+      entry.field = promise.get_future().share();
+      mustGenerate = true;
+    }
+    field = entry.field;
+  }
+  // Generate outside of the lock, so that simulations using other fields are not blocked.
+  if (mustGenerate) {
+    try {
+      if (cacheDirectory.empty()) {
+        promise.set_value(std::make_shared<const MarkerField>(settings));
+      } else {
+        promise.set_value(std::make_shared<const MarkerField>(MarkerFieldFile::loadOrGenerate(settings, cacheDirectory)));
+      }
+    } catch (...) {
+      promise.set_exception(std::current_exception());
+    }
+  }
+  return field.get();
+}
+
+void MarkerFieldCache::release(const MarkerFieldSettings &settings) {
+  std::lock_guard<std::mutex> lock(mutex);
+  const auto iterator = entries.find(settings);
+  if (iterator == std::end(entries)) {
+    throw std::logic_error("Released a marker field which was not expected.");
+  }
+  iterator->second.remainingUses--;
+  if (iterator->second.remainingUses == 0) {
+    entries.erase(iterator);
+  }
+}
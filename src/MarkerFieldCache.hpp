@@ -0,0 +1,45 @@
+#pragma once
+
+#include <future>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "MarkerField.hpp"
+#include "SimulationSettings.hpp"
+#include "Types.hpp"
+
+/**
+ * Shares immutable marker fields between concurrent simulations.
+ *
+ * Each field is generated once, by the first simulation which needs it, and dropped as soon as the last simulation
+ * which needs it releases it. If the simulations are started in the order of SweepSpecification::expand, the number of
+ * fields in memory is bounded by the number of concurrent simulations. If there is a cache directory, fields are read
+ * from it, and generated fields are written to it.
+ */
+class MarkerFieldCache {
+  class Entry {
+  public:
+    std::shared_future<std::shared_ptr<const MarkerField>> field;
+    U64 remainingUses{};
+  };
+
+  std::mutex mutex;
+  std::map<MarkerFieldSettings, Entry> entries;
+  const std::string cacheDirectory;
+
+public:
+  MarkerFieldCache(const std::vector<SimulationSettings> &simulations, std::string cacheDirectory);
+
+  /**
+   * Returns the marker field, generating it if no other simulation has.
+   */
+  std::shared_ptr<const MarkerField> acquire(const MarkerFieldSettings &settings);
+
+  /**
+   * Signals that a simulation no longer needs the marker field.
+   */
+  void release(const MarkerFieldSettings &settings);
+};
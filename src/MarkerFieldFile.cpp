@@ -0,0 +1,159 @@
+#include "MarkerFieldFile.hpp"
+
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <limits>
+#include <sstream>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include <unistd.h>
+
+#include "MappedFile.hpp"
+#include "Trace.hpp"
+
+static constexpr char MarkerFieldFileMagic[8] = {'S', 'O', 'T', 'M', 'M', 'A', 'R', 'K'};
+static constexpr U32 MarkerFieldFileVersion = 1;
+
+/**
+ * The beginning of every marker field file, followed by the positions of the markers.
+ */
+class MarkerFieldFileHeader {
+public:
+  char magic[8];
+  U32 version;
+  U32 reserved;
+  U64 seed;
+  F32 sideLength;
+  U32 reservedSideLength;
+  U64 resolution;
+  U64 markerCount;
+  U64 generatorState;
+  U64 positionsOffset;
+};
+
+static_assert(sizeof(MarkerFieldFileHeader) == 64);
+static_assert(std::is_trivially_copyable_v<MarkerFieldFileHeader>);
+
+std::string MarkerFieldFile::getFilename(const std::string &directory, const MarkerFieldSettings &settings) {
+  std::stringstream stream;
+  // Nine significant digits tell every float apart.
+  stream << std::setprecision(std::numeric_limits<float>::max_digits10);
+  stream << "markers-" << settings.seed << '-' << settings.sideLength << '-' << settings.resolution << '-' << settings.markerCount << ".bin";
+  return (std::filesystem::path(directory) / stream.str()).string();
+}
+
+std::optional<MarkerField> MarkerFieldFile::read(const std::string &filename, const MarkerFieldSettings &settings) {
+  TraceScope traceScope("MarkerFieldFile::read", "io");
+  if (!std::filesystem::exists(filename)) {
+    return std::nullopt;
+  }
+  const MappedFile file(filename);
+  const auto *data = file.getData();
+  const auto size = file.getSize();
+  MarkerFieldFileHeader header{};
+  if (size < sizeof(header)) {
+    return std::nullopt;
+  }
+  std::memcpy(&header, data, sizeof(header));
+  const auto resolution = settings.resolution;
+  const auto positionsSize = 3 * sizeof(F32) * settings.markerCount;
+  const auto valid = std::memcmp(header.magic, MarkerFieldFileMagic, sizeof(MarkerFieldFileMagic)) == 0 && header.version == MarkerFieldFileVersion &&
+                     header.seed == settings.seed && header.sideLength == settings.sideLength && header.resolution == resolution &&
+                     header.markerCount == settings.markerCount && header.positionsOffset % alignof(F32) == 0 && header.positionsOffset <= size &&
+                     positionsSize <= size - header.positionsOffset;
+  if (!valid || resolution < 1 || settings.markerCount % (resolution * resolution * resolution) != 0) {
+    return std::nullopt;
+  }
+  const auto sideLength = settings.sideLength;
+  MarkerSet markerSet(Range(-0.5f * sideLength, +0.5f * sideLength), Range(0.0f, sideLength), Range(-0.5f * sideLength, +0.5f * sideLength), resolution);
+  const auto pointsPerBox = settings.markerCount / (resolution * resolution * resolution);
+  const auto *positions = reinterpret_cast<const F32 *>(data + header.positionsOffset);
+  for (auto &xVector : markerSet.markers) {
+    for (auto &xyVector : xVector) {
+      for (auto &xyzVector : xyVector) {
+        xyzVector.resize(pointsPerBox);
+        for (auto &marker : xyzVector) {
+          marker.position = Point(positions[0], positions[1], positions[2]);
+          positions += 3;
+        }
+      }
+    }
+  }
+  return MarkerField(settings, SplitMixGenerator(header.generatorState), std::move(markerSet));
+}
+
+void MarkerFieldFile::write(const MarkerField &markerField, const std::string &filename) {
+  TraceScope traceScope("MarkerFieldFile::write", "io");
+  const auto &settings = markerField.settings;
+  MarkerFieldFileHeader header{};
+  std::memcpy(header.magic, MarkerFieldFileMagic, sizeof(MarkerFieldFileMagic));
+  header.version = MarkerFieldFileVersion;
+  header.seed = settings.seed;
+  header.sideLength = settings.sideLength;
+  header.resolution = settings.resolution;
+  header.markerCount = settings.markerCount;
+  header.generatorState = markerField.splitMixGenerator.getState();
+  header.positionsOffset = sizeof(header);
+  std::vector<F32> positions;
+  positions.reserve(3 * settings.markerCount);
+  for (const auto &xVector : markerField.markerSet.markers) {
+    for (const auto &xyVector : xVector) {
+      for (const auto &xyzVector : xyVector) {
+        for (const auto &marker : xyzVector) {
+          positions.push_back(marker.position.x);
+          positions.push_back(marker.position.y);
+          positions.push_back(marker.position.z);
+        }
+      }
+    }
+  }
+  if (positions.size() != 3 * settings.markerCount) {
+    throw std::logic_error("Only marker fields as generated can be written.");
+  }
+  const auto temporaryFilename = filename + ".tmp" + std::to_string(getpid());
+  std::ofstream stream(temporaryFilename, std::ios::binary | std::ios::trunc);
+  if (stream.fail()) {
+    throw std::runtime_error("Could not open " + temporaryFilename + ".");
+  }
+  stream.write(reinterpret_cast<const char *>(&header), sizeof(header));
+  stream.write(reinterpret_cast<const char *>(positions.data()), static_cast<std::streamsize>(positions.size() * sizeof(F32)));
+  stream.close();
+  if (stream.fail()) {
+    std::error_code error;
+    std::filesystem::remove(temporaryFilename, error);
+    throw std::runtime_error("Could not write " + temporaryFilename + ".");
+  }
+  std::error_code error;
+  std::filesystem::rename(temporaryFilename, filename, error);
+  if (error) {
+    std::filesystem::remove(temporaryFilename, error);
+    throw std::runtime_error("Could not rename " + temporaryFilename + " to " + filename + ".");
+  }
+}
+
+MarkerField MarkerFieldFile::loadOrGenerate(const MarkerFieldSettings &settings, const std::string &directory) {
+  const auto filename = getFilename(directory, settings);
+  // The cache only ever spares generating the field, so a cache which cannot be read or written is skipped.
+  try {
+    auto markerField = read(filename, settings);
+    if (markerField) {
+      return std::move(markerField.value());
+    }
+  } catch (const std::runtime_error &) {
+  }
+  MarkerField generated(settings);
+  std::error_code error;
+  std::filesystem::create_directories(directory, error);
+  if (!error) {
+    try {
+      write(generated, filename);
+    } catch (const std::runtime_error &) {
+    }
+  }
+  return generated;
+}
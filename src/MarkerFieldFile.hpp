@@ -0,0 +1,38 @@
+#pragma once
+
+#include <optional>
+#include <string>
+
+#include "MarkerField.hpp"
+
+/**
+ * Stores generated marker fields on disk, so that runs with the same field settings map them instead of generating them.
+ *
+ * A file starts with a 64-byte header holding the field settings and the state of the generator after generating the
+ * field, followed by the positions of the markers as three F32 each, cell after cell in the order of MarkerSet::markers.
+ * Every cell of a generated field holds the same number of markers, so the positions are all that is stored.
+ */
+class MarkerFieldFile {
+public:
+  /**
+   * Returns the file of the field in the directory, named after its seed, side length, resolution, and marker count.
+   */
+  static std::string getFilename(const std::string &directory, const MarkerFieldSettings &settings);
+
+  /**
+   * Maps the file and copies the field out of it, or returns nothing if there is no such file, or if it does not hold a
+   * field with these settings.
+   */
+  static std::optional<MarkerField> read(const std::string &filename, const MarkerFieldSettings &settings);
+
+  /**
+   * Writes the field to a temporary file which then replaces the file, so that concurrent runs never map a partial one.
+   */
+  static void write(const MarkerField &markerField, const std::string &filename);
+
+  /**
+   * Reads the field from the directory, or generates it and writes it there. If the directory cannot be read or written,
+   * the field is generated all the same, and the cache is skipped.
+   */
+  static MarkerField loadOrGenerate(const MarkerFieldSettings &settings, const std::string &directory);
+};
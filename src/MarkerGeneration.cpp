@@ -0,0 +1,16 @@
+#include "MarkerGeneration.hpp"
+
+#include <stdexcept>
+
+MarkerGeneration getMarkerGenerationForName(const std::string &name) {
+  if (name == "sequential") {
+    return MarkerGeneration::Sequential;
+  }
+  if (name == "per-cell") {
+    return MarkerGeneration::PerCell;
+  }
+  if (name == "lazy") {
+    return MarkerGeneration::Lazy;
+  }
+  throw std::invalid_argument("Unknown marker generation " + name + ", expected sequential, per-cell, or lazy.");
+}
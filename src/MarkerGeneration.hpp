@@ -0,0 +1,20 @@
+#pragma once
+
+#include <string>
+
+#include "Types.hpp"
+
+/**
+ * How a marker set fills its cells with random markers.
+ *
+ * Sequential draws every marker from the generator of the simulation, cell after cell. PerCell gives every cell a
+ * generator of its own, seeded from the generator of the simulation and the index of the cell, so that cells can be
+ * filled in any order. Lazy fills cells as PerCell does, but only when a query first reaches them, so markers which no
+ * bud ever perceives are never generated, and the results are the same as with PerCell.
+ */
+enum class MarkerGeneration : U32 { Sequential, PerCell, Lazy };
+
+/**
+ * Returns the generation named sequential, per-cell, or lazy.
+ */
+MarkerGeneration getMarkerGenerationForName(const std::string &name);
@@ -1,13 +1,27 @@
 #include "MarkerSet.hpp"
 
 #include <algorithm>
+#include <cmath>
 #include <stdexcept>
 
 #include "PointAverage.hpp"
 #include "Random.hpp"
+#include "Trace.hpp"
 
-MarkerSet::MarkerSet(SplitMixGenerator &splitMixGenerator, float sideLength, U64 resolution, U64 pointCount)
-    : xRange(-0.5f * sideLength, +0.5 * sideLength), yRange(0.0f, sideLength), zRange(-0.5f * sideLength, +0.5 * sideLength), resolution(resolution) {
+// Cells with fewer markers are tested marker by marker, as classifying them would cost about as much.
+static constexpr U64 MinimumClassifiedCellMarkers = 64;
+
+// The finalizer of SplitMix64, which turns consecutive cell indices into unrelated seeds.
+static U64 getCellSeed(U64 fieldSeed, U64 cellIndex) {
+  auto z = fieldSeed + (cellIndex + 1) * 0x9E3779B97F4A7C15ULL;
+  z = (z ^ (z >> 30U)) * 0xBF58476D1CE4E5B9ULL;
+  z = (z ^ (z >> 27U)) * 0x94D049BB133111EBULL;
+  return z ^ (z >> 31U);
+}
+
+MarkerSet::MarkerSet(SplitMixGenerator &splitMixGenerator, float sideLength, U64 resolution, U64 pointCount, MarkerGeneration generation)
+    : generation(generation), xRange(-0.5f * sideLength, +0.5 * sideLength), yRange(0.0f, sideLength), zRange(-0.5f * sideLength, +0.5 * sideLength),
+      resolution(resolution) {
   if (sideLength <= 0.0f) {
     throw std::domain_error("Side length cannot be <= 0.0f.");
   }
@@ -18,30 +32,114 @@ MarkerSet::MarkerSet(SplitMixGenerator &splitMixGenerator, float sideLength, U64
   if (pointCount % boxes != 0) {
     throw std::domain_error("Point count should be evenly divisible between the boxes.");
   }
-  const auto pointsPerBox = pointCount / boxes;
+  pointsPerBox = pointCount / boxes;
+  if (generation != MarkerGeneration::Sequential) {
+    // Two draws, in separate statements so that their order is defined.
+    fieldSeed = static_cast<U64>(splitMixGenerator.next()) << 32U;
+    fieldSeed |= splitMixGenerator.next();
+  }
+  markers.resize(resolution);
+  for (auto &xVector : markers) {
+    xVector.resize(resolution);
+    for (auto &xyVector : xVector) {
+      xyVector.resize(resolution);
+    }
+  }
+  if (generation == MarkerGeneration::Lazy) {
+    generatedCells.resize(boxes);
+    return;
+  }
   for (U64 x = 0; x < resolution; x++) {
-    markers.emplace_back();
-    const auto xRangeMin = xRange.interpolate(x, resolution);
-    const auto xRangeMax = xRange.interpolate(x + 1, resolution);
     for (U64 y = 0; y < resolution; y++) {
-      markers[x].emplace_back();
-      const auto yRangeMin = yRange.interpolate(y, resolution);
-      const auto yRangeMax = yRange.interpolate(y + 1, resolution);
       for (U64 z = 0; z < resolution; z++) {
-        markers[x][y].emplace_back();
-        const auto zRangeMin = zRange.interpolate(z, resolution);
-        const auto zRangeMax = zRange.interpolate(z + 1, resolution);
-        for (U64 i = 0; i < pointsPerBox; i++) {
-          markers[x][y][z].emplace_back();
-          markers[x][y][z][i].position.x = splitMixGenerator.nextUniformInRange(xRangeMin, xRangeMax);
-          markers[x][y][z][i].position.y = splitMixGenerator.nextUniformInRange(yRangeMin, yRangeMax);
-          markers[x][y][z][i].position.z = splitMixGenerator.nextUniformInRange(zRangeMin, zRangeMax);
+        if (generation == MarkerGeneration::Sequential) {
+          generateCell(splitMixGenerator, x, y, z);
+        } else {
+          SplitMixGenerator cellGenerator(getCellSeed(fieldSeed, (x * resolution + y) * resolution + z));
+          generateCell(cellGenerator, x, y, z);
         }
       }
     }
   }
 }
 
+void MarkerSet::generateCell(SplitMixGenerator &splitMixGenerator, U64 x, U64 y, U64 z) {
+  const auto xRangeMin = xRange.interpolate(x, resolution);
+  const auto xRangeMax = xRange.interpolate(x + 1, resolution);
+  const auto yRangeMin = yRange.interpolate(y, resolution);
+  const auto yRangeMax = yRange.interpolate(y + 1, resolution);
+  const auto zRangeMin = zRange.interpolate(z, resolution);
+  const auto zRangeMax = zRange.interpolate(z + 1, resolution);
+  auto &xyzVector = markers[x][y][z];
+  xyzVector.reserve(pointsPerBox);
+  for (U64 i = 0; i < pointsPerBox; i++) {
+    xyzVector.emplace_back();
+    xyzVector.back().position.x = splitMixGenerator.nextUniformInRange(xRangeMin, xRangeMax);
+    xyzVector.back().position.y = splitMixGenerator.nextUniformInRange(yRangeMin, yRangeMax);
+    xyzVector.back().position.z = splitMixGenerator.nextUniformInRange(zRangeMin, zRangeMax);
+  }
+}
+
+void MarkerSet::generateCellsInRanges(const MarkerSetRanges &ranges) {
+  if (generation != MarkerGeneration::Lazy) {
+    return;
+  }
+  for (auto x = ranges.minX; x < ranges.maxX; x++) {
+    for (auto y = ranges.minY; y < ranges.maxY; y++) {
+      for (auto z = ranges.minZ; z < ranges.maxZ; z++) {
+        const auto cellIndex = (x * resolution + y) * resolution + z;
+        if (!generatedCells[cellIndex]) {
+          SplitMixGenerator cellGenerator(getCellSeed(fieldSeed, cellIndex));
+          generateCell(cellGenerator, x, y, z);
+          generatedCells[cellIndex] = true;
+        }
+      }
+    }
+  }
+}
+
+MarkerSet::MarkerSet(Range xRange, Range yRange, Range zRange, U64 resolution)
+    : xRange(xRange), yRange(yRange), zRange(zRange), resolution(resolution) {
+  if (!(xRange.getLength() > 0.0f && yRange.getLength() > 0.0f && zRange.getLength() > 0.0f)) {
+    throw std::domain_error("Ranges must be longer than 0.0f.");
+  }
+  if (resolution < 1) {
+    throw std::domain_error("Resolution must be at least 1.");
+  }
+  markers.resize(resolution);
+  for (auto &xVector : markers) {
+    xVector.resize(resolution);
+    for (auto &xyVector : xVector) {
+      xyVector.resize(resolution);
+    }
+  }
+}
+
+static U64 getCell(Range range, U64 resolution, float x) {
+  const auto step = range.getLength() / static_cast<float>(resolution);
+  const auto cell = std::clamp(std::floor((x - range.minimum) / step), 0.0f, static_cast<float>(resolution - 1));
+  return static_cast<U64>(cell);
+}
+
+U64 MarkerSet::getCellIndex(Point point) const {
+  const auto x = getCell(xRange, resolution, point.x);
+  const auto y = getCell(yRange, resolution, point.y);
+  const auto z = getCell(zRange, resolution, point.z);
+  return (x * resolution + y) * resolution + z;
+}
+
+U64 MarkerSet::countMarkers() const {
+  U64 count = 0;
+  for (const auto &xVector : markers) {
+    for (const auto &xyVector : xVector) {
+      for (const auto &xyzVector : xyVector) {
+        count += xyzVector.size();
+      }
+    }
+  }
+  return count;
+}
+
 void MarkerSet::resetAllocations() {
   for (auto &xVector : markers) {
     for (auto &xyVector : xVector) {
@@ -55,11 +153,33 @@ void MarkerSet::resetAllocations() {
 }
 
 void MarkerSet::updateAllocatedInCone(BudId budId, Point origin, Vector direction, float theta, float r) {
+  TraceScope traceScope("MarkerSet::updateAllocatedInCone", "marker-query", Trace::shouldSample());
+  MarkerSetStatistics queryStatistics{};
   const auto ranges = getRangesForSphere(origin, r);
+  generateCellsInRanges(ranges);
+  const Cone cone(origin, direction, theta, r);
   for (auto x = ranges.minX; x < ranges.maxX; x++) {
     for (auto y = ranges.minY; y < ranges.maxY; y++) {
       for (auto z = ranges.minZ; z < ranges.maxZ; z++) {
-        for (auto &marker : markers[x][y][z]) {
+        queryStatistics.cellsVisited++;
+        const auto containment = classifyCell(cone, x, y, z);
+        if (containment == Containment::Outside) {
+          continue;
+        }
+        auto &xyzVector = markers[x][y][z];
+        // Markers of cells inside of the cone skip the tests against the cone, but are still compared with their allocation.
+        queryStatistics.markersTested += xyzVector.size();
+        if (containment == Containment::Inside) {
+          // Every marker of the cell is within the distance and the angle.
+          for (auto &marker : xyzVector) {
+            if (marker.position.distance(origin) < marker.distanceToAllocated) {
+              marker.allocationId = budId;
+              queryStatistics.coneHits++;
+            }
+          }
+          continue;
+        }
+        for (auto &marker : xyzVector) {
           const auto point = marker.position;
           const auto distanceFromBud = point.distance(origin);
           // Is within the distance?
@@ -69,6 +189,7 @@ void MarkerSet::updateAllocatedInCone(BudId budId, Point origin, Vector directio
               // Is within angle?
               if (Vector(origin, point).angleBetween(direction) < theta) {
                 marker.allocationId = budId;
+                queryStatistics.coneHits++;
               }
             }
           }
@@ -76,32 +197,51 @@ void MarkerSet::updateAllocatedInCone(BudId budId, Point origin, Vector directio
       }
     }
   }
+  recordQuery(queryStatistics);
 }
 
 SpaceAnalysis MarkerSet::getAllocatedInCone(BudId budId, Point origin, Vector direction, float theta, float r) const {
+  TraceScope traceScope("MarkerSet::getAllocatedInCone", "marker-query", Trace::shouldSample());
+  MarkerSetStatistics queryStatistics{};
   Vector sumOfNormalizedVectors{};
   auto foundMarker = false;
+  // Cells which lazy generation has not filled are empty, and they hold no allocated marker anyway, as allocation fills
+  // every cell it reaches.
   const auto ranges = getRangesForSphere(origin, r);
+  const Cone cone(origin, direction, theta, r);
   for (auto x = ranges.minX; x < ranges.maxX; x++) {
     for (auto y = ranges.minY; y < ranges.maxY; y++) {
       for (auto z = ranges.minZ; z < ranges.maxZ; z++) {
+        queryStatistics.cellsVisited++;
+        queryStatistics.markersTested += markers[x][y][z].size();
+        // Only markers within the cone were allocated to the bud, so cells without any of them are never worth classifying
+        // and are not. The others are classified when their first one is found.
+        auto containment = Containment::Intersecting;
+        auto classified = false;
         for (const auto &marker : markers[x][y][z]) {
           if (marker.allocationId != budId) {
             continue;
           }
-          const auto point = marker.position;
-          // Is within the distance?
-          if (point.distance(origin) < r) {
-            // Is within angle?
-            if (Vector(origin, point).angleBetween(direction) < theta) {
-              foundMarker = true;
-              sumOfNormalizedVectors = sumOfNormalizedVectors.add(Vector(origin, point).normalize());
+          if (!classified) {
+            containment = classifyCell(cone, x, y, z);
+            classified = true;
+            if (containment == Containment::Outside) {
+              break;
             }
           }
+          const auto inside = containment == Containment::Inside;
+          const auto point = marker.position;
+          // Is within the distance and the angle, unless the whole cell is?
+          if (inside || (point.distance(origin) < r && Vector(origin, point).angleBetween(direction) < theta)) {
+            foundMarker = true;
+            queryStatistics.coneHits++;
+            sumOfNormalizedVectors = sumOfNormalizedVectors.add(Vector(origin, point).normalize());
+          }
         }
       }
     }
   }
+  recordQuery(queryStatistics);
   SpaceAnalysis spaceAnalysis{};
   if (foundMarker) {
     spaceAnalysis.q = 1.0f;
@@ -110,17 +250,104 @@ SpaceAnalysis MarkerSet::getAllocatedInCone(BudId budId, Point origin, Vector di
   return spaceAnalysis;
 }
 
+bool MarkerSet::hasAllocatedInCone(BudId budId, Point origin, Vector direction, float theta, float r) const {
+  TraceScope traceScope("MarkerSet::hasAllocatedInCone", "marker-query", Trace::shouldSample());
+  MarkerSetStatistics queryStatistics{};
+  const auto ranges = getRangesForSphere(origin, r);
+  const Cone cone(origin, direction, theta, r);
+  const auto isAllocated = [budId](const Marker &marker) { return marker.allocationId == budId; };
+  for (auto x = ranges.minX; x < ranges.maxX; x++) {
+    for (auto y = ranges.minY; y < ranges.maxY; y++) {
+      for (auto z = ranges.minZ; z < ranges.maxZ; z++) {
+        const auto &xyzVector = markers[x][y][z];
+        queryStatistics.cellsVisited++;
+        auto containment = Containment::Intersecting;
+        auto marker = std::find_if(std::begin(xyzVector), std::end(xyzVector), isAllocated);
+        if (marker != std::end(xyzVector)) {
+          containment = classifyCell(cone, x, y, z);
+        }
+        for (; marker != std::end(xyzVector) && containment != Containment::Outside; marker = std::find_if(marker + 1, std::end(xyzVector), isAllocated)) {
+          const auto point = marker->position;
+          if (containment == Containment::Inside || (point.distance(origin) < r && Vector(origin, point).angleBetween(direction) < theta)) {
+            queryStatistics.markersTested += std::distance(std::begin(xyzVector), marker) + 1;
+            queryStatistics.coneHits++;
+            recordQuery(queryStatistics);
+            return true;
+          }
+        }
+        queryStatistics.markersTested += xyzVector.size();
+      }
+    }
+  }
+  recordQuery(queryStatistics);
+  return false;
+}
+
 void MarkerSet::removeMarkersInSphere(Point center, float radius) {
+  TraceScope traceScope("MarkerSet::removeMarkersInSphere", "marker-query", Trace::shouldSample());
+  MarkerSetStatistics queryStatistics{};
   const auto ranges = getRangesForSphere(center, radius);
+  // Cells are filled before markers are removed from them, so that removed markers are not generated again later.
+  generateCellsInRanges(ranges);
   for (auto x = ranges.minX; x < ranges.maxX; x++) {
     for (auto y = ranges.minY; y < ranges.maxY; y++) {
       for (auto z = ranges.minZ; z < ranges.maxZ; z++) {
         auto &xyzVector = markers[x][y][z];
+        queryStatistics.cellsVisited++;
+        queryStatistics.markersTested += xyzVector.size();
         const auto predicate = [center, radius](Marker &marker) { return marker.position.distance(center) < radius; };
-        xyzVector.erase(std::remove_if(std::begin(xyzVector), std::end(xyzVector), predicate), std::end(xyzVector));
+        const auto removed = std::remove_if(std::begin(xyzVector), std::end(xyzVector), predicate);
+        queryStatistics.markersRemoved += std::distance(removed, std::end(xyzVector));
+        xyzVector.erase(removed, std::end(xyzVector));
       }
     }
   }
+  recordQuery(queryStatistics);
+}
+
+void MarkerSet::allocate(BudId budId, Point origin, Vector direction, float theta, float r) {
+  updateAllocatedInCone(budId, origin, direction, theta, r);
+}
+
+float MarkerSet::getLight(BudId budId, Point origin, Vector direction, float theta, float r) const {
+  return hasAllocatedInCone(budId, origin, direction, theta, r) ? 1.0f : 0.0f;
+}
+
+SpaceAnalysis MarkerSet::analyze(BudId budId, Point origin, Vector direction, float theta, float r) const {
+  return getAllocatedInCone(budId, origin, direction, theta, r);
+}
+
+void MarkerSet::occupy(Point center, float radius) {
+  removeMarkersInSphere(center, radius);
+}
+
+void MarkerSet::recordQuery(const MarkerSetStatistics &queryStatistics) const {
+  if (statistics) {
+    statistics->add(queryStatistics);
+    statistics->queries++;
+  }
+}
+
+// Only used to classify cells, which leaves a margin for the rounding of the bounds of generated cells.
+static void setCellRange(Range &cellRange, Range range, U64 resolution, U64 cell) {
+  const auto step = (range.maximum - range.minimum) / static_cast<float>(resolution);
+  cellRange.minimum = range.minimum + static_cast<float>(cell) * step;
+  cellRange.maximum = cellRange.minimum + step;
+}
+
+Containment MarkerSet::classifyCell(const Cone &cone, U64 x, U64 y, U64 z) const {
+  if (markers[x][y][z].size() < MinimumClassifiedCellMarkers) {
+    return Containment::Intersecting;
+  }
+  return cone.classify(getCellBoundingBox(x, y, z));
+}
+
+BoundingBox MarkerSet::getCellBoundingBox(U64 x, U64 y, U64 z) const {
+  BoundingBox boundingBox;
+  setCellRange(boundingBox.xRange, xRange, resolution, x);
+  setCellRange(boundingBox.yRange, yRange, resolution, y);
+  setCellRange(boundingBox.zRange, zRange, resolution, z);
+  return boundingBox;
 }
 
 static Range getRange(Range range, float resolution, float x, float radius) {
@@ -2,8 +2,14 @@
 
 #include <vector>
 
+#include "BoundingBox.hpp"
+#include "Cone.hpp"
+#include "Containment.hpp"
+#include "EnvironmentModel.hpp"
 #include "Marker.hpp"
+#include "MarkerGeneration.hpp"
 #include "MarkerSetRanges.hpp"
+#include "MarkerSetStatistics.hpp"
 #include "Point.hpp"
 #include "Random.hpp"
 #include "Range.hpp"
@@ -11,7 +17,16 @@
 #include "Types.hpp"
 #include "Vector.hpp"
 
-class MarkerSet {
+/**
+ * Computes the environment of buds by space colonization, as the markers of free space which each bud perceives.
+ */
+class MarkerSet : public EnvironmentModel {
+  MarkerGeneration generation = MarkerGeneration::Sequential;
+  U64 fieldSeed{};
+  U64 pointsPerBox{};
+  // With lazy generation, whether each cell, indexed as by getCellIndex, was filled.
+  std::vector<bool> generatedCells;
+
 public:
   Range xRange;
   Range yRange;
@@ -21,16 +36,69 @@ public:
 
   std::vector<std::vector<std::vector<std::vector<Marker>>>> markers;
 
-  MarkerSet(SplitMixGenerator &splitMixGenerator, float sideLength, U64 resolution, U64 pointCount);
+  MarkerSet(SplitMixGenerator &splitMixGenerator, float sideLength, U64 resolution, U64 pointCount,
+            MarkerGeneration generation = MarkerGeneration::Sequential);
+
+  /**
+   * Creates a marker set without markers, whose cells split the box into resolution parts along each axis.
+   */
+  MarkerSet(Range xRange, Range yRange, Range zRange, U64 resolution);
+
+  /**
+   * Returns the index of the cell which contains the point, (x * resolution + y) * resolution + z, or of the nearest
+   * cell if the point is outside of the marker set.
+   */
+  U64 getCellIndex(Point point) const;
+
+  /**
+   * Counts the markers in the set. With lazy generation, only the markers of the cells filled so far are counted.
+   */
+  U64 countMarkers() const;
+
+  void resetAllocations() override;
+
+  /**
+   * Allocates to the bud the markers in its cone which are closer to it than to the buds they were allocated to.
+   */
+  void allocate(BudId budId, Point origin, Vector direction, float theta, float r) override;
+
+  /**
+   * Returns 1 if markers in the cone are allocated to the bud, and 0 otherwise.
+   */
+  float getLight(BudId budId, Point origin, Vector direction, float theta, float r) const override;
 
-  void resetAllocations();
+  SpaceAnalysis analyze(BudId budId, Point origin, Vector direction, float theta, float r) const override;
+
+  /**
+   * Removes the markers in the sphere.
+   */
+  void occupy(Point center, float radius) override;
 
   void updateAllocatedInCone(BudId budId, Point origin, Vector direction, float theta, float r);
 
   SpaceAnalysis getAllocatedInCone(BudId budId, Point origin, Vector direction, float theta, float r) const;
 
+  /**
+   * Returns whether any marker in the cone is allocated to the bud, which is whether getAllocatedInCone would find a q
+   * of 1, stopping at the first such marker.
+   */
+  bool hasAllocatedInCone(BudId budId, Point origin, Vector direction, float theta, float r) const;
+
   void removeMarkersInSphere(Point center, float radius);
 
 private:
+  void generateCell(SplitMixGenerator &splitMixGenerator, U64 x, U64 y, U64 z);
+
+  void generateCellsInRanges(const MarkerSetRanges &ranges);
+
   MarkerSetRanges getRangesForSphere(Point origin, float radius) const;
+
+  /**
+   * Classifies the cell against the cone, or reports it as intersecting if it holds too few markers to be worth it.
+   */
+  Containment classifyCell(const Cone &cone, U64 x, U64 y, U64 z) const;
+
+  BoundingBox getCellBoundingBox(U64 x, U64 y, U64 z) const;
+
+  void recordQuery(const MarkerSetStatistics &queryStatistics) const;
 };
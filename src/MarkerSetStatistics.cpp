@@ -0,0 +1,9 @@
+#include "MarkerSetStatistics.hpp"
+
+void MarkerSetStatistics::add(const MarkerSetStatistics &other) {
+  queries += other.queries;
+  cellsVisited += other.cellsVisited;
+  markersTested += other.markersTested;
+  coneHits += other.coneHits;
+  markersRemoved += other.markersRemoved;
+}
@@ -0,0 +1,17 @@
+#pragma once
+
+#include "Types.hpp"
+
+/**
+ * Counts the work done by marker set queries.
+ */
+class MarkerSetStatistics {
+public:
+  U64 queries{};
+  U64 cellsVisited{};
+  U64 markersTested{};
+  U64 coneHits{};
+  U64 markersRemoved{};
+
+  void add(const MarkerSetStatistics &other);
+};
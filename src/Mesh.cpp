@@ -0,0 +1,5 @@
+#include "Mesh.hpp"
+
+U64 Mesh::countTriangles() const {
+  return indices.size() / 3;
+}
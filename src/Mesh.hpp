@@ -0,0 +1,18 @@
+#pragma once
+
+#include <vector>
+
+#include "Types.hpp"
+#include "Vertex.hpp"
+
+/**
+ * An indexed triangle mesh, laid out so that it can be copied into vertex and index buffers as is.
+ */
+class Mesh {
+public:
+  std::vector<Vertex> vertices;
+  // Every three indices make a triangle.
+  std::vector<U32> indices;
+
+  U64 countTriangles() const;
+};
@@ -0,0 +1,392 @@
+#include "MeshExporter.hpp"
+
+#include <algorithm>
+#include <cctype>
+#include <charconv>
+#include <cstring>
+#include <exception>
+#include <fstream>
+#include <limits>
+#include <sstream>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+#include "CylinderMeshBuilder.hpp"
+#include "Mesh.hpp"
+#include "Trace.hpp"
+#include "TubeMeshBuilder.hpp"
+
+// PLY faces are a count byte followed by three vertex indices.
+constexpr U64 PlyFaceSize = 1 + 3 * sizeof(U32);
+
+/**
+ * A run of consecutive axes, identified by their first metamers, and the range of the mesh they make.
+ */
+class Chunk {
+public:
+  std::vector<const Metamer *> axisStarts;
+  U64 metamerCount{};
+  U64 firstVertex{};
+  U64 vertexCount{};
+  U64 firstIndex{};
+  U64 indexCount{};
+};
+
+/**
+ * The bytes of a chunk, split between the vertex and the index regions of the file, and the bounds of its positions.
+ */
+class EncodedChunk {
+public:
+  std::string vertices;
+  std::string indices;
+  Point minimum{std::numeric_limits<float>::infinity(), std::numeric_limits<float>::infinity(), std::numeric_limits<float>::infinity()};
+  Point maximum{-std::numeric_limits<float>::infinity(), -std::numeric_limits<float>::infinity(), -std::numeric_limits<float>::infinity()};
+  std::exception_ptr error;
+};
+
+/**
+ * Builds the mesh of axes as either tubes or one cylinder per metamer.
+ */
+class AxisMeshBuilder {
+  const bool tubes;
+  TubeMeshBuilder tubeMeshBuilder;
+  CylinderMeshBuilder cylinderMeshBuilder;
+  const Mesh cylinder;
+
+public:
+  explicit AxisMeshBuilder(bool tubes) : tubes(tubes), cylinder(cylinderMeshBuilder.build()) {
+  }
+
+  U64 countVertices(U64 axisMetamers) const {
+    return tubes ? tubeMeshBuilder.countAxisVertices(axisMetamers) : axisMetamers * cylinderMeshBuilder.countVertices();
+  }
+
+  U64 countIndices(U64 axisMetamers) const {
+    return tubes ? tubeMeshBuilder.countAxisIndices(axisMetamers) : axisMetamers * cylinderMeshBuilder.countIndices();
+  }
+
+  void addAxis(Mesh &mesh, const std::vector<const Metamer *> &axis) const {
+    if (tubes) {
+      tubeMeshBuilder.addAxis(mesh, axis);
+      return;
+    }
+    for (const auto metamer : axis) {
+      CylinderMeshBuilder::addMetamer(mesh, cylinder, *metamer);
+    }
+  }
+};
+
+static std::string getExtension(const std::string &filename) {
+  const auto dot = filename.find_last_of('.');
+  const auto slash = filename.find_last_of('/');
+  if (dot == std::string::npos || (slash != std::string::npos && dot < slash)) {
+    return "";
+  }
+  auto extension = filename.substr(dot + 1);
+  std::transform(std::begin(extension), std::end(extension), std::begin(extension), [](unsigned char c) { return std::tolower(c); });
+  return extension;
+}
+
+static std::string getBinaryFilename(const std::string &filename) {
+  const auto dot = filename.find_last_of('.');
+  return filename.substr(0, dot) + ".bin";
+}
+
+static std::string getBasename(const std::string &filename) {
+  const auto slash = filename.find_last_of('/');
+  return slash == std::string::npos ? filename : filename.substr(slash + 1);
+}
+
+static void appendFloat(std::string &text, float value) {
+  char buffer[32];
+  const auto result = std::to_chars(buffer, buffer + sizeof(buffer), value);
+  text.append(buffer, result.ptr);
+}
+
+static void appendInteger(std::string &text, U64 value) {
+  char buffer[32];
+  const auto result = std::to_chars(buffer, buffer + sizeof(buffer), value);
+  text.append(buffer, result.ptr);
+}
+
+static void appendBytes(std::string &bytes, const void *data, std::size_t size) {
+  bytes.append(static_cast<const char *>(data), size);
+}
+
+/**
+ * Splits the axes of the tree, in the order TubeMeshBuilder visits them, into chunks of about the specified size.
+ */
+static std::vector<Chunk> partition(const Tree &tree, const AxisMeshBuilder &axisMeshBuilder, U64 chunkMetamers) {
+  std::vector<Chunk> chunks(1);
+  std::vector<const Metamer *> axisStarts{tree.root.get()};
+  while (!axisStarts.empty()) {
+    const auto axisStart = axisStarts.back();
+    axisStarts.pop_back();
+    U64 axisMetamers = 0;
+    for (const Metamer *metamer = axisStart; metamer != nullptr; metamer = metamer->terminal.get()) {
+      axisMetamers++;
+      if (metamer->axillary) {
+        axisStarts.push_back(metamer->axillary.get());
+      }
+    }
+    if (chunks.back().metamerCount >= chunkMetamers) {
+      const auto &previous = chunks.back();
+      Chunk chunk;
+      chunk.firstVertex = previous.firstVertex + previous.vertexCount;
+      chunk.firstIndex = previous.firstIndex + previous.indexCount;
+      chunks.push_back(std::move(chunk));
+    }
+    auto &chunk = chunks.back();
+    chunk.axisStarts.push_back(axisStart);
+    chunk.metamerCount += axisMetamers;
+    chunk.vertexCount += axisMeshBuilder.countVertices(axisMetamers);
+    chunk.indexCount += axisMeshBuilder.countIndices(axisMetamers);
+  }
+  return chunks;
+}
+
+static Mesh buildChunk(const Chunk &chunk, const AxisMeshBuilder &axisMeshBuilder) {
+  Mesh mesh;
+  mesh.vertices.reserve(chunk.vertexCount);
+  mesh.indices.reserve(chunk.indexCount);
+  std::vector<const Metamer *> axis;
+  for (const auto axisStart : chunk.axisStarts) {
+    axis.clear();
+    for (const Metamer *metamer = axisStart; metamer != nullptr; metamer = metamer->terminal.get()) {
+      axis.push_back(metamer);
+    }
+    axisMeshBuilder.addAxis(mesh, axis);
+  }
+  if (mesh.vertices.size() != chunk.vertexCount || mesh.indices.size() != chunk.indexCount) {
+    throw std::logic_error("The mesh of a chunk does not match its counts.");
+  }
+  return mesh;
+}
+
+/**
+ * Encodes the mesh of a chunk, whose indices start from zero, for its place in the whole mesh.
+ *
+ * Binary formats are little-endian, as are the hosts this is built for, so vertices are copied as they are.
+ */
+static EncodedChunk encodeChunk(const Chunk &chunk, const Mesh &mesh, MeshFormat format) {
+  EncodedChunk encoded;
+  const auto baseVertex = static_cast<U32>(chunk.firstVertex);
+  if (format == MeshFormat::Obj) {
+    for (const auto &vertex : mesh.vertices) {
+      encoded.vertices += "v ";
+      appendFloat(encoded.vertices, vertex.position.x);
+      encoded.vertices += ' ';
+      appendFloat(encoded.vertices, vertex.position.y);
+      encoded.vertices += ' ';
+      appendFloat(encoded.vertices, vertex.position.z);
+      encoded.vertices += "\nvn ";
+      appendFloat(encoded.vertices, vertex.normal.x);
+      encoded.vertices += ' ';
+      appendFloat(encoded.vertices, vertex.normal.y);
+      encoded.vertices += ' ';
+      appendFloat(encoded.vertices, vertex.normal.z);
+      encoded.vertices += '\n';
+    }
+    for (std::size_t i = 0; i < mesh.indices.size(); i += 3) {
+      encoded.indices += 'f';
+      for (std::size_t j = i; j < i + 3; j++) {
+        // Positions and normals are numbered together, from one.
+        const auto index = chunk.firstVertex + mesh.indices[j] + 1;
+        encoded.indices += ' ';
+        appendInteger(encoded.indices, index);
+        encoded.indices += "//";
+        appendInteger(encoded.indices, index);
+      }
+      encoded.indices += '\n';
+    }
+    return encoded;
+  }
+  appendBytes(encoded.vertices, mesh.vertices.data(), mesh.vertices.size() * sizeof(Vertex));
+  if (format == MeshFormat::Ply) {
+    encoded.indices.resize(mesh.indices.size() / 3 * PlyFaceSize);
+    auto *face = encoded.indices.data();
+    for (std::size_t i = 0; i < mesh.indices.size(); i += 3) {
+      const U32 triangle[3] = {baseVertex + mesh.indices[i], baseVertex + mesh.indices[i + 1], baseVertex + mesh.indices[i + 2]};
+      face[0] = 3;
+      std::memcpy(face + 1, triangle, sizeof(triangle));
+      face += PlyFaceSize;
+    }
+    return encoded;
+  }
+  encoded.indices.resize(mesh.indices.size() * sizeof(U32));
+  std::vector<U32> indices(mesh.indices);
+  for (auto &index : indices) {
+    index += baseVertex;
+  }
+  std::memcpy(encoded.indices.data(), indices.data(), encoded.indices.size());
+  for (const auto &vertex : mesh.vertices) {
+    const auto &p = vertex.position;
+    encoded.minimum = Point(std::min(encoded.minimum.x, p.x), std::min(encoded.minimum.y, p.y), std::min(encoded.minimum.z, p.z));
+    encoded.maximum = Point(std::max(encoded.maximum.x, p.x), std::max(encoded.maximum.y, p.y), std::max(encoded.maximum.z, p.z));
+  }
+  return encoded;
+}
+
+static std::string getPlyHeader(U64 vertexCount, U64 triangleCount) {
+  std::stringstream header;
+  header << "ply" << '\n';
+  header << "format binary_little_endian 1.0" << '\n';
+  header << "comment Branches of a self-organizing tree model" << '\n';
+  header << "element vertex " << vertexCount << '\n';
+  header << "property float x" << '\n';
+  header << "property float y" << '\n';
+  header << "property float z" << '\n';
+  header << "property float nx" << '\n';
+  header << "property float ny" << '\n';
+  header << "property float nz" << '\n';
+  header << "element face " << triangleCount << '\n';
+  header << "property list uchar uint vertex_indices" << '\n';
+  header << "end_header" << '\n';
+  return header.str();
+}
+
+static std::string getPointJson(Point point) {
+  std::string json = "[";
+  appendFloat(json, point.x);
+  json += ',';
+  appendFloat(json, point.y);
+  json += ',';
+  appendFloat(json, point.z);
+  return json + "]";
+}
+
+static std::string getGltfJson(const std::string &binaryUri, U64 vertexCount, U64 indexCount, Point minimum, Point maximum) {
+  const auto vertexBytes = vertexCount * sizeof(Vertex);
+  const auto indexBytes = indexCount * sizeof(U32);
+  std::stringstream json;
+  json << "{\"asset\":{\"version\":\"2.0\",\"generator\":\"self-organizing-tree-models\"},";
+  json << "\"scene\":0,\"scenes\":[{\"nodes\":[0]}],\"nodes\":[{\"mesh\":0}],";
+  json << "\"meshes\":[{\"primitives\":[{\"attributes\":{\"POSITION\":0,\"NORMAL\":1},\"indices\":2}]}],";
+  json << "\"buffers\":[{\"uri\":\"" << binaryUri << "\",\"byteLength\":" << vertexBytes + indexBytes << "}],";
+  // 34962 is ARRAY_BUFFER and 34963 is ELEMENT_ARRAY_BUFFER.
+  json << "\"bufferViews\":[{\"buffer\":0,\"byteOffset\":0,\"byteLength\":" << vertexBytes << ",\"byteStride\":" << sizeof(Vertex)
+       << ",\"target\":34962},";
+  json << "{\"buffer\":0,\"byteOffset\":" << vertexBytes << ",\"byteLength\":" << indexBytes << ",\"target\":34963}],";
+  // 5126 is FLOAT and 5125 is UNSIGNED_INT.
+  json << "\"accessors\":[{\"bufferView\":0,\"byteOffset\":0,\"componentType\":5126,\"count\":" << vertexCount << ",\"type\":\"VEC3\",";
+  json << "\"min\":" << getPointJson(minimum) << ",\"max\":" << getPointJson(maximum) << "},";
+  json << "{\"bufferView\":0,\"byteOffset\":" << sizeof(Point) << ",\"componentType\":5126,\"count\":" << vertexCount << ",\"type\":\"VEC3\"},";
+  json << "{\"bufferView\":1,\"byteOffset\":0,\"componentType\":5125,\"count\":" << indexCount << ",\"type\":\"SCALAR\"}]}" << '\n';
+  return json.str();
+}
+
+static void openStream(std::ofstream &stream, const std::string &filename, std::ios::openmode mode) {
+  stream.open(filename, mode);
+  if (stream.fail()) {
+    throw std::runtime_error("Could not open " + filename + ".");
+  }
+}
+
+MeshFormat MeshExporter::getFormatForFilename(const std::string &filename) {
+  const auto extension = getExtension(filename);
+  if (extension == "ply") {
+    return MeshFormat::Ply;
+  }
+  if (extension == "gltf") {
+    return MeshFormat::Gltf;
+  }
+  if (extension == "obj") {
+    return MeshFormat::Obj;
+  }
+  throw std::invalid_argument("Unknown mesh format for " + filename + ", expected .ply, .gltf, or .obj.");
+}
+
+void MeshExporter::write(const Tree &tree, const std::string &filename) const {
+  TraceScope traceScope("MeshExporter::write", "io");
+  if (!tree.root) {
+    throw std::invalid_argument("Cannot export the mesh of a tree without metamers.");
+  }
+  if (chunkMetamers == 0 || threadCount == 0) {
+    throw std::invalid_argument("Exporting needs chunks of at least one metamer and at least one thread.");
+  }
+  const AxisMeshBuilder axisMeshBuilder(tubes);
+  const auto chunks = partition(tree, axisMeshBuilder, chunkMetamers);
+  const auto vertexCount = chunks.back().firstVertex + chunks.back().vertexCount;
+  const auto indexCount = chunks.back().firstIndex + chunks.back().indexCount;
+  if (vertexCount > std::numeric_limits<U32>::max()) {
+    throw std::runtime_error("The mesh has more vertices than 32-bit indices can address.");
+  }
+  // Vertices and indices go to separate regions of the file, whose offsets are known up front, so each region is written
+  // sequentially through its own stream. OBJ has no fixed sizes, so both are appended to a single stream instead.
+  std::ofstream vertexStream;
+  std::ofstream indexStream;
+  U64 vertexRegionBegin = 0;
+  U64 indexRegionBegin = 0;
+  std::string binaryFilename = filename;
+  if (format == MeshFormat::Ply) {
+    const auto header = getPlyHeader(vertexCount, indexCount / 3);
+    openStream(vertexStream, filename, std::ios::binary | std::ios::trunc);
+    vertexStream << header;
+    vertexRegionBegin = header.size();
+    indexRegionBegin = vertexRegionBegin + vertexCount * sizeof(Vertex);
+  } else if (format == MeshFormat::Gltf) {
+    binaryFilename = getBinaryFilename(filename);
+    openStream(vertexStream, binaryFilename, std::ios::binary | std::ios::trunc);
+    indexRegionBegin = vertexCount * sizeof(Vertex);
+  } else {
+    openStream(vertexStream, filename, std::ios::binary | std::ios::trunc);
+  }
+  if (format != MeshFormat::Obj) {
+    // Opening for reading as well keeps the file which the vertex stream created.
+    openStream(indexStream, binaryFilename, std::ios::binary | std::ios::in | std::ios::out);
+    indexStream.seekp(static_cast<std::streamoff>(indexRegionBegin));
+  }
+  Point minimum = EncodedChunk{}.minimum;
+  Point maximum = EncodedChunk{}.maximum;
+  // At most one chunk per thread is held in memory at a time.
+  std::vector<EncodedChunk> batch(threadCount);
+  for (std::size_t batchBegin = 0; batchBegin < chunks.size(); batchBegin += threadCount) {
+    const auto batchEnd = std::min<std::size_t>(chunks.size(), batchBegin + threadCount);
+    const auto work = [&](std::size_t i) {
+      TraceScope chunkTraceScope("MeshExporter::encodeChunk", "io");
+      try {
+        batch[i - batchBegin] = encodeChunk(chunks[i], buildChunk(chunks[i], axisMeshBuilder), format);
+      } catch (...) {
+        batch[i - batchBegin].error = std::current_exception();
+      }
+    };
+    std::vector<std::thread> threads;
+    for (auto i = batchBegin + 1; i < batchEnd; i++) {
+      threads.emplace_back(work, i);
+    }
+    work(batchBegin);
+    for (auto &thread : threads) {
+      thread.join();
+    }
+    for (auto i = batchBegin; i < batchEnd; i++) {
+      auto &encoded = batch[i - batchBegin];
+      if (encoded.error) {
+        std::rethrow_exception(encoded.error);
+      }
+      vertexStream << encoded.vertices;
+      (format == MeshFormat::Obj ? vertexStream : indexStream) << encoded.indices;
+      minimum = Point(std::min(minimum.x, encoded.minimum.x), std::min(minimum.y, encoded.minimum.y), std::min(minimum.z, encoded.minimum.z));
+      maximum = Point(std::max(maximum.x, encoded.maximum.x), std::max(maximum.y, encoded.maximum.y), std::max(maximum.z, encoded.maximum.z));
+      encoded = EncodedChunk{};
+    }
+    if (vertexStream.fail() || indexStream.fail()) {
+      throw std::runtime_error("Could not write " + binaryFilename + ".");
+    }
+  }
+  vertexStream.close();
+  if (indexStream.is_open()) {
+    indexStream.close();
+  }
+  if (vertexStream.fail() || indexStream.fail()) {
+    throw std::runtime_error("Could not write " + binaryFilename + ".");
+  }
+  if (format == MeshFormat::Gltf) {
+    std::ofstream json;
+    openStream(json, filename, std::ios::trunc);
+    json << getGltfJson(getBasename(binaryFilename), vertexCount, indexCount, minimum, maximum);
+    if (json.fail()) {
+      throw std::runtime_error("Could not write " + filename + ".");
+    }
+  }
+}
@@ -0,0 +1,39 @@
+#pragma once
+
+#include <string>
+
+#include "MeshFormat.hpp"
+#include "Tree.hpp"
+#include "Types.hpp"
+
+/**
+ * Writes the branch mesh of a tree to a file without ever holding the whole mesh in memory.
+ *
+ * The axes of the tree are split, in depth-first order, into chunks of whole axes, so a chunk is mostly one subtree.
+ * The sizes of all chunks are counted first, so every chunk knows where its vertices and triangles go. Batches of
+ * chunks are then meshed and encoded in parallel and written in order, so memory is bounded by the batch size.
+ */
+class MeshExporter {
+public:
+  MeshFormat format = MeshFormat::Ply;
+
+  // One tube per axis, as built by TubeMeshBuilder, instead of the cylinder OpenGlWindow draws for each metamer.
+  bool tubes = false;
+
+  // Chunks are closed once they reach this many metamers, so only the last one may be smaller. Small chunks stay in the
+  // caches between being meshed and encoded.
+  U64 chunkMetamers = 1024;
+
+  U32 threadCount = 1;
+
+  /**
+   * Returns the format which the extension of the filename stands for (.ply, .gltf, or .obj).
+   */
+  static MeshFormat getFormatForFilename(const std::string &filename);
+
+  /**
+   * Writes the mesh of the tree. In the glTF format, the binary buffer is written next to the file, with the .bin
+   * extension.
+   */
+  void write(const Tree &tree, const std::string &filename) const;
+};
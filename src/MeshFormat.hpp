@@ -0,0 +1,8 @@
+#pragma once
+
+#include "Types.hpp"
+
+/**
+ * A file format which branch meshes can be exported to: binary PLY, glTF with a separate binary buffer, or OBJ.
+ */
+enum class MeshFormat : U32 { Ply, Gltf, Obj };
@@ -8,6 +8,9 @@
 
 class Metamer {
 public:
+  // The position of this metamer in the creation order of its tree.
+  U64 index{};
+
   Point beginning{};
   Point end{};
 
@@ -0,0 +1,8 @@
+#include "MetamerInstance.hpp"
+
+BoundingBox MetamerInstance::getBoundingBox() const {
+  const Range xRange(std::min(beginning.x, end.x) - width, std::max(beginning.x, end.x) + width);
+  const Range yRange(std::min(beginning.y, end.y) - width, std::max(beginning.y, end.y) + width);
+  const Range zRange(std::min(beginning.z, end.z) - width, std::max(beginning.z, end.z) + width);
+  return BoundingBox(xRange, yRange, zRange);
+}
@@ -0,0 +1,22 @@
+#pragma once
+
+#include "BoundingBox.hpp"
+#include "Point.hpp"
+#include "Types.hpp"
+
+/**
+ * The per-instance attributes of a metamer cylinder, as laid out in the OpenGL instance buffer.
+ */
+class MetamerInstance {
+public:
+  Point beginning{};
+  Point end{};
+  F32 width{};
+
+  /**
+   * Bounds the cylinder, whatever the level of detail it is drawn with.
+   */
+  BoundingBox getBoundingBox() const;
+};
+
+static_assert(sizeof(MetamerInstance) == 7 * sizeof(F32));
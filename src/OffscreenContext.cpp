@@ -0,0 +1,84 @@
+#include "OffscreenContext.hpp"
+
+#include <EGL/eglext.h>
+
+#include <stdexcept>
+#include <string>
+
+static bool hasExtension(const char *extensions, const std::string &extension) {
+  if (extensions == nullptr) {
+    return false;
+  }
+  const std::string list = std::string(" ") + extensions + " ";
+  return list.find(" " + extension + " ") != std::string::npos;
+}
+
+static EGLDisplay getDisplay() {
+  const auto clientExtensions = eglQueryString(EGL_NO_DISPLAY, EGL_EXTENSIONS);
+  if (hasExtension(clientExtensions, "EGL_MESA_platform_surfaceless") && hasExtension(clientExtensions, "EGL_EXT_platform_base")) {
+    const auto getPlatformDisplay = reinterpret_cast<PFNEGLGETPLATFORMDISPLAYEXTPROC>(eglGetProcAddress("eglGetPlatformDisplayEXT"));
+    if (getPlatformDisplay != nullptr) {
+      const auto display = getPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, nullptr);
+      if (display != EGL_NO_DISPLAY) {
+        return display;
+      }
+    }
+  }
+  return eglGetDisplay(EGL_DEFAULT_DISPLAY);
+}
+
+OffscreenContext::OffscreenContext(int majorVersion, int minorVersion) {
+  display = getDisplay();
+  if (display == EGL_NO_DISPLAY || !eglInitialize(display, nullptr, nullptr)) {
+    throw std::runtime_error("Could not initialize an EGL display.");
+  }
+  if (!eglBindAPI(EGL_OPENGL_API)) {
+    release();
+    throw std::runtime_error("EGL does not support OpenGL.");
+  }
+  const auto surfaceless = hasExtension(eglQueryString(display, EGL_EXTENSIONS), "EGL_KHR_surfaceless_context");
+  const EGLint configAttributes[] = {EGL_SURFACE_TYPE, surfaceless ? 0 : EGL_PBUFFER_BIT, EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT, EGL_NONE};
+  EGLConfig config;
+  EGLint configCount = 0;
+  if (!eglChooseConfig(display, configAttributes, &config, 1, &configCount) || configCount == 0) {
+    release();
+    throw std::runtime_error("Could not find an EGL configuration for OpenGL.");
+  }
+  if (!surfaceless) {
+    // The size does not matter, as nothing is drawn to this surface.
+    const EGLint surfaceAttributes[] = {EGL_WIDTH, 1, EGL_HEIGHT, 1, EGL_NONE};
+    surface = eglCreatePbufferSurface(display, config, surfaceAttributes);
+  }
+  const EGLint contextAttributes[] = {EGL_CONTEXT_MAJOR_VERSION,
+                                      majorVersion,
+                                      EGL_CONTEXT_MINOR_VERSION,
+                                      minorVersion,
+                                      EGL_CONTEXT_OPENGL_PROFILE_MASK,
+                                      EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT,
+                                      EGL_NONE};
+  context = eglCreateContext(display, config, EGL_NO_CONTEXT, contextAttributes);
+  if (context == EGL_NO_CONTEXT || !eglMakeCurrent(display, surface, surface, context)) {
+    const auto version = std::to_string(majorVersion) + "." + std::to_string(minorVersion);
+    release();
+    throw std::runtime_error("Could not create an off-screen OpenGL " + version + " context.");
+  }
+}
+
+OffscreenContext::~OffscreenContext() {
+  release();
+}
+
+void OffscreenContext::release() {
+  eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+  if (context != EGL_NO_CONTEXT) {
+    eglDestroyContext(display, context);
+  }
+  if (surface != EGL_NO_SURFACE) {
+    eglDestroySurface(display, surface);
+  }
+  eglTerminate(display);
+}
+
+void *OffscreenContext::getProcAddress(const char *name) {
+  return reinterpret_cast<void *>(eglGetProcAddress(name));
+}
@@ -0,0 +1,28 @@
+#pragma once
+
+#include <EGL/egl.h>
+
+/**
+ * An OpenGL context which is not tied to any window or display server, created through EGL.
+ *
+ * Mesa's surfaceless platform is preferred, so that no display is needed at all (this works with llvmpipe). Drawing
+ * should go to framebuffer objects, as there is no default framebuffer, or only a minimal pbuffer one.
+ */
+class OffscreenContext {
+  EGLDisplay display = EGL_NO_DISPLAY;
+  EGLSurface surface = EGL_NO_SURFACE;
+  EGLContext context = EGL_NO_CONTEXT;
+
+  void release();
+
+public:
+  OffscreenContext(int majorVersion, int minorVersion);
+
+  OffscreenContext(const OffscreenContext &) = delete;
+
+  OffscreenContext &operator=(const OffscreenContext &) = delete;
+
+  ~OffscreenContext();
+
+  static void *getProcAddress(const char *name);
+};
@@ -1,20 +1,38 @@
 #include "OpenGlWindow.hpp"
 
+#include <algorithm>
 #include <cmath>
+#include <cstddef>
 #include <iostream>
+#include <limits>
 #include <stdexcept>
+#include <string>
 #include <vector>
 
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtc/type_ptr.hpp>
 
+#include "Camera.hpp"
 #include "Color.hpp"
-#include "Text.hpp"
+#include "CylinderMeshBuilder.hpp"
+#include "ProgramBinaryCache.hpp"
+#include "Shaders.hpp"
+#include "Trace.hpp"
 #include "Types.hpp"
+#include "Vertex.hpp"
 
 constexpr U32 CylinderFaces = 16;
+constexpr int OpenGlMajorVersion = 4;
+constexpr int OpenGlMinorVersion = 5;
 constexpr U32 MultiSamplingSamples = 16;
+constexpr U64 InitialInstanceCapacity = 1 << 16;
+// Must match the local size of the level of detail selection program.
+constexpr U64 LevelOfDetailWorkGroupSize = 64;
+// Must match the local size of the depth pyramid program, in both directions.
+constexpr I32 DepthPyramidWorkGroupSide = 8;
+constexpr float NearPlaneDistance = 0.01f;
+constexpr float FarPlaneDistance = 100.0f;
 
 static UserAction getUserActionFromKey(int key) {
   switch (key) {
@@ -53,15 +71,9 @@ static void testCompilation(const std::string &filename, GLuint shader) {
   }
 }
 
-GLuint loadShader(const std::string &filename, GLint type) {
-  std::string vertexShaderSource = readFileContent(filename);
-  const auto begin = std::begin(vertexShaderSource);
-  const auto end = std::end(vertexShaderSource);
-  std::vector<GLchar> vertexShaderSourceArray(begin, end);
-  vertexShaderSourceArray.push_back('\0');
+GLuint loadShader(const std::string &filename, const char *source, GLint type) {
   const auto shader = glCreateShader(type);
-  const auto *sourcePointer = vertexShaderSourceArray.data();
-  glShaderSource(shader, 1, &sourcePointer, nullptr);
+  glShaderSource(shader, 1, &source, nullptr);
   glCompileShader(shader);
   testCompilation(filename, shader);
   return shader;
@@ -79,6 +91,7 @@ GLuint linkProgram(const std::vector<GLuint> &shaders) {
   for (const auto shader : shaders) {
     glAttachShader(program, shader);
   }
+  glProgramParameteri(program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
   glLinkProgram(program);
   GLint linkStatus;
   glGetProgramiv(program, GL_LINK_STATUS, &linkStatus);
@@ -95,222 +108,554 @@ GLuint linkProgram(const std::vector<GLuint> &shaders) {
   return program;
 }
 
-void OpenGlWindow::initializePrograms() {
-  const auto vertexShaderPath = "../shaders/OpenGlVertexShader.glsl";
-  const auto vertexShader = loadShader(vertexShaderPath, GL_VERTEX_SHADER);
-  const auto fragmentShaderPath = "../shaders/OpenGlFragmentShader.glsl";
-  const auto fragmentShader = loadShader(fragmentShaderPath, GL_FRAGMENT_SHADER);
-  openGlCylinderProgram = linkProgram({vertexShader, fragmentShader});
-  glUseProgram(openGlCylinderProgram);
-  const auto vertexColorUniform = glGetUniformLocation(openGlCylinderProgram, "vertexColor");
-  openGlCylinderProgramVertexColorUniformLocation = vertexColorUniform;
-  const auto modelUniform = glGetUniformLocation(openGlCylinderProgram, "modelMatrix");
-  openGlCylinderProgramModelMatrixUniformLocation = modelUniform;
-  const auto modelInverseTransposedUniform = glGetUniformLocation(openGlCylinderProgram, "modelInverseTransposedMatrix");
-  openGlCylinderProgramModelInverseTransposedMatrixUniformLocation = modelInverseTransposedUniform;
-  const auto viewUniform = glGetUniformLocation(openGlCylinderProgram, "viewMatrix");
-  openGlCylinderProgramViewMatrixUniformLocation = viewUniform;
-  const auto projectionUniform = glGetUniformLocation(openGlCylinderProgram, "projectionMatrix");
-  openGlCylinderProgramProjectionMatrixUniformLocation = projectionUniform;
-  const auto cameraPositionUniform = glGetUniformLocation(openGlCylinderProgram, "cameraPositionInWorld");
-  openGlCylinderProgramCameraPositionInWorldUniformLocation = cameraPositionUniform;
-  const auto lightPositionUniform = glGetUniformLocation(openGlCylinderProgram, "lightPositionInWorld");
-  openGlCylinderProgramLightPositionInWorldUniformLocation = lightPositionUniform;
-  const auto ambientLightIntensityUniform = glGetUniformLocation(openGlCylinderProgram, "ambientLightIntensity");
-  openGlCylinderProgramAmbientLightIntensityUniformLocation = ambientLightIntensityUniform;
-}
-
-static void pushBackValues(std::vector<float> &values, float x, float y, float z) {
-  values.push_back(x);
-  values.push_back(y);
-  values.push_back(z);
-}
-
-static void addDiskVertices(std::vector<float> &values, float y, float ny) {
-  for (uint32_t i = 0; i < CylinderFaces; i++) {
-    pushBackValues(values, 0.0f, y, 0.0f);
-    pushBackValues(values, 0.0f, ny, 0.0f);
-    const auto thetaA = 2.0f * 4.0f * std::atan(1.0f) / CylinderFaces * i;
-    pushBackValues(values, std::cos(thetaA), y, std::sin(thetaA));
-    pushBackValues(values, 0.0f, ny, 0.0f);
-    const auto thetaB = 2.0f * 4.0f * std::atan(1.0f) / CylinderFaces * (i + 1);
-    pushBackValues(values, std::cos(thetaB), y, std::sin(thetaB));
-    pushBackValues(values, 0.0f, ny, 0.0f);
-  }
-}
-
-static void addSideFaces(std::vector<float> &values, const float thetaA, const float thetaB) {
-  // Add the first triangle.
-  pushBackValues(values, std::cos(thetaA), -1.0f, std::sin(thetaA));
-  pushBackValues(values, std::cos(thetaA), 0.0f, std::sin(thetaA));
-  pushBackValues(values, std::cos(thetaB), -1.0f, std::sin(thetaB));
-  pushBackValues(values, std::cos(thetaB), 0.0f, std::sin(thetaB));
-  pushBackValues(values, std::cos(thetaB), 1.0f, std::sin(thetaB));
-  pushBackValues(values, std::cos(thetaB), 0.0f, std::sin(thetaB));
-  // Add the second triangle.
-  pushBackValues(values, std::cos(thetaB), 1.0f, std::sin(thetaB));
-  pushBackValues(values, std::cos(thetaB), 0.0f, std::sin(thetaB));
-  pushBackValues(values, std::cos(thetaA), 1.0f, std::sin(thetaA));
-  pushBackValues(values, std::cos(thetaA), 0.0f, std::sin(thetaA));
-  pushBackValues(values, std::cos(thetaA), -1.0f, std::sin(thetaA));
-  pushBackValues(values, std::cos(thetaA), 0.0f, std::sin(thetaA));
-}
-
-static void addSideVertices(std::vector<float> &values) {
-  // Adds two triangles per iteration.
-  for (uint32_t i = 0; i < CylinderFaces; i++) {
-    const auto thetaA = 2.0f * 4.0f * std::atan(1.0f) / CylinderFaces * i;
-    const auto thetaB = 2.0f * 4.0f * std::atan(1.0f) / CylinderFaces * (i + 1);
-    addSideFaces(values, thetaA, thetaB);
+/**
+ * A shader embedded into the binary when building.
+ */
+class ShaderSource {
+public:
+  const char *filename;
+  const char *source;
+  GLint type;
+};
+
+/**
+ * Returns the program of the shaders from the cache, or compiles and links it and caches it.
+ */
+static GLuint buildProgram(const ProgramBinaryCache &programBinaryCache, const std::vector<ShaderSource> &sources) {
+  std::string key;
+  for (const auto &source : sources) {
+    key += std::to_string(source.type) + '\n' + source.source + '\0';
+  }
+  const auto cachedProgram = programBinaryCache.load(key);
+  if (cachedProgram != 0) {
+    assertNoError();
+    return cachedProgram;
+  }
+  std::vector<GLuint> shaders;
+  for (const auto &source : sources) {
+    shaders.push_back(loadShader(source.filename, source.source, source.type));
   }
+  const auto program = linkProgram(shaders);
+  // The program keeps what it needs, and the shaders are deleted once they are detached from it.
+  for (const auto shader : shaders) {
+    glDetachShader(program, shader);
+    glDeleteShader(shader);
+  }
+  programBinaryCache.store(key, program);
+  return program;
 }
 
-void OpenGlWindow::setUpVertexArrays() {
-  glGenVertexArrays(1, &openGlCylinderVertexBufferArray);
-  glBindVertexArray(openGlCylinderVertexBufferArray);
-  GLuint vertexBuffer;
-  glGenBuffers(1, &vertexBuffer);
-  glBindBuffer(GL_ARRAY_BUFFER, vertexBuffer);
-  std::vector<float> cylinderValues;
-  addDiskVertices(cylinderValues, -1.0f, -1.0f);
-  addSideVertices(cylinderValues);
-  addDiskVertices(cylinderValues, +1.0f, +1.0f);
-  glBufferData(GL_ARRAY_BUFFER, sizeof(float) * cylinderValues.size(), cylinderValues.data(), GL_STATIC_DRAW);
-  const auto vertexPositionLocation = glGetAttribLocation(openGlCylinderProgram, "vertexPosition");
+void OpenGlWindow::initializePrograms() {
+  TraceScope traceScope("OpenGlWindow::initializePrograms", "render");
+  const ProgramBinaryCache programBinaryCache(ProgramBinaryCache::getDefaultDirectory());
+  const ShaderSource vertexShader{"OpenGlVertexShader.glsl", OpenGlVertexShaderSource, GL_VERTEX_SHADER};
+  const ShaderSource meshVertexShader{"OpenGlMeshVertexShader.glsl", OpenGlMeshVertexShaderSource, GL_VERTEX_SHADER};
+  const ShaderSource fragmentShader{"OpenGlFragmentShader.glsl", OpenGlFragmentShaderSource, GL_FRAGMENT_SHADER};
+  const ShaderSource computeShader{"OpenGlLevelOfDetailComputeShader.glsl", OpenGlLevelOfDetailComputeShaderSource, GL_COMPUTE_SHADER};
+  const ShaderSource depthPyramidShader{"OpenGlDepthPyramidComputeShader.glsl", OpenGlDepthPyramidComputeShaderSource, GL_COMPUTE_SHADER};
+  openGlCylinderProgram = buildProgram(programBinaryCache, {vertexShader, fragmentShader});
+  openGlCylinderProgramUniformLocations = ShadingUniformLocations(openGlCylinderProgram);
+  openGlMeshProgram = buildProgram(programBinaryCache, {meshVertexShader, fragmentShader});
+  openGlMeshProgramUniformLocations = ShadingUniformLocations(openGlMeshProgram);
+  openGlLevelOfDetailProgram = buildProgram(programBinaryCache, {computeShader});
+  const auto instanceCountUniform = glGetUniformLocation(openGlLevelOfDetailProgram, "instanceCount");
+  openGlLevelOfDetailProgramInstanceCountUniformLocation = instanceCountUniform;
+  const auto levelOfDetailCameraPositionUniform = glGetUniformLocation(openGlLevelOfDetailProgram, "cameraPositionInWorld");
+  openGlLevelOfDetailProgramCameraPositionInWorldUniformLocation = levelOfDetailCameraPositionUniform;
+  const auto pixelsPerMeterUniform = glGetUniformLocation(openGlLevelOfDetailProgram, "pixelsPerMeter");
+  openGlLevelOfDetailProgramPixelsPerMeterUniformLocation = pixelsPerMeterUniform;
+  const auto useVisibleInstancesUniform = glGetUniformLocation(openGlLevelOfDetailProgram, "useVisibleInstances");
+  openGlLevelOfDetailProgramUseVisibleInstancesUniformLocation = useVisibleInstancesUniform;
+  const auto viewProjectionMatrixUniform = glGetUniformLocation(openGlLevelOfDetailProgram, "viewProjectionMatrix");
+  openGlLevelOfDetailProgramViewProjectionMatrixUniformLocation = viewProjectionMatrixUniform;
+  const auto occlusionCullingUniform = glGetUniformLocation(openGlLevelOfDetailProgram, "occlusionCulling");
+  openGlLevelOfDetailProgramOcclusionCullingUniformLocation = occlusionCullingUniform;
+  openGlDepthPyramidProgram = buildProgram(programBinaryCache, {depthPyramidShader});
+}
+
+static void pushBackVertex(std::vector<Vertex> &vertices, float x, float y, float z, float nx, float ny, float nz) {
+  vertices.push_back(Vertex{Point(x, y, z), Vector(nx, ny, nz)});
+}
+
+static void pushBackTriangle(std::vector<U32> &indices, U32 a, U32 b, U32 c) {
+  indices.push_back(a);
+  indices.push_back(b);
+  indices.push_back(c);
+}
+
+/**
+ * Adds a cylinder with the specified number of faces (an even number, so that the silhouette is exact when facing the camera).
+ */
+static DrawElementsIndirectCommand addCylinder(std::vector<Vertex> &vertices, std::vector<U32> &indices, U32 faces, bool withCaps) {
+  DrawElementsIndirectCommand command{};
+  command.firstIndex = indices.size();
+  command.baseVertex = vertices.size();
+  // Indices are relative to the base vertex.
+  CylinderMeshBuilder cylinderMeshBuilder;
+  cylinderMeshBuilder.faces = faces;
+  cylinderMeshBuilder.withCaps = withCaps;
+  const auto cylinder = cylinderMeshBuilder.build();
+  vertices.insert(std::end(vertices), std::begin(cylinder.vertices), std::end(cylinder.vertices));
+  indices.insert(std::end(indices), std::begin(cylinder.indices), std::end(cylinder.indices));
+  command.count = cylinder.indices.size();
+  return command;
+}
+
+/**
+ * Adds a rectangle which covers the silhouette of the cylinder when it faces the camera.
+ *
+ * The normals bend towards the sides, so that the shading resembles that of a cylinder.
+ */
+static DrawElementsIndirectCommand addBillboard(std::vector<Vertex> &vertices, std::vector<U32> &indices) {
+  DrawElementsIndirectCommand command{};
+  command.firstIndex = indices.size();
+  command.baseVertex = vertices.size();
+  const auto n = 1.0f / std::sqrt(2.0f);
+  pushBackVertex(vertices, -1.0f, -1.0f, 0.0f, -n, 0.0f, n);
+  pushBackVertex(vertices, +1.0f, -1.0f, 0.0f, +n, 0.0f, n);
+  pushBackVertex(vertices, +1.0f, +1.0f, 0.0f, +n, 0.0f, n);
+  pushBackVertex(vertices, -1.0f, +1.0f, 0.0f, -n, 0.0f, n);
+  pushBackTriangle(indices, 0, 1, 2);
+  pushBackTriangle(indices, 2, 3, 0);
+  command.count = 6;
+  return command;
+}
+
+/**
+ * Sets up the position and normal attributes of the bound vertex array, reading Vertex objects from the bound buffer.
+ */
+static void setUpVertexAttributes(GLuint program) {
+  const auto vertexPositionLocation = glGetAttribLocation(program, "vertexPosition");
   if (vertexPositionLocation < 0) {
     throw std::runtime_error("Could not find vertexPosition in the OpenGL program.");
   }
-  glVertexAttribPointer(vertexPositionLocation, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(float), (void *)(0 * sizeof(float)));
+  glVertexAttribPointer(vertexPositionLocation, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void *)offsetof(Vertex, position));
   glEnableVertexAttribArray(vertexPositionLocation);
-  const auto vertexNormalLocation = glGetAttribLocation(openGlCylinderProgram, "vertexNormal");
+  const auto vertexNormalLocation = glGetAttribLocation(program, "vertexNormal");
   if (vertexNormalLocation < 0) {
     throw std::runtime_error("Could not find vertexNormal in the OpenGL program.");
   }
-  glVertexAttribPointer(vertexNormalLocation, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(float), (void *)(3 * sizeof(float)));
+  glVertexAttribPointer(vertexNormalLocation, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void *)offsetof(Vertex, normal));
   glEnableVertexAttribArray(vertexNormalLocation);
+}
+
+void OpenGlWindow::setUpVertexArrays() {
+  glGenVertexArrays(1, &openGlCylinderVertexBufferArray);
+  glBindVertexArray(openGlCylinderVertexBufferArray);
+  GLuint vertexBuffer;
+  glGenBuffers(1, &vertexBuffer);
+  glBindBuffer(GL_ARRAY_BUFFER, vertexBuffer);
+  GLuint indexBuffer;
+  glGenBuffers(1, &indexBuffer);
+  glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, indexBuffer);
+  std::vector<Vertex> cylinderVertices;
+  std::vector<U32> cylinderIndices;
+  // The levels of detail must match the thresholds of the level of detail selection program.
+  levelOfDetailCommands.push_back(addCylinder(cylinderVertices, cylinderIndices, CylinderFaces, true));
+  levelOfDetailCommands.push_back(addCylinder(cylinderVertices, cylinderIndices, CylinderFaces / 2, true));
+  levelOfDetailCommands.push_back(addCylinder(cylinderVertices, cylinderIndices, CylinderFaces / 4, false));
+  levelOfDetailCommands.push_back(addBillboard(cylinderVertices, cylinderIndices));
+  glBufferData(GL_ARRAY_BUFFER, sizeof(Vertex) * cylinderVertices.size(), cylinderVertices.data(), GL_STATIC_DRAW);
+  glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(U32) * cylinderIndices.size(), cylinderIndices.data(), GL_STATIC_DRAW);
+  setUpVertexAttributes(openGlCylinderProgram);
   glBindVertexArray(0);
   glDeleteBuffers(1, &vertexBuffer);
+  glDeleteBuffers(1, &indexBuffer);
+  // The tube mesh buffers are filled when a tree is drawn as tubes.
+  glGenVertexArrays(1, &openGlMeshVertexArray);
+  glBindVertexArray(openGlMeshVertexArray);
+  glGenBuffers(1, &openGlMeshVertexBuffer);
+  glBindBuffer(GL_ARRAY_BUFFER, openGlMeshVertexBuffer);
+  glGenBuffers(1, &openGlMeshIndexBuffer);
+  glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, openGlMeshIndexBuffer);
+  setUpVertexAttributes(openGlMeshProgram);
+  glBindVertexArray(0);
+  glGenBuffers(1, &openGlIndirectCommandBuffer);
+  glBindBuffer(GL_DRAW_INDIRECT_BUFFER, openGlIndirectCommandBuffer);
+  glBufferData(GL_DRAW_INDIRECT_BUFFER, sizeof(DrawElementsIndirectCommand) * levelOfDetailCommands.size(), nullptr, GL_DYNAMIC_DRAW);
+  glGenBuffers(1, &openGlVisibleInstanceBuffer);
+  glBindBuffer(GL_SHADER_STORAGE_BUFFER, openGlVisibleInstanceBuffer);
+  glBufferData(GL_SHADER_STORAGE_BUFFER, sizeof(U32), nullptr, GL_STREAM_DRAW);
+  reserveInstances(InitialInstanceCapacity);
 }
 
 /**
- * Returns the matrix required to align A with B.
+ * Grows the instance buffer so that it holds at least the specified number of instances, keeping its contents.
  *
- * Uses the formulation proposed in https://math.stackexchange.com/questions/180418/.
+ * The level of detail instance indices, which hold an index per instance for each level of detail, grow with it.
  */
-static glm::mat4 getAlignmentMatrix(Vector a, Vector b) {
-  a = a.normalize();
-  b = b.normalize();
-  const auto c = a.dot(b);
-  // If the vector is almost aligned or reversed, do nothing.
-  if (std::abs(c) > (1.0f - 1.0e-6f)) {
-    return glm::mat4(1.0f);
-  }
-  const auto v = a.cross(b);
-  auto skewSymmetric = glm::mat4(0.0f);
-  skewSymmetric[0][1] = +v.z;
-  skewSymmetric[0][2] = -v.y;
-  skewSymmetric[1][0] = -v.z;
-  skewSymmetric[1][2] = +v.x;
-  skewSymmetric[2][0] = +v.y;
-  skewSymmetric[2][1] = -v.x;
-  return glm::mat4(1.0f) + skewSymmetric + skewSymmetric * skewSymmetric / (1.0f + c);
-}
-
-glm::mat4 modelMatrixFromMetamer(const std::unique_ptr<Metamer> &metamer) {
-  // The cylinder is 2 meters high and has 1 meter radius. Its center is at the origin.
-  // Scale it on Y to get the right length.
-  const auto yScale = metamer->getLength() / 2.0f;
-  const auto scale = glm::scale(glm::mat4(1.0f), glm::vec3(metamer->width, yScale, metamer->width));
-  // Rotate it so that the orientation is correct.
-  const auto rotation = getAlignmentMatrix(Vector(0.0f, 1.0f, 0.0f), Vector(metamer->beginning, metamer->end));
-  // Translate it so that the centers match.
-  const auto metamerCenter = metamer->getCenter();
-  const auto center = glm::vec3(metamerCenter.x, metamerCenter.y, metamerCenter.z);
-  const auto translation = glm::translate(glm::mat4(1.0f), center);
-  return translation * rotation * scale;
-}
-
-void OpenGlWindow::drawMetamers(const std::unique_ptr<Metamer> &metamer) {
-  if (!metamer) {
+void OpenGlWindow::reserveInstances(U64 capacity) {
+  if (capacity <= instanceCapacity) {
     return;
   }
-  const auto modelMatrix = modelMatrixFromMetamer(metamer);
-  glUniformMatrix4fv(openGlCylinderProgramModelMatrixUniformLocation, 1, GL_FALSE, glm::value_ptr(modelMatrix));
-  const auto modelInverseTransposedMatrix = glm::transpose(glm::inverse(modelMatrix));
-  glUniformMatrix4fv(openGlCylinderProgramModelInverseTransposedMatrixUniformLocation, 1, GL_FALSE, glm::value_ptr(modelInverseTransposedMatrix));
-  glDrawArrays(GL_TRIANGLES, 0, 3 * (4 * CylinderFaces));
-  drawCalls++;
-  drawMetamers(metamer->axillary);
-  drawMetamers(metamer->terminal);
-}
-
-OpenGlWindow::OpenGlWindow() {
-  glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 4);
-  glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 6);
-  glfwWindowHint(GLFW_SAMPLES, MultiSamplingSamples);
-  glfwWindowHint(GLFW_RESIZABLE, GLFW_FALSE);
-  window = glfwCreateWindow(DefaultWindowSide, DefaultWindowSide, "OpenGL Window", nullptr, nullptr);
-  glfwSetKeyCallback(window, keyCallback);
-  glfwMakeContextCurrent(window);
-  gladLoadGLLoader((GLADloadproc)glfwGetProcAddress);
-  glfwSwapInterval(1);
+  const auto newCapacity = std::max(capacity, 2 * instanceCapacity);
+  const auto flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+  GLuint newBuffer;
+  glGenBuffers(1, &newBuffer);
+  glBindBuffer(GL_ARRAY_BUFFER, newBuffer);
+  glBufferStorage(GL_ARRAY_BUFFER, sizeof(MetamerInstance) * newCapacity, nullptr, flags);
+  if (instanceCapacity != 0) {
+    // The copy happens on the GPU, after the draws which still read from the old buffer.
+    glBindBuffer(GL_COPY_READ_BUFFER, openGlCylinderInstanceBuffer);
+    glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_ARRAY_BUFFER, 0, 0, sizeof(MetamerInstance) * uploadedInstances);
+    glUnmapBuffer(GL_COPY_READ_BUFFER);
+    glDeleteBuffers(1, &openGlCylinderInstanceBuffer);
+    glDeleteBuffers(1, &openGlLevelOfDetailInstanceBuffer);
+  }
+  openGlCylinderInstanceBuffer = newBuffer;
+  instanceCapacity = newCapacity;
+  const auto mapping = glMapBufferRange(GL_ARRAY_BUFFER, 0, sizeof(MetamerInstance) * newCapacity, flags);
+  mappedInstances = static_cast<MetamerInstance *>(mapping);
+  if (mappedInstances == nullptr) {
+    throw std::runtime_error("Could not map the instance buffer.");
+  }
+  // The level of detail instance indices are rewritten every frame, so their contents need not be kept.
+  glGenBuffers(1, &openGlLevelOfDetailInstanceBuffer);
+  glBindBuffer(GL_ARRAY_BUFFER, openGlLevelOfDetailInstanceBuffer);
+  glBufferData(GL_ARRAY_BUFFER, sizeof(U32) * levelOfDetailCommands.size() * newCapacity, nullptr, GL_DYNAMIC_DRAW);
+  // The vertex array captures the buffer bound when the attribute is set up.
+  glBindVertexArray(openGlCylinderVertexBufferArray);
+  const auto location = glGetAttribLocation(openGlCylinderProgram, "instanceIndex");
+  if (location < 0) {
+    throw std::runtime_error("Could not find instanceIndex in the OpenGL program.");
+  }
+  glVertexAttribIPointer(location, 1, GL_UNSIGNED_INT, sizeof(U32), nullptr);
+  glVertexAttribDivisor(location, 1);
+  glEnableVertexAttribArray(location);
+  glBindVertexArray(0);
+}
+
+void OpenGlWindow::waitForLastFrame() {
+  if (lastFrameFence) {
+    glClientWaitSync(lastFrameFence, GL_SYNC_FLUSH_COMMANDS_BIT, std::numeric_limits<GLuint64>::max());
+    glDeleteSync(lastFrameFence);
+    lastFrameFence = nullptr;
+  }
+}
+
+/**
+ * Brings the instance buffer and the bounding volume hierarchy up to date with the snapshot.
+ *
+ * Instances created since the last upload are appended. If the snapshot is one growth iteration after the last upload,
+ * only the widths which that iteration changed are written, otherwise all widths are. The cost is proportional to what
+ * changed, not to the size of the tree.
+ */
+void OpenGlWindow::uploadInstances(const TreeSnapshot &snapshot) {
+  if (snapshot.treeId != uploadedTreeId) {
+    // The instances of the new tree overwrite those of the previous one, which the last frame might still read.
+    waitForLastFrame();
+    uploadedTreeId = snapshot.treeId;
+    uploadedInstances = 0;
+    uploadedIteration = snapshot.iterations;
+    boundingVolumeHierarchy.clear();
+    visibleInstancesOutdated = true;
+    // The depth of the previous tree says nothing about what hides the instances of this one.
+    depthPyramidValid = false;
+  }
+  if (snapshot.iterations != uploadedIteration) {
+    // Existing instances might still be read by the last frame.
+    waitForLastFrame();
+    const auto updateWidth = [this, &snapshot](U64 index) {
+      mappedInstances[index].width = snapshot.instances[index].width;
+      boundingVolumeHierarchy.enlarge(index, snapshot.instances[index].getBoundingBox());
+    };
+    if (snapshot.iterations == uploadedIteration + 1) {
+      for (const auto index : snapshot.widthChanges) {
+        updateWidth(index);
+      }
+    } else {
+      for (U64 i = 0; i < uploadedInstances; i++) {
+        updateWidth(i);
+      }
+    }
+    uploadedIteration = snapshot.iterations;
+    visibleInstancesOutdated = true;
+  }
+  reserveInstances(snapshot.instances.size());
+  for (auto i = uploadedInstances; i < snapshot.instances.size(); i++) {
+    mappedInstances[i] = snapshot.instances[i];
+    boundingVolumeHierarchy.insert(snapshot.instances[i].getBoundingBox());
+    visibleInstancesOutdated = true;
+  }
+  uploadedInstances = snapshot.instances.size();
+}
+
+/**
+ * Returns the product of the projection and view matrices, in column-major order.
+ */
+std::array<F32, 16> OpenGlWindow::getViewProjectionMatrix() const {
+  const auto glmCameraPosition = glm::vec3(cameraPosition.x, cameraPosition.y, cameraPosition.z);
+  const auto glmLookAtPosition = glm::vec3(lookAtPosition.x, lookAtPosition.y, lookAtPosition.z);
+  const auto viewMatrix = glm::lookAt(glmCameraPosition, glmLookAtPosition, glm::vec3(0.0f, 1.0f, 0.0f));
+  const auto ratio = static_cast<float>(viewportWidth) / viewportHeight;
+  const auto projectionMatrix = glm::perspective(fov, ratio, NearPlaneDistance, FarPlaneDistance);
+  const auto viewProjectionMatrix = projectionMatrix * viewMatrix;
+  std::array<F32, 16> matrix{};
+  std::copy(glm::value_ptr(viewProjectionMatrix), glm::value_ptr(viewProjectionMatrix) + matrix.size(), matrix.begin());
+  return matrix;
+}
+
+/**
+ * Lists the instances in leaves of the bounding volume hierarchy which intersect the frustum, so that the cost of the
+ * level of detail selection follows what is in view rather than the size of the tree.
+ */
+void OpenGlWindow::findVisibleInstances(const std::array<F32, 16> &viewProjection) {
+  if (!visibleInstancesOutdated && viewProjection == visibleInstancesViewProjection) {
+    return;
+  }
+  TraceScope traceScope("OpenGlWindow::findVisibleInstances", "render");
+  const Frustum frustum(viewProjection);
+  // Listing every instance would only cost time, so the selection reads the instances directly if all are in view.
+  allInstancesVisible = boundingVolumeHierarchy.classify(frustum) == Containment::Inside;
+  visibleInstances.clear();
+  if (!allInstancesVisible) {
+    boundingVolumeHierarchy.collectInFrustum(frustum, visibleInstances);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, openGlVisibleInstanceBuffer);
+    // Reallocating orphans the list which the last frame might still read.
+    const auto size = sizeof(U32) * std::max<std::size_t>(1, visibleInstances.size());
+    glBufferData(GL_SHADER_STORAGE_BUFFER, size, visibleInstances.data(), GL_STREAM_DRAW);
+  }
+  visibleInstancesOutdated = false;
+  visibleInstancesViewProjection = viewProjection;
+}
+
+/**
+ * Drops the candidate instances which cannot be seen and sorts the others into the levels of detail according to their
+ * projected size, all on the GPU.
+ *
+ * Afterwards, the indirect command buffer holds one command per level of detail, with the number of instances which use it.
+ */
+void OpenGlWindow::selectLevelsOfDetail(const std::array<F32, 16> &viewProjection) {
+  auto commands = levelOfDetailCommands;
+  for (std::size_t i = 0; i < commands.size(); i++) {
+    commands[i].baseInstance = i * instanceCapacity;
+  }
+  glBindBuffer(GL_DRAW_INDIRECT_BUFFER, openGlIndirectCommandBuffer);
+  glBufferSubData(GL_DRAW_INDIRECT_BUFFER, 0, sizeof(DrawElementsIndirectCommand) * commands.size(), commands.data());
+  glUseProgram(openGlLevelOfDetailProgram);
+  glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, openGlCylinderInstanceBuffer);
+  glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, openGlLevelOfDetailInstanceBuffer);
+  glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 2, openGlIndirectCommandBuffer);
+  glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 3, openGlVisibleInstanceBuffer);
+  const auto candidates = allInstancesVisible ? uploadedInstances : visibleInstances.size();
+  glUniform1ui(openGlLevelOfDetailProgramInstanceCountUniformLocation, candidates);
+  glUniform1i(openGlLevelOfDetailProgramUseVisibleInstancesUniformLocation, !allInstancesVisible);
+  glUniformMatrix4fv(openGlLevelOfDetailProgramViewProjectionMatrixUniformLocation, 1, GL_FALSE, viewProjection.data());
+  // The depth of the last frame only tells what is hidden if it was seen from the same point of view.
+  const auto occlusionCulling = depthPyramidValid && depthPyramidViewProjection == viewProjection;
+  glUniform1i(openGlLevelOfDetailProgramOcclusionCullingUniformLocation, occlusionCulling);
+  glActiveTexture(GL_TEXTURE1);
+  glBindTexture(GL_TEXTURE_2D, depthPyramidTexture);
+  glUniform3f(openGlLevelOfDetailProgramCameraPositionInWorldUniformLocation, cameraPosition.x, cameraPosition.y, cameraPosition.z);
+  const auto pixelsPerMeter = viewportHeight / (2.0f * std::tan(fov / 2.0f));
+  glUniform1f(openGlLevelOfDetailProgramPixelsPerMeterUniformLocation, pixelsPerMeter);
+  glDispatchCompute((candidates + LevelOfDetailWorkGroupSize - 1) / LevelOfDetailWorkGroupSize, 1, 1);
+  glMemoryBarrier(GL_COMMAND_BARRIER_BIT | GL_VERTEX_ATTRIB_ARRAY_BARRIER_BIT);
+}
+
+/**
+ * Creates the framebuffer objects drawn to and the depth pyramid, with the size of the viewport.
+ */
+void OpenGlWindow::setUpFramebuffers() {
+  GLint maximumSamples;
+  glGetIntegerv(GL_MAX_SAMPLES, &maximumSamples);
+  GLint maximumDepthSamples;
+  glGetIntegerv(GL_MAX_DEPTH_TEXTURE_SAMPLES, &maximumDepthSamples);
+  const auto samples = std::min<GLint>({static_cast<GLint>(MultiSamplingSamples), maximumSamples, maximumDepthSamples});
+  renderbuffers.resize(2);
+  glGenRenderbuffers(renderbuffers.size(), renderbuffers.data());
+  glBindRenderbuffer(GL_RENDERBUFFER, renderbuffers[0]);
+  glRenderbufferStorageMultisample(GL_RENDERBUFFER, samples, GL_RGBA8, viewportWidth, viewportHeight);
+  glBindRenderbuffer(GL_RENDERBUFFER, renderbuffers[1]);
+  glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, viewportWidth, viewportHeight);
+  // The depth is a texture, so that the depth pyramid can be built from it.
+  glGenTextures(1, &depthTexture);
+  glBindTexture(GL_TEXTURE_2D_MULTISAMPLE, depthTexture);
+  glTexStorage2DMultisample(GL_TEXTURE_2D_MULTISAMPLE, samples, GL_DEPTH_COMPONENT24, viewportWidth, viewportHeight, GL_TRUE);
+  glGenFramebuffers(1, &multisampledFramebuffer);
+  glBindFramebuffer(GL_FRAMEBUFFER, multisampledFramebuffer);
+  glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, renderbuffers[0]);
+  glFramebufferTexture(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, depthTexture, 0);
+  if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+    throw std::runtime_error("The multisampled framebuffer is incomplete.");
+  }
+  glGenFramebuffers(1, &resolvedFramebuffer);
+  glBindFramebuffer(GL_FRAMEBUFFER, resolvedFramebuffer);
+  glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, renderbuffers[1]);
+  if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+    throw std::runtime_error("The resolved framebuffer is incomplete.");
+  }
+  glBindFramebuffer(GL_FRAMEBUFFER, multisampledFramebuffer);
+  // Every level halves the size of the one below, rounding down, until the last is a single texel.
+  depthPyramidLevels = 1 + static_cast<I32>(std::floor(std::log2(std::max(viewportWidth, viewportHeight))));
+  glGenTextures(1, &depthPyramidTexture);
+  glBindTexture(GL_TEXTURE_2D, depthPyramidTexture);
+  glTexStorage2D(GL_TEXTURE_2D, depthPyramidLevels, GL_R32F, viewportWidth, viewportHeight);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST_MIPMAP_NEAREST);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+}
+
+OpenGlWindow::OpenGlWindow(U32 width, U32 height, bool offscreen) : offscreen(offscreen), viewportWidth(width), viewportHeight(height) {
+  if (offscreen) {
+#ifdef OFFSCREEN_RENDERING
+    offscreenContext = std::make_unique<OffscreenContext>(OpenGlMajorVersion, OpenGlMinorVersion);
+    gladLoadGLLoader(OffscreenContext::getProcAddress);
+#else
+    throw std::runtime_error("Off-screen rendering requires EGL, which was not found when building.");
+#endif
+  } else {
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, OpenGlMajorVersion);
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, OpenGlMinorVersion);
+    // Frames are drawn to a multisampled framebuffer object and resolved when presented, so the window needs no samples.
+    glfwWindowHint(GLFW_RESIZABLE, GLFW_FALSE);
+    window = glfwCreateWindow(width, height, "OpenGL Window", nullptr, nullptr);
+    if (window == nullptr) {
+      throw std::runtime_error("Failed to create the OpenGL window.");
+    }
+    glfwSetKeyCallback(window, keyCallback);
+    glfwMakeContextCurrent(window);
+    gladLoadGLLoader((GLADloadproc)glfwGetProcAddress);
+    glfwSwapInterval(1);
+    glfwGetFramebufferSize(window, &viewportWidth, &viewportHeight);
+  }
+  setUpFramebuffers();
   glEnable(GL_DEPTH_TEST);
   glEnable(GL_MULTISAMPLE);
-  if (window == nullptr) {
-    throw std::runtime_error("Failed to create the OpenGL window.");
-  }
   initializePrograms();
   setUpVertexArrays();
 }
 
 OpenGlWindow::~OpenGlWindow() {
-  glfwDestroyWindow(window);
+  waitForLastFrame();
+  for (const auto &request : requestedPixels) {
+    glDeleteSync(request.fence);
+  }
+  glDeleteBuffers(pixelPackBuffers.size(), pixelPackBuffers.data());
+  glDeleteFramebuffers(1, &multisampledFramebuffer);
+  glDeleteFramebuffers(1, &resolvedFramebuffer);
+  glDeleteRenderbuffers(renderbuffers.size(), renderbuffers.data());
+  glDeleteTextures(1, &depthTexture);
+  glDeleteTextures(1, &depthPyramidTexture);
+  if (!offscreen) {
+    glfwDestroyWindow(window);
+  }
 }
 
 void OpenGlWindow::setCameraForBoundingBox(BoundingBox boundingBox) {
-  cameraPosition.x = boundingBox.xRange.getAverage();
-  cameraPosition.y = boundingBox.yRange.getAverage();
-  cameraPosition.z = boundingBox.zRange.minimum;
-  // d = (s/2) / tan(a/2)
-  const auto s = std::max(boundingBox.xRange.getLength(), boundingBox.yRange.getLength());
-  // A magic factor to fill the screen more
-  cameraPosition.z -= 0.5f * (s / 2.0f) / std::tan(fov / 2.0f);
-  lookAtPosition.x = boundingBox.xRange.getAverage();
-  lookAtPosition.y = boundingBox.yRange.getAverage();
-  lookAtPosition.z = boundingBox.zRange.getAverage();
-}
-
-void OpenGlWindow::drawTree(const Tree &tree) {
+  Camera camera;
+  camera.fov = fov;
+  camera.frameBoundingBox(boundingBox);
+  cameraPosition = camera.position;
+  lookAtPosition = camera.lookAtPosition;
+}
+
+/**
+ * Makes the specified program current and sets the camera, lighting, and color uniforms shared by all programs, at the
+ * locations cached for it.
+ */
+void OpenGlWindow::useProgram(GLuint program, const ShadingUniformLocations &uniformLocations) {
   const auto glmCameraPosition = glm::vec3(cameraPosition.x, cameraPosition.y, cameraPosition.z);
   const auto glmLookAtPosition = glm::vec3(lookAtPosition.x, lookAtPosition.y, lookAtPosition.z);
   const auto viewMatrix = glm::lookAt(glmCameraPosition, glmLookAtPosition, glm::vec3(0.0f, 1.0f, 0.0f));
-  const auto ratio = 1.0f;
-  const auto zNear = 0.01f;
-  const auto zFar = 100.0f;
-  const auto projectionMatrix = glm::perspective(fov, ratio, zNear, zFar);
-  glUseProgram(openGlCylinderProgram);
-  glBindVertexArray(openGlCylinderVertexBufferArray);
+  const auto ratio = static_cast<float>(viewportWidth) / viewportHeight;
+  const auto projectionMatrix = glm::perspective(fov, ratio, NearPlaneDistance, FarPlaneDistance);
+  glUseProgram(program);
   const auto viewPointer = glm::value_ptr(viewMatrix);
-  glUniformMatrix4fv(openGlCylinderProgramViewMatrixUniformLocation, 1, GL_FALSE, viewPointer);
+  glUniformMatrix4fv(uniformLocations.viewMatrix, 1, GL_FALSE, viewPointer);
   const auto projectionPointer = glm::value_ptr(projectionMatrix);
-  glUniformMatrix4fv(openGlCylinderProgramProjectionMatrixUniformLocation, 1, GL_FALSE, projectionPointer);
+  glUniformMatrix4fv(uniformLocations.projectionMatrix, 1, GL_FALSE, projectionPointer);
   const auto cameraPositionInWorldPointer = glm::value_ptr(glmCameraPosition);
-  glUniform3fv(openGlCylinderProgramCameraPositionInWorldUniformLocation, 1, cameraPositionInWorldPointer);
+  glUniform3fv(uniformLocations.cameraPositionInWorld, 1, cameraPositionInWorldPointer);
   const auto glmLightPosition = glmCameraPosition + glm::vec3(0.0f, 1.0f, 0.0f);
   const auto lightPositionInWorldPointer = glm::value_ptr(glmLightPosition);
-  glUniform3fv(openGlCylinderProgramLightPositionInWorldUniformLocation, 1, lightPositionInWorldPointer);
-  glUniform1f(openGlCylinderProgramAmbientLightIntensityUniformLocation, 1.0f);
+  glUniform3fv(uniformLocations.lightPositionInWorld, 1, lightPositionInWorldPointer);
+  glUniform1f(uniformLocations.ambientLightIntensity, 1.0f);
   // Olive Wood
   const Color color{0.4588f, 0.3843f, 0.2667f};
-  glUniform4fv(openGlCylinderProgramVertexColorUniformLocation, 1, color.channels.data());
-  drawMetamers(tree.root);
+  glUniform4fv(uniformLocations.vertexColor, 1, color.channels.data());
+}
+
+/**
+ * Reduces the depth of the frame into the depth pyramid, which the next frame uses for occlusion culling.
+ */
+void OpenGlWindow::updateDepthPyramid(const std::array<F32, 16> &viewProjection) {
+  TraceScope traceScope("OpenGlWindow::updateDepthPyramid", "render");
+  glUseProgram(openGlDepthPyramidProgram);
+  glActiveTexture(GL_TEXTURE0);
+  glBindTexture(GL_TEXTURE_2D_MULTISAMPLE, depthTexture);
+  const auto levelLocation = glGetUniformLocation(openGlDepthPyramidProgram, "level");
+  for (I32 level = 0; level < depthPyramidLevels; level++) {
+    glUniform1i(levelLocation, level);
+    if (level > 0) {
+      glBindImageTexture(0, depthPyramidTexture, level - 1, GL_FALSE, 0, GL_READ_ONLY, GL_R32F);
+    }
+    glBindImageTexture(1, depthPyramidTexture, level, GL_FALSE, 0, GL_WRITE_ONLY, GL_R32F);
+    const auto width = std::max(1, viewportWidth >> level);
+    const auto height = std::max(1, viewportHeight >> level);
+    glDispatchCompute((width + DepthPyramidWorkGroupSide - 1) / DepthPyramidWorkGroupSide, (height + DepthPyramidWorkGroupSide - 1) / DepthPyramidWorkGroupSide, 1);
+    glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT);
+  }
+  glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT);
+  depthPyramidValid = true;
+  depthPyramidViewProjection = viewProjection;
+}
+
+void OpenGlWindow::drawTree(const TreeSnapshot &snapshot) {
+  TraceScope traceScope("OpenGlWindow::drawTree", "render");
+  uploadInstances(snapshot);
+  const auto viewProjection = getViewProjectionMatrix();
+  findVisibleInstances(viewProjection);
+  selectLevelsOfDetail(viewProjection);
+  useProgram(openGlCylinderProgram, openGlCylinderProgramUniformLocations);
+  glBindVertexArray(openGlCylinderVertexBufferArray);
+  // The instance buffer is still bound to the shader storage binding which the vertex shader reads.
+  glMultiDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT, nullptr, levelOfDetailCommands.size(), 0);
+  drawCalls++;
+  // The pyramid only pays off if the next frame is seen from the same point of view, which is likely if this one was.
+  if (viewProjection == lastViewProjection) {
+    updateDepthPyramid(viewProjection);
+  }
+  lastViewProjection = viewProjection;
+  waitForLastFrame();
+  lastFrameFence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+}
+
+/**
+ * Draws the tree as one tube per axis, uploading the mesh only after the tree changes.
+ */
+void OpenGlWindow::drawTreeAsTubes(const TreeSnapshot &snapshot) {
+  TraceScope traceScope("OpenGlWindow::drawTreeAsTubes", "render");
+  if (!snapshot.tubeMesh) {
+    throw std::logic_error("The tree snapshot has no tube mesh.");
+  }
+  if (snapshot.treeId != meshTreeId || snapshot.iterations != meshIteration) {
+    const auto &mesh = snapshot.tubeMesh.value();
+    glBindVertexArray(openGlMeshVertexArray);
+    glBindBuffer(GL_ARRAY_BUFFER, openGlMeshVertexBuffer);
+    glBufferData(GL_ARRAY_BUFFER, sizeof(Vertex) * mesh.vertices.size(), mesh.vertices.data(), GL_DYNAMIC_DRAW);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(U32) * mesh.indices.size(), mesh.indices.data(), GL_DYNAMIC_DRAW);
+    meshIndexCount = mesh.indices.size();
+    meshTreeId = snapshot.treeId;
+    meshIteration = snapshot.iterations;
+  }
+  useProgram(openGlMeshProgram, openGlMeshProgramUniformLocations);
+  glBindVertexArray(openGlMeshVertexArray);
+  glDrawElements(GL_TRIANGLES, meshIndexCount, GL_UNSIGNED_INT, nullptr);
+  drawCalls++;
 }
 
 void OpenGlWindow::setShouldClose() {
-  glfwSetWindowShouldClose(window, true);
+  if (offscreen) {
+    closeRequested = true;
+  } else {
+    glfwSetWindowShouldClose(window, true);
+  }
 }
 
 bool OpenGlWindow::shouldClose() {
+  if (offscreen) {
+    return closeRequested;
+  }
   return glfwWindowShouldClose(window);
 }
 
@@ -334,10 +679,8 @@ void OpenGlWindow::updateCameraPosition() {
 }
 
 void OpenGlWindow::startDrawing() {
-  int width;
-  int height;
-  glfwGetFramebufferSize(window, &width, &height);
-  glViewport(0, 0, width, height);
+  glBindFramebuffer(GL_FRAMEBUFFER, multisampledFramebuffer);
+  glViewport(0, 0, viewportWidth, viewportHeight);
   glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
   updateCameraPosition();
   drawCalls = 0;
@@ -345,9 +688,105 @@ void OpenGlWindow::startDrawing() {
 
 void OpenGlWindow::swapBuffers() {
   std::cout << "Draw calls: " << drawCalls << '\n';
-  glfwSwapBuffers(window);
+  TraceScope traceScope("OpenGlWindow::swapBuffers", "render");
+  // Off-screen frames are not presented, so they are not paced by the display either.
+  if (!offscreen) {
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, multisampledFramebuffer);
+    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
+    glBlitFramebuffer(0, 0, viewportWidth, viewportHeight, 0, 0, viewportWidth, viewportHeight, GL_COLOR_BUFFER_BIT, GL_NEAREST);
+    glfwSwapBuffers(window);
+  }
 }
 
 void OpenGlWindow::pollEvents() {
-  glfwPollEvents();
+  TraceScope traceScope("OpenGlWindow::pollEvents", "render");
+  if (!offscreen) {
+    glfwPollEvents();
+  }
+}
+
+int OpenGlWindow::getViewportWidth() const {
+  return viewportWidth;
+}
+
+int OpenGlWindow::getViewportHeight() const {
+  return viewportHeight;
+}
+
+/**
+ * Reads the pixels drawn since the last call to startDrawing into the specified destination.
+ *
+ * The destination is client memory, or an offset into the bound pixel pack buffer if there is one.
+ */
+void OpenGlWindow::readPixelsInto(void *destination) {
+  // Multisampled framebuffers cannot be read from, so the samples are resolved first.
+  glBindFramebuffer(GL_READ_FRAMEBUFFER, multisampledFramebuffer);
+  glBindFramebuffer(GL_DRAW_FRAMEBUFFER, resolvedFramebuffer);
+  glBlitFramebuffer(0, 0, viewportWidth, viewportHeight, 0, 0, viewportWidth, viewportHeight, GL_COLOR_BUFFER_BIT, GL_NEAREST);
+  glBindFramebuffer(GL_READ_FRAMEBUFFER, resolvedFramebuffer);
+  glReadBuffer(GL_COLOR_ATTACHMENT0);
+  // Rows are tightly packed, whatever the width.
+  glPixelStorei(GL_PACK_ALIGNMENT, 1);
+  // OpenCV expects BGR, which spares a conversion later.
+  glReadPixels(0, 0, viewportWidth, viewportHeight, GL_BGR, GL_UNSIGNED_BYTE, destination);
+  glBindFramebuffer(GL_FRAMEBUFFER, multisampledFramebuffer);
+}
+
+U64 OpenGlWindow::getPixelsSize() const {
+  return static_cast<U64>(viewportWidth) * viewportHeight * 3;
+}
+
+std::vector<uint8_t> OpenGlWindow::readPixels() {
+  std::vector<uint8_t> pixels(getPixelsSize());
+  readPixelsInto(pixels.data());
+  return pixels;
+}
+
+void OpenGlWindow::requestPixels() {
+  if (requestedPixels.size() == PixelPackBufferCount) {
+    throw std::logic_error("All pixel pack buffers are in use.");
+  }
+  if (pixelPackBuffers.empty()) {
+    pixelPackBuffers.resize(PixelPackBufferCount);
+    glGenBuffers(pixelPackBuffers.size(), pixelPackBuffers.data());
+  }
+  const auto buffer = pixelPackBuffers[nextPixelPackBuffer];
+  nextPixelPackBuffer = (nextPixelPackBuffer + 1) % PixelPackBufferCount;
+  glBindBuffer(GL_PIXEL_PACK_BUFFER, buffer);
+  // Reallocating also orphans the previous contents, which were already taken.
+  glBufferData(GL_PIXEL_PACK_BUFFER, getPixelsSize(), nullptr, GL_STREAM_READ);
+  readPixelsInto(nullptr);
+  glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+  requestedPixels.push_back(PixelPackRequest{buffer, glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0), getPixelsSize()});
+}
+
+U64 OpenGlWindow::countRequestedPixels() const {
+  return requestedPixels.size();
+}
+
+bool OpenGlWindow::arePixelsReady() {
+  if (requestedPixels.empty()) {
+    return false;
+  }
+  return glClientWaitSync(requestedPixels.front().fence, GL_SYNC_FLUSH_COMMANDS_BIT, 0) != GL_TIMEOUT_EXPIRED;
+}
+
+std::vector<uint8_t> OpenGlWindow::takePixels() {
+  if (requestedPixels.empty()) {
+    throw std::logic_error("No pixels were requested.");
+  }
+  TraceScope traceScope("OpenGlWindow::takePixels", "io");
+  const auto request = requestedPixels.front();
+  requestedPixels.pop_front();
+  glClientWaitSync(request.fence, GL_SYNC_FLUSH_COMMANDS_BIT, std::numeric_limits<GLuint64>::max());
+  glDeleteSync(request.fence);
+  glBindBuffer(GL_PIXEL_PACK_BUFFER, request.buffer);
+  const auto mapping = static_cast<const uint8_t *>(glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, request.size, GL_MAP_READ_BIT));
+  if (mapping == nullptr) {
+    throw std::runtime_error("Could not map a pixel pack buffer.");
+  }
+  std::vector<uint8_t> pixels(mapping, mapping + request.size);
+  glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+  glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+  return pixels;
 }
@@ -4,32 +4,111 @@
 
 #include <GLFW/glfw3.h>
 
+#include <array>
 #include <chrono>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <vector>
 
 #include "BoundingBox.hpp"
+#include "BoundingVolumeHierarchy.hpp"
 #include "Color.hpp"
-#include "Tree.hpp"
+#include "DrawElementsIndirectCommand.hpp"
+#include "MetamerInstance.hpp"
+#include "PixelPackRequest.hpp"
+#include "ShadingUniformLocations.hpp"
+#ifdef OFFSCREEN_RENDERING
+#include "OffscreenContext.hpp"
+#endif
+#include "TreeSnapshot.hpp"
 #include "Types.hpp"
 #include "UserAction.hpp"
 
 class OpenGlWindow {
   GLFWwindow *window = nullptr;
 
+  // When off-screen, there is no window and frames are never presented.
+  const bool offscreen;
+#ifdef OFFSCREEN_RENDERING
+  std::unique_ptr<OffscreenContext> offscreenContext;
+#endif
+  // Drawing goes to a multisampled framebuffer object, resolved for reading and presenting, so that its depth can be read.
+  GLuint multisampledFramebuffer = 0;
+  GLuint resolvedFramebuffer = 0;
+  std::vector<GLuint> renderbuffers;
+  GLuint depthTexture = 0;
+
+  // The farthest depth of the last frame over ever larger squares of pixels, for occlusion culling.
+  GLuint openGlDepthPyramidProgram = -1;
+  GLuint depthPyramidTexture = 0;
+  I32 depthPyramidLevels = 0;
+  bool depthPyramidValid = false;
+  std::array<F32, 16> depthPyramidViewProjection{};
+  std::array<F32, 16> lastViewProjection{};
+  bool closeRequested = false;
+
+  // A ring of pixel pack buffers, so that reading pixels back does not stall the pipeline.
+  std::vector<GLuint> pixelPackBuffers;
+  U64 nextPixelPackBuffer = 0;
+  std::deque<PixelPackRequest> requestedPixels;
+
   GLuint openGlCylinderProgram = -1;
+  ShadingUniformLocations openGlCylinderProgramUniformLocations;
   GLuint openGlCylinderVertexBufferArray = -1;
-  GLuint openGlCylinderProgramVertexColorUniformLocation = -1;
-
-  GLuint openGlCylinderProgramModelMatrixUniformLocation = -1;
-  GLuint openGlCylinderProgramModelInverseTransposedMatrixUniformLocation = -1;
-  GLuint openGlCylinderProgramViewMatrixUniformLocation = -1;
-  GLuint openGlCylinderProgramProjectionMatrixUniformLocation = -1;
-
-  GLuint openGlCylinderProgramCameraPositionInWorldUniformLocation = -1;
-  GLuint openGlCylinderProgramLightPositionInWorldUniformLocation = -1;
-  GLuint openGlCylinderProgramAmbientLightIntensityUniformLocation = -1;
+  // Persistently mapped, holds one instance per metamer in creation order.
+  GLuint openGlCylinderInstanceBuffer = -1;
+  MetamerInstance *mappedInstances = nullptr;
+  U64 instanceCapacity = 0;
+  U64 uploadedInstances = 0;
+
+  // Identifies the tree and the growth iteration which the instance buffer reflects.
+  U64 uploadedTreeId = 0;
+  U64 uploadedIteration = 0;
+
+  // Signaled when the GPU is done with the last frame, so that instances it reads can be overwritten.
+  GLsync lastFrameFence = nullptr;
+
+  // Selects a level of detail for every instance and fills the indirect draw commands.
+  GLuint openGlLevelOfDetailProgram = -1;
+  // Holds, for each level of detail, the indices of the instances drawn with it.
+  GLuint openGlLevelOfDetailInstanceBuffer = -1;
+  GLuint openGlIndirectCommandBuffer = -1;
+  // The meshes of the levels of detail, from the finest to the coarsest, with no instances.
+  std::vector<DrawElementsIndirectCommand> levelOfDetailCommands;
+
+  GLuint openGlLevelOfDetailProgramInstanceCountUniformLocation = -1;
+  GLuint openGlLevelOfDetailProgramCameraPositionInWorldUniformLocation = -1;
+  GLuint openGlLevelOfDetailProgramPixelsPerMeterUniformLocation = -1;
+  GLuint openGlLevelOfDetailProgramUseVisibleInstancesUniformLocation = -1;
+  GLuint openGlLevelOfDetailProgramViewProjectionMatrixUniformLocation = -1;
+  GLuint openGlLevelOfDetailProgramOcclusionCullingUniformLocation = -1;
+
+  // Bounds the uploaded instances, so that only those which may be in view are considered for drawing.
+  BoundingVolumeHierarchy boundingVolumeHierarchy;
+  // The instances which may be in view, unless all of them may be.
+  std::vector<U32> visibleInstances;
+  bool allInstancesVisible = true;
+  GLuint openGlVisibleInstanceBuffer = -1;
+  // The visible instances are only searched for again after the instances or the camera change.
+  bool visibleInstancesOutdated = true;
+  std::array<F32, 16> visibleInstancesViewProjection{};
+
+  // Draws a tree as a single mesh of tubes, rebuilt when the tree changes.
+  GLuint openGlMeshProgram = -1;
+  ShadingUniformLocations openGlMeshProgramUniformLocations;
+  GLuint openGlMeshVertexArray = -1;
+  GLuint openGlMeshVertexBuffer = -1;
+  GLuint openGlMeshIndexBuffer = -1;
+  U64 meshIndexCount = 0;
+  U64 meshTreeId = 0;
+  U64 meshIteration = 0;
 
   U64 drawCalls = 0;
 
+  int viewportWidth;
+  int viewportHeight;
+
   std::chrono::steady_clock::time_point lastUpdate = std::chrono::steady_clock::now();
 
   float fov = 2.0f * std::atan(1.0f);
@@ -37,24 +116,58 @@ class OpenGlWindow {
   Point cameraPosition{0.0f, 0.5f, 1.0f};
   Point lookAtPosition{0.0f, 0.0f, 1.0f};
 
+  void setUpFramebuffers();
+
   void initializePrograms();
 
   void setUpVertexArrays();
 
-  void drawMetamers(const std::unique_ptr<Metamer> &metamer);
+  void reserveInstances(U64 capacity);
+
+  void waitForLastFrame();
+
+  void uploadInstances(const TreeSnapshot &snapshot);
+
+  std::array<F32, 16> getViewProjectionMatrix() const;
+
+  void findVisibleInstances(const std::array<F32, 16> &viewProjection);
+
+  void selectLevelsOfDetail(const std::array<F32, 16> &viewProjection);
+
+  void updateDepthPyramid(const std::array<F32, 16> &viewProjection);
+
+  void useProgram(GLuint program, const ShadingUniformLocations &uniformLocations);
+
+  void readPixelsInto(void *destination);
+
+  U64 getPixelsSize() const;
 
   void updateCameraPosition();
 
 public:
   static constexpr U32 DefaultWindowSide = 1024;
 
-  OpenGlWindow();
+  // The maximum number of pixel readbacks in flight.
+  static constexpr U64 PixelPackBufferCount = 3;
+
+#ifdef OFFSCREEN_RENDERING
+  static constexpr bool OffscreenRenderingSupported = true;
+#else
+  static constexpr bool OffscreenRenderingSupported = false;
+#endif
+
+  explicit OpenGlWindow(U32 width = DefaultWindowSide, U32 height = DefaultWindowSide, bool offscreen = false);
 
   virtual ~OpenGlWindow();
 
   void setCameraForBoundingBox(BoundingBox boundingBox);
 
-  void drawTree(const Tree &tree);
+  void drawTree(const TreeSnapshot &snapshot);
+
+  /**
+   * Draws the tree as one tube per axis, which needs a snapshot with a tube mesh.
+   */
+  void drawTreeAsTubes(const TreeSnapshot &snapshot);
 
   void setShouldClose();
 
@@ -65,4 +178,32 @@ public:
   void pollEvents();
 
   void swapBuffers();
+
+  int getViewportWidth() const;
+
+  int getViewportHeight() const;
+
+  /**
+   * Reads what was drawn since the last call to startDrawing as BGR values, with the bottom row first.
+   */
+  std::vector<uint8_t> readPixels();
+
+  /**
+   * Starts reading what was drawn since the last call to startDrawing, without waiting for the GPU to finish drawing.
+   *
+   * At most PixelPackBufferCount requests may be pending, the oldest must be taken before making another one.
+   */
+  void requestPixels();
+
+  U64 countRequestedPixels() const;
+
+  /**
+   * Returns whether the oldest requested pixels can be taken without waiting.
+   */
+  bool arePixelsReady();
+
+  /**
+   * Returns the oldest requested pixels, in the format of readPixels, waiting for them if needed.
+   */
+  std::vector<uint8_t> takePixels();
 };
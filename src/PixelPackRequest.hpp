@@ -0,0 +1,15 @@
+#pragma once
+
+#include <glad/glad.h>
+
+#include "Types.hpp"
+
+/**
+ * A readback into a pixel pack buffer which is done once its fence is signaled.
+ */
+class PixelPackRequest {
+public:
+  GLuint buffer{};
+  GLsync fence{};
+  U64 size{};
+};
@@ -0,0 +1,539 @@
+#include "PointCloudImporter.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <charconv>
+#include <cmath>
+#include <cstring>
+#include <exception>
+#include <functional>
+#include <limits>
+#include <sstream>
+#include <stdexcept>
+#include <string_view>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "MappedFile.hpp"
+#include "Trace.hpp"
+
+// Chunks are handed out one at a time, so threads which get cheap chunks take more of them.
+static constexpr U64 ChunksPerThread = 4;
+
+// Voxels are keyed by their coordinates along each axis, packed into 21 bits each.
+static constexpr U64 VoxelAxisBits = 21;
+
+enum class PlyType : U32 { Int8, UInt8, Int16, UInt16, Int32, UInt32, Float32, Float64 };
+
+/**
+ * A PLY element, with the offsets of its scalar properties in binary records and their columns in ASCII lines.
+ */
+class PlyElement {
+public:
+  static constexpr U32 UnknownColumn = std::numeric_limits<U32>::max();
+
+  std::string name;
+  U64 count{};
+  U64 stride{};
+  bool hasList = false;
+  std::vector<std::string> names;
+  std::vector<PlyType> types;
+  std::vector<U64> offsets;
+  std::vector<U32> columns;
+};
+
+/**
+ * Where the points are in the file, and how to read them.
+ */
+class PointLayout {
+public:
+  bool binary = false;
+  bool bigEndian = false;
+  U64 begin{};
+  U64 end{};
+  // The columns of the coordinates in lines of text.
+  U32 columns[3] = {0, 1, 2};
+  // The size of binary records, and the offsets and types of the coordinates in them.
+  U64 stride{};
+  U64 offsets[3]{};
+  PlyType types[3]{};
+};
+
+/**
+ * The points of a part of the file, in file order, relative to the first point of the file.
+ */
+class PointChunk {
+public:
+  U64 begin{};
+  U64 end{};
+  std::vector<Point> points;
+  std::vector<U32> cells;
+  // The number of points of this chunk in each cell, and then where they go in the cell.
+  std::vector<U32> cellOffsets;
+  Point minimum{std::numeric_limits<float>::infinity(), std::numeric_limits<float>::infinity(), std::numeric_limits<float>::infinity()};
+  Point maximum{-std::numeric_limits<float>::infinity(), -std::numeric_limits<float>::infinity(), -std::numeric_limits<float>::infinity()};
+
+  void add(Point point) {
+    points.push_back(point);
+    minimum = Point(std::min(minimum.x, point.x), std::min(minimum.y, point.y), std::min(minimum.z, point.z));
+    maximum = Point(std::max(maximum.x, point.x), std::max(maximum.y, point.y), std::max(maximum.z, point.z));
+  }
+};
+
+static void runInParallel(U32 threadCount, U64 count, const std::function<void(U64)> &work) {
+  std::atomic<U64> next{0};
+  std::vector<std::exception_ptr> errors(std::max<U64>(1, std::min<U64>(threadCount, count)));
+  const auto run = [&](std::size_t thread) {
+    try {
+      for (auto i = next++; i < count; i = next++) {
+        work(i);
+      }
+    } catch (...) {
+      errors[thread] = std::current_exception();
+      next = count;
+    }
+  };
+  std::vector<std::thread> threads;
+  for (std::size_t i = 1; i < errors.size(); i++) {
+    threads.emplace_back(run, i);
+  }
+  run(0);
+  for (auto &thread : threads) {
+    thread.join();
+  }
+  for (const auto &error : errors) {
+    if (error) {
+      std::rethrow_exception(error);
+    }
+  }
+}
+
+static U64 skipLines(const char *data, U64 size, U64 position, U64 lines) {
+  for (U64 i = 0; i < lines && position < size; i++) {
+    const auto *newline = static_cast<const char *>(std::memchr(data + position, '\n', size - position));
+    position = newline ? static_cast<U64>(newline - data) + 1 : size;
+  }
+  return position;
+}
+
+static PlyType parsePlyType(const std::string &name) {
+  if (name == "char" || name == "int8") {
+    return PlyType::Int8;
+  }
+  if (name == "uchar" || name == "uint8") {
+    return PlyType::UInt8;
+  }
+  if (name == "short" || name == "int16") {
+    return PlyType::Int16;
+  }
+  if (name == "ushort" || name == "uint16") {
+    return PlyType::UInt16;
+  }
+  if (name == "int" || name == "int32") {
+    return PlyType::Int32;
+  }
+  if (name == "uint" || name == "uint32") {
+    return PlyType::UInt32;
+  }
+  if (name == "float" || name == "float32") {
+    return PlyType::Float32;
+  }
+  if (name == "double" || name == "float64") {
+    return PlyType::Float64;
+  }
+  throw std::runtime_error("Unknown PLY property type " + name + ".");
+}
+
+static U64 getPlyTypeSize(PlyType type) {
+  switch (type) {
+  case PlyType::Int8:
+  case PlyType::UInt8:
+    return 1;
+  case PlyType::Int16:
+  case PlyType::UInt16:
+    return 2;
+  case PlyType::Int32:
+  case PlyType::UInt32:
+  case PlyType::Float32:
+    return 4;
+  case PlyType::Float64:
+    return 8;
+  }
+  throw std::logic_error("Unhandled PLY property type.");
+}
+
+template <typename T> static double readAs(const U8 *bytes) {
+  T value;
+  std::memcpy(&value, bytes, sizeof(T));
+  return static_cast<double>(value);
+}
+
+static double readScalar(const U8 *bytes, PlyType type, bool bigEndian) {
+  U8 buffer[8];
+  const auto size = getPlyTypeSize(type);
+  if (bigEndian) {
+    std::reverse_copy(bytes, bytes + size, buffer);
+  } else {
+    std::memcpy(buffer, bytes, size);
+  }
+  switch (type) {
+  case PlyType::Int8:
+    return readAs<int8_t>(buffer);
+  case PlyType::UInt8:
+    return readAs<uint8_t>(buffer);
+  case PlyType::Int16:
+    return readAs<int16_t>(buffer);
+  case PlyType::UInt16:
+    return readAs<uint16_t>(buffer);
+  case PlyType::Int32:
+    return readAs<int32_t>(buffer);
+  case PlyType::UInt32:
+    return readAs<uint32_t>(buffer);
+  case PlyType::Float32:
+    return readAs<F32>(buffer);
+  case PlyType::Float64:
+    return readAs<F64>(buffer);
+  }
+  throw std::logic_error("Unhandled PLY property type.");
+}
+
+static PointLayout parsePlyHeader(const char *data, U64 size, const std::string &filename) {
+  const std::string_view text(data, size);
+  const auto endHeader = text.find("end_header");
+  const auto headerEnd = endHeader == std::string_view::npos ? std::string_view::npos : text.find('\n', endHeader);
+  if (headerEnd == std::string_view::npos) {
+    throw std::runtime_error(filename + " has no end to its PLY header.");
+  }
+  std::istringstream header{std::string(text.substr(0, headerEnd))};
+  std::string format;
+  std::vector<PlyElement> elements;
+  std::string line;
+  while (std::getline(header, line)) {
+    std::istringstream words(line);
+    std::string keyword;
+    words >> keyword;
+    if (keyword == "format") {
+      words >> format;
+    } else if (keyword == "element") {
+      elements.emplace_back();
+      words >> elements.back().name >> elements.back().count;
+    } else if (keyword == "property") {
+      if (elements.empty()) {
+        throw std::runtime_error(filename + " has a PLY property outside of any element.");
+      }
+      auto &element = elements.back();
+      std::string type;
+      std::string name;
+      words >> type;
+      if (type == "list") {
+        // Lists have a variable size, so neither the offsets nor the columns of the properties after them are known.
+        element.hasList = true;
+        continue;
+      }
+      words >> name;
+      element.names.push_back(name);
+      element.types.push_back(parsePlyType(type));
+      element.offsets.push_back(element.stride);
+      element.columns.push_back(element.hasList ? PlyElement::UnknownColumn : static_cast<U32>(element.columns.size()));
+      element.stride += getPlyTypeSize(element.types.back());
+    }
+  }
+  PointLayout layout;
+  if (format == "ascii") {
+    layout.binary = false;
+  } else if (format == "binary_little_endian" || format == "binary_big_endian") {
+    layout.binary = true;
+    layout.bigEndian = format == "binary_big_endian";
+  } else {
+    throw std::runtime_error(filename + " has an unknown PLY format " + format + ".");
+  }
+  auto position = static_cast<U64>(headerEnd) + 1;
+  for (const auto &element : elements) {
+    if (element.name != "vertex") {
+      if (layout.binary && element.hasList) {
+        throw std::runtime_error(filename + " has PLY lists before its vertices.");
+      }
+      position = layout.binary ? position + element.count * element.stride : skipLines(data, size, position, element.count);
+      continue;
+    }
+    if (layout.binary && element.hasList) {
+      throw std::runtime_error(filename + " has PLY vertices with lists.");
+    }
+    const std::string axes[3] = {"x", "y", "z"};
+    for (U32 axis = 0; axis < 3; axis++) {
+      const auto iterator = std::find(std::begin(element.names), std::end(element.names), axes[axis]);
+      if (iterator == std::end(element.names)) {
+        throw std::runtime_error(filename + " has PLY vertices without " + axes[axis] + ".");
+      }
+      const auto property = static_cast<std::size_t>(iterator - std::begin(element.names));
+      if (!layout.binary && element.columns[property] == PlyElement::UnknownColumn) {
+        throw std::runtime_error(filename + " has PLY vertices with " + axes[axis] + " after a list.");
+      }
+      layout.columns[axis] = element.columns[property];
+      layout.offsets[axis] = element.offsets[property];
+      layout.types[axis] = element.types[property];
+    }
+    layout.stride = element.stride;
+    layout.begin = position;
+    layout.end = layout.binary ? position + element.count * element.stride : skipLines(data, size, position, element.count);
+    if (layout.end > size) {
+      throw std::runtime_error(filename + " is shorter than its PLY header says.");
+    }
+    return layout;
+  }
+  throw std::runtime_error(filename + " has no PLY vertices.");
+}
+
+static bool isSeparator(char c) {
+  return c == ' ' || c == '\t' || c == ',' || c == '\r';
+}
+
+static bool parseDouble(const char *begin, const char *end, double &value) {
+  // Unlike strtod, from_chars does not accept a plus sign, nor depend on the locale.
+  if (begin != end && *begin == '+') {
+    begin++;
+  }
+  const auto result = std::from_chars(begin, end, value);
+  return result.ec == std::errc() && result.ptr == end && std::isfinite(value);
+}
+
+/**
+ * Parses the coordinates from their columns of a line, returning false if it has no numbers in them.
+ */
+static bool parseLine(const char *line, const char *lineEnd, const U32 columns[3], double coordinates[3]) {
+  const auto lastColumn = std::max({columns[0], columns[1], columns[2]});
+  U32 parsed = 0;
+  auto *field = line;
+  for (U32 column = 0; column <= lastColumn; column++) {
+    while (field < lineEnd && isSeparator(*field)) {
+      field++;
+    }
+    auto *fieldEnd = field;
+    while (fieldEnd < lineEnd && !isSeparator(*fieldEnd)) {
+      fieldEnd++;
+    }
+    if (field == fieldEnd) {
+      return false;
+    }
+    for (U32 axis = 0; axis < 3; axis++) {
+      if (columns[axis] == column) {
+        if (!parseDouble(field, fieldEnd, coordinates[axis])) {
+          return false;
+        }
+        parsed++;
+      }
+    }
+    field = fieldEnd;
+  }
+  return parsed == 3;
+}
+
+/**
+ * Reads the coordinates of the point at the position, which is a line of text or a binary record, and returns where the
+ * next one begins.
+ */
+static U64 readPoint(const U8 *data, const PointLayout &layout, U64 position, U64 end, bool &valid, double coordinates[3]) {
+  if (layout.binary) {
+    for (U32 axis = 0; axis < 3; axis++) {
+      coordinates[axis] = readScalar(data + position + layout.offsets[axis], layout.types[axis], layout.bigEndian);
+    }
+    valid = std::isfinite(coordinates[0]) && std::isfinite(coordinates[1]) && std::isfinite(coordinates[2]);
+    return position + layout.stride;
+  }
+  const auto *text = reinterpret_cast<const char *>(data);
+  const auto *newline = static_cast<const char *>(std::memchr(text + position, '\n', end - position));
+  const auto lineEnd = newline ? static_cast<U64>(newline - text) : end;
+  valid = parseLine(text + position, text + lineEnd, layout.columns, coordinates);
+  return lineEnd + 1;
+}
+
+static void transform(double coordinates[3], bool zUp) {
+  if (zUp) {
+    const auto y = coordinates[1];
+    coordinates[1] = coordinates[2];
+    coordinates[2] = -y;
+  }
+}
+
+static std::vector<PointChunk> splitIntoChunks(const U8 *data, const PointLayout &layout, U64 chunkCount) {
+  std::vector<PointChunk> chunks(chunkCount);
+  const auto length = layout.end - layout.begin;
+  auto begin = layout.begin;
+  for (U64 i = 0; i < chunkCount; i++) {
+    auto end = layout.begin + length * (i + 1) / chunkCount;
+    if (layout.binary) {
+      end = layout.begin + (end - layout.begin) / layout.stride * layout.stride;
+    } else if (end > layout.begin && end < layout.end && data[end - 1] != '\n') {
+      // Chunks of text end after a whole line.
+      end = skipLines(reinterpret_cast<const char *>(data), layout.end, end, 1);
+    }
+    end = i + 1 == chunkCount ? layout.end : std::max(begin, end);
+    chunks[i].begin = begin;
+    chunks[i].end = end;
+    begin = end;
+  }
+  return chunks;
+}
+
+/**
+ * Returns the range of the grid along an axis, at least one cell of the longest axis long, so that flat scans, such as
+ * facades, still have cells.
+ */
+static Range getGridRange(float minimum, float maximum, float longest, U64 resolution) {
+  const auto shortest = longest > 0.0f ? longest / static_cast<float>(resolution) : 1.0f;
+  const auto padding = std::max(0.0f, 0.5f * (shortest - (maximum - minimum)));
+  return Range(minimum - padding, maximum + padding);
+}
+
+static U64 getVoxelKey(Point point, Point origin, float voxelSize) {
+  const auto x = static_cast<U64>(std::max(0.0f, std::floor((point.x - origin.x) / voxelSize)));
+  const auto y = static_cast<U64>(std::max(0.0f, std::floor((point.y - origin.y) / voxelSize)));
+  const auto z = static_cast<U64>(std::max(0.0f, std::floor((point.z - origin.z) / voxelSize)));
+  return (x << (2 * VoxelAxisBits)) | (y << VoxelAxisBits) | z;
+}
+
+/**
+ * Keeps the first marker of the cell in each voxel, in their order.
+ */
+static void keepFirstInVoxels(std::vector<Marker> &cell, Point origin, float voxelSize) {
+  std::vector<std::pair<U64, U32>> keys(cell.size());
+  for (std::size_t i = 0; i < cell.size(); i++) {
+    keys[i] = {getVoxelKey(cell[i].position, origin, voxelSize), static_cast<U32>(i)};
+  }
+  std::sort(std::begin(keys), std::end(keys));
+  std::vector<U32> kept;
+  for (std::size_t i = 0; i < keys.size(); i++) {
+    if (i == 0 || keys[i].first != keys[i - 1].first) {
+      kept.push_back(keys[i].second);
+    }
+  }
+  std::sort(std::begin(kept), std::end(kept));
+  // Every kept marker is at or after its new place, so they are moved front to back.
+  for (std::size_t i = 0; i < kept.size(); i++) {
+    cell[i] = cell[kept[i]];
+  }
+  cell.resize(kept.size());
+}
+
+MarkerSet PointCloudImporter::read(const std::string &filename) const {
+  TraceScope traceScope("PointCloudImporter::read", "io");
+  if (resolution < 1) {
+    throw std::invalid_argument("Resolution must be at least 1.");
+  }
+  const MappedFile file(filename);
+  const auto *data = file.getData();
+  const auto size = file.getSize();
+  const auto *text = reinterpret_cast<const char *>(data);
+  const std::string_view start(text, std::min<U64>(size, 5));
+  PointLayout layout;
+  if (start.substr(0, 4) == "ply\n" || start == "ply\r\n") {
+    layout = parsePlyHeader(text, size, filename);
+  } else {
+    layout.end = size;
+  }
+  // Points are parsed relative to the first one, so that coordinates far from the origin, as in georeferenced scans, do
+  // not lose their precision in floats.
+  double reference[3]{};
+  auto foundReference = false;
+  for (auto position = layout.begin; position < layout.end && !foundReference;) {
+    position = readPoint(data, layout, position, layout.end, foundReference, reference);
+  }
+  if (!foundReference) {
+    throw std::runtime_error(filename + " has no points.");
+  }
+  transform(reference, zUp);
+  auto chunks = splitIntoChunks(data, layout, std::max<U64>(1, threadCount * ChunksPerThread));
+  runInParallel(threadCount, chunks.size(), [&](U64 i) {
+    TraceScope chunkTraceScope("PointCloudImporter::parseChunk", "io");
+    auto &chunk = chunks[i];
+    double coordinates[3];
+    auto valid = false;
+    for (auto position = chunk.begin; position < chunk.end;) {
+      position = readPoint(data, layout, position, chunk.end, valid, coordinates);
+      if (valid) {
+        transform(coordinates, zUp);
+        chunk.add(Point(static_cast<float>(coordinates[0] - reference[0]), static_cast<float>(coordinates[1] - reference[1]),
+                        static_cast<float>(coordinates[2] - reference[2])));
+      }
+    }
+  });
+  Point minimum = chunks.front().minimum;
+  Point maximum = chunks.front().maximum;
+  for (const auto &chunk : chunks) {
+    minimum = Point(std::min(minimum.x, chunk.minimum.x), std::min(minimum.y, chunk.minimum.y), std::min(minimum.z, chunk.minimum.z));
+    maximum = Point(std::max(maximum.x, chunk.maximum.x), std::max(maximum.y, chunk.maximum.y), std::max(maximum.z, chunk.maximum.z));
+  }
+  double translation[3] = {reference[0], reference[1], reference[2]};
+  if (centered) {
+    translation[0] = -0.5 * (static_cast<double>(minimum.x) + maximum.x);
+    translation[1] = -static_cast<double>(minimum.y);
+    translation[2] = -0.5 * (static_cast<double>(minimum.z) + maximum.z);
+  }
+  const auto translate = [&translation](Point point) {
+    return Point(static_cast<float>(point.x + translation[0]), static_cast<float>(point.y + translation[1]), static_cast<float>(point.z + translation[2]));
+  };
+  minimum = translate(minimum);
+  maximum = translate(maximum);
+  const auto longest = std::max({maximum.x - minimum.x, maximum.y - minimum.y, maximum.z - minimum.z});
+  MarkerSet markerSet(getGridRange(minimum.x, maximum.x, longest, resolution), getGridRange(minimum.y, maximum.y, longest, resolution),
+                      getGridRange(minimum.z, maximum.z, longest, resolution), resolution);
+  const auto cellCount = resolution * resolution * resolution;
+  runInParallel(threadCount, chunks.size(), [&](U64 i) {
+    auto &chunk = chunks[i];
+    chunk.cells.resize(chunk.points.size());
+    chunk.cellOffsets.assign(cellCount, 0);
+    for (std::size_t j = 0; j < chunk.points.size(); j++) {
+      chunk.points[j] = translate(chunk.points[j]);
+      chunk.cells[j] = static_cast<U32>(markerSet.getCellIndex(chunk.points[j]));
+      chunk.cellOffsets[chunk.cells[j]]++;
+    }
+  });
+  // The points of each chunk go after those of the chunks before it, so every cell keeps the order of the file.
+  std::vector<U64> cellSizes(cellCount);
+  for (U64 cell = 0; cell < cellCount; cell++) {
+    U64 offset = 0;
+    for (auto &chunk : chunks) {
+      const auto count = chunk.cellOffsets[cell];
+      chunk.cellOffsets[cell] = static_cast<U32>(offset);
+      offset += count;
+    }
+    cellSizes[cell] = offset;
+  }
+  std::vector<Marker *> cells(cellCount);
+  runInParallel(threadCount, resolution, [&](U64 x) {
+    for (U64 y = 0; y < resolution; y++) {
+      for (U64 z = 0; z < resolution; z++) {
+        const auto cell = (x * resolution + y) * resolution + z;
+        auto &markers = markerSet.markers[x][y][z];
+        markers.resize(cellSizes[cell]);
+        cells[cell] = markers.data();
+      }
+    }
+  });
+  runInParallel(threadCount, chunks.size(), [&](U64 i) {
+    auto &chunk = chunks[i];
+    for (std::size_t j = 0; j < chunk.points.size(); j++) {
+      const auto cell = chunk.cells[j];
+      cells[cell][chunk.cellOffsets[cell]++].position = chunk.points[j];
+    }
+    chunk = PointChunk{};
+  });
+  if (voxelSize > 0.0f) {
+    TraceScope downsampleTraceScope("PointCloudImporter::downsample", "io");
+    const auto origin = Point(markerSet.xRange.minimum, markerSet.yRange.minimum, markerSet.zRange.minimum);
+    const auto longestRange = std::max({markerSet.xRange.getLength(), markerSet.yRange.getLength(), markerSet.zRange.getLength()});
+    if (longestRange / voxelSize >= static_cast<float>(1ULL << VoxelAxisBits)) {
+      throw std::invalid_argument("The voxel size is too small for the extent of the points.");
+    }
+    // Voxels are deduplicated within cells, so a voxel across a cell boundary may keep one point on each side.
+    runInParallel(threadCount, resolution, [&](U64 x) {
+      for (auto &xyVector : markerSet.markers[x]) {
+        for (auto &xyzVector : xyVector) {
+          keepFirstInVoxels(xyzVector, origin, voxelSize);
+        }
+      }
+    });
+  }
+  return markerSet;
+}
@@ -0,0 +1,35 @@
+#pragma once
+
+#include <string>
+
+#include "MarkerSet.hpp"
+#include "Types.hpp"
+
+/**
+ * Reads the points of a scanned volume, such as a LiDAR crown, a building facade, or a hedge, as a marker set.
+ *
+ * XYZ files are text with the coordinates of a point in the first three columns of each line, separated by spaces, tabs,
+ * or commas, and lines which do not start with three numbers (headers and comments) are skipped. PLY files may be ASCII
+ * or binary, and the x, y, and z properties of their vertices are used.
+ *
+ * The file is mapped into memory and split into chunks which are parsed on all threads. The cells of the marker set
+ * split the bounding box of the points, and each chunk writes its points straight into the cells, at offsets counted
+ * beforehand, so points are not copied between parsing and binning.
+ */
+class PointCloudImporter {
+public:
+  U64 resolution = 10;
+
+  // If positive, only the first point in each cube of this side is kept, which bounds the density of markers.
+  float voxelSize = 0.0f;
+
+  // Scans usually have the Z axis up, while trees grow along the Y axis.
+  bool zUp = false;
+
+  // If set, the points are moved so that the bottom center of their bounding box is at the origin, where trees are planted.
+  bool centered = false;
+
+  U32 threadCount = 1;
+
+  MarkerSet read(const std::string &filename) const;
+};
@@ -0,0 +1,167 @@
+#include "ProgramBinaryCache.hpp"
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include <unistd.h>
+
+#include "MappedFile.hpp"
+#include "Types.hpp"
+
+static constexpr char ProgramBinaryMagic[8] = {'S', 'O', 'T', 'M', 'P', 'R', 'O', 'G'};
+
+/**
+ * The beginning of every cached program, followed by its full key and its binary.
+ */
+class ProgramBinaryHeader {
+public:
+  char magic[8];
+  U32 format;
+  U32 keySize;
+  U64 binarySize;
+};
+
+static_assert(sizeof(ProgramBinaryHeader) == 24);
+static_assert(std::is_trivially_copyable_v<ProgramBinaryHeader>);
+
+static std::string getString(GLenum name) {
+  const auto *string = glGetString(name);
+  return string ? reinterpret_cast<const char *>(string) : "";
+}
+
+// FNV-1a, which is enough to name files, as the full key is stored in them and compared when loading.
+static U64 hash(const std::string &string) {
+  U64 hash = 0xCBF29CE484222325ULL;
+  for (const auto c : string) {
+    hash = (hash ^ static_cast<U8>(c)) * 0x100000001B3ULL;
+  }
+  return hash;
+}
+
+static std::vector<GLint> getProgramBinaryFormats() {
+  GLint count = 0;
+  glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &count);
+  std::vector<GLint> formats(std::max(0, count));
+  if (count > 0) {
+    glGetIntegerv(GL_PROGRAM_BINARY_FORMATS, formats.data());
+  }
+  return formats;
+}
+
+ProgramBinaryCache::ProgramBinaryCache(std::string directory) : directory(std::move(directory)) {
+  if (getProgramBinaryFormats().empty()) {
+    this->directory.clear();
+  }
+  driver = getString(GL_VENDOR) + '\n' + getString(GL_RENDERER) + '\n' + getString(GL_VERSION);
+}
+
+std::string ProgramBinaryCache::getDefaultDirectory() {
+  const auto *cacheHome = std::getenv("XDG_CACHE_HOME");
+  if (cacheHome && cacheHome[0] != '\0') {
+    return (std::filesystem::path(cacheHome) / "self-organizing-tree-models").string();
+  }
+  const auto *home = std::getenv("HOME");
+  if (home && home[0] != '\0') {
+    return (std::filesystem::path(home) / ".cache" / "self-organizing-tree-models").string();
+  }
+  return "";
+}
+
+static std::string getFilename(const std::string &directory, const std::string &fullKey) {
+  std::stringstream name;
+  name << "program-" << std::hex << std::setw(16) << std::setfill('0') << hash(fullKey) << ".bin";
+  return (std::filesystem::path(directory) / name.str()).string();
+}
+
+GLuint ProgramBinaryCache::load(const std::string &key) const {
+  if (directory.empty()) {
+    return 0;
+  }
+  const auto fullKey = driver + '\0' + key;
+  const auto filename = getFilename(directory, fullKey);
+  std::error_code error;
+  if (!std::filesystem::exists(filename, error)) {
+    return 0;
+  }
+  try {
+    const MappedFile file(filename);
+    const auto *data = file.getData();
+    const auto size = file.getSize();
+    ProgramBinaryHeader header{};
+    if (size < sizeof(header)) {
+      return 0;
+    }
+    std::memcpy(&header, data, sizeof(header));
+    const auto payloadSize = size - sizeof(header);
+    const auto formats = getProgramBinaryFormats();
+    const auto valid = std::memcmp(header.magic, ProgramBinaryMagic, sizeof(ProgramBinaryMagic)) == 0 && header.keySize == fullKey.size() &&
+                       header.keySize <= payloadSize && header.binarySize == payloadSize - header.keySize &&
+                       std::memcmp(data + sizeof(header), fullKey.data(), fullKey.size()) == 0 &&
+                       std::find(std::begin(formats), std::end(formats), static_cast<GLint>(header.format)) != std::end(formats);
+    if (!valid) {
+      return 0;
+    }
+    const auto program = glCreateProgram();
+    glProgramBinary(program, header.format, data + sizeof(header) + header.keySize, static_cast<GLsizei>(header.binarySize));
+    GLint linkStatus = GL_FALSE;
+    glGetProgramiv(program, GL_LINK_STATUS, &linkStatus);
+    if (linkStatus == GL_FALSE) {
+      glDeleteProgram(program);
+      return 0;
+    }
+    return program;
+  } catch (const std::runtime_error &) {
+    return 0;
+  }
+}
+
+void ProgramBinaryCache::store(const std::string &key, GLuint program) const {
+  if (directory.empty()) {
+    return;
+  }
+  GLint length = 0;
+  glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+  if (length <= 0) {
+    return;
+  }
+  std::vector<char> binary(length);
+  GLsizei written = 0;
+  GLenum format = 0;
+  glGetProgramBinary(program, length, &written, &format, binary.data());
+  if (written <= 0) {
+    return;
+  }
+  const auto fullKey = driver + '\0' + key;
+  ProgramBinaryHeader header{};
+  std::memcpy(header.magic, ProgramBinaryMagic, sizeof(ProgramBinaryMagic));
+  header.format = format;
+  header.keySize = static_cast<U32>(fullKey.size());
+  header.binarySize = static_cast<U64>(written);
+  std::error_code error;
+  std::filesystem::create_directories(directory, error);
+  const auto filename = getFilename(directory, fullKey);
+  // Concurrent starts each write their own file, and the last one to be renamed wins.
+  const auto temporaryFilename = filename + ".tmp" + std::to_string(getpid());
+  std::ofstream stream(temporaryFilename, std::ios::binary | std::ios::trunc);
+  stream.write(reinterpret_cast<const char *>(&header), sizeof(header));
+  stream.write(fullKey.data(), static_cast<std::streamsize>(fullKey.size()));
+  stream.write(binary.data(), written);
+  stream.close();
+  if (stream.fail()) {
+    std::filesystem::remove(temporaryFilename, error);
+    return;
+  }
+  std::filesystem::rename(temporaryFilename, filename, error);
+  if (error) {
+    std::filesystem::remove(temporaryFilename, error);
+  }
+}
@@ -0,0 +1,38 @@
+#pragma once
+
+#include <glad/glad.h>
+
+#include <string>
+
+/**
+ * Stores linked OpenGL programs on disk, so that later starts load them instead of compiling and linking their shaders.
+ *
+ * Programs are keyed by the vendor, renderer, and version of the driver and by the sources of their shaders, so that a
+ * driver update or an edited shader never loads a stale binary. Binaries which the driver rejects are ignored, and the
+ * cache never fails a start: if it cannot be read or written, programs are built from source.
+ */
+class ProgramBinaryCache {
+  std::string directory;
+  std::string driver;
+
+public:
+  /**
+   * Requires a current OpenGL context. An empty directory, or a driver without program binary formats, disables caching.
+   */
+  explicit ProgramBinaryCache(std::string directory);
+
+  /**
+   * Returns the cache directory of the user, under XDG_CACHE_HOME or ~/.cache, or nothing if there is no home.
+   */
+  static std::string getDefaultDirectory();
+
+  /**
+   * Returns the program cached under the key, or zero if there is none.
+   */
+  GLuint load(const std::string &key) const;
+
+  /**
+   * Caches the program under the key. It must have been linked with GL_PROGRAM_BINARY_RETRIEVABLE_HINT set.
+   */
+  void store(const std::string &key, GLuint program) const;
+};
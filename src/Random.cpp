@@ -19,6 +19,9 @@ bool operator!=(SplitMixGenerator const &lhs, SplitMixGenerator const &rhs) {
 SplitMixGenerator::SplitMixGenerator() : m_seed(1) {
 }
 
+SplitMixGenerator::SplitMixGenerator(uint64_t seed) : m_seed(seed) {
+}
+
 SplitMixGenerator::SplitMixGenerator(std::random_device &rd) {
   seed(rd);
 }
@@ -49,3 +52,7 @@ void SplitMixGenerator::discard(unsigned long long n) {
     next();
   }
 }
+
+uint64_t SplitMixGenerator::getState() const {
+  return m_seed;
+}
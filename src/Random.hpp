@@ -23,6 +23,8 @@ public:
 
   SplitMixGenerator();
 
+  explicit SplitMixGenerator(uint64_t seed);
+
   explicit SplitMixGenerator(std::random_device &rd);
 
   void seed(std::random_device &rd);
@@ -35,6 +37,11 @@ public:
 
   void discard(unsigned long long n);
 
+  /**
+   * Returns the state of the generator, which a generator constructed with it as its seed continues from.
+   */
+  uint64_t getState() const;
+
 private:
   uint64_t m_seed;
 };
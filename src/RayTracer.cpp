@@ -0,0 +1,336 @@
+#include "RayTracer.hpp"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cmath>
+#include <limits>
+#include <stdexcept>
+#include <thread>
+
+#include "BoundingVolumeHierarchy.hpp"
+#include "Color.hpp"
+#include "Trace.hpp"
+
+// The clipping planes and the lighting match those of the OpenGL renderer, so that both draw the same image.
+constexpr F32 NearPlaneDistance = 0.01f;
+constexpr F32 FarPlaneDistance = 100.0f;
+constexpr F32 AmbientLightIntensity = 1.0f;
+
+constexpr U32 PacketSize = RayTracer::PacketSide * RayTracer::PacketSide;
+
+static_assert(RayTracer::TileSide % RayTracer::PacketSide == 0);
+
+constexpr F32 Infinity = std::numeric_limits<F32>::infinity();
+
+/**
+ * A vector whose arithmetic can be inlined, as tracing rays is mostly arithmetic on vectors.
+ */
+class Float3 {
+public:
+  F32 x{};
+  F32 y{};
+  F32 z{};
+};
+
+static Float3 toFloat3(const Point &point) {
+  return Float3{point.x, point.y, point.z};
+}
+
+static Float3 add(const Float3 &a, const Float3 &b) {
+  return Float3{a.x + b.x, a.y + b.y, a.z + b.z};
+}
+
+static Float3 subtract(const Float3 &a, const Float3 &b) {
+  return Float3{a.x - b.x, a.y - b.y, a.z - b.z};
+}
+
+static Float3 scale(const Float3 &a, F32 factor) {
+  return Float3{a.x * factor, a.y * factor, a.z * factor};
+}
+
+static F32 dot(const Float3 &a, const Float3 &b) {
+  return a.x * b.x + a.y * b.y + a.z * b.z;
+}
+
+static Float3 cross(const Float3 &a, const Float3 &b) {
+  return Float3{a.y * b.z - a.z * b.y, a.z * b.x - a.x * b.z, a.x * b.y - a.y * b.x};
+}
+
+static Float3 normalize(const Float3 &a) {
+  return scale(a, 1.0f / std::sqrt(dot(a, a)));
+}
+
+/**
+ * Rays from the camera through a square of pixels, stored lane by lane so that loops over the lanes vectorize.
+ */
+class RayPacket {
+public:
+  std::array<F32, PacketSize> directionX{};
+  std::array<F32, PacketSize> directionY{};
+  std::array<F32, PacketSize> directionZ{};
+  std::array<F32, PacketSize> inverseDirectionX{};
+  std::array<F32, PacketSize> inverseDirectionY{};
+  std::array<F32, PacketSize> inverseDirectionZ{};
+  // A ray only hits between these distances, and the maximum shrinks to the nearest hit found so far.
+  std::array<F32, PacketSize> minimumDistance{};
+  std::array<F32, PacketSize> maximumDistance{};
+  // The instance hit by every ray, or -1.
+  std::array<I32, PacketSize> hits{};
+
+  Float3 getDirection(U32 lane) const {
+    return Float3{directionX[lane], directionY[lane], directionZ[lane]};
+  }
+};
+
+/**
+ * Returns whether any ray of the packet enters the box before its maximum distance, using the slab test.
+ */
+static bool intersectsAny(const RayPacket &packet, const Float3 &origin, const BoundingBox &boundingBox) {
+  const auto x0 = boundingBox.xRange.minimum - origin.x;
+  const auto x1 = boundingBox.xRange.maximum - origin.x;
+  const auto y0 = boundingBox.yRange.minimum - origin.y;
+  const auto y1 = boundingBox.yRange.maximum - origin.y;
+  const auto z0 = boundingBox.zRange.minimum - origin.z;
+  const auto z1 = boundingBox.zRange.maximum - origin.z;
+  U32 hits = 0;
+  for (U32 i = 0; i < PacketSize; i++) {
+    const auto tx0 = x0 * packet.inverseDirectionX[i];
+    const auto tx1 = x1 * packet.inverseDirectionX[i];
+    const auto ty0 = y0 * packet.inverseDirectionY[i];
+    const auto ty1 = y1 * packet.inverseDirectionY[i];
+    const auto tz0 = z0 * packet.inverseDirectionZ[i];
+    const auto tz1 = z1 * packet.inverseDirectionZ[i];
+    const auto entry = std::max(std::max(std::min(tx0, tx1), std::min(ty0, ty1)), std::max(std::min(tz0, tz1), packet.minimumDistance[i]));
+    const auto exit = std::min(std::min(std::max(tx0, tx1), std::max(ty0, ty1)), std::min(std::max(tz0, tz1), packet.maximumDistance[i]));
+    hits |= entry <= exit;
+  }
+  return hits != 0;
+}
+
+/**
+ * Intersects every ray of the packet with the capsule of an instance, keeping the nearest hits.
+ *
+ * The capsule is the union of a cylinder and of a sphere at each end. A ray which hits the infinite cylinder within
+ * the segment hits the capsule there first, otherwise its first hit is on one of the spheres, if any. The terms which
+ * only depend on the origin, shared by all rays, are computed once.
+ */
+static void intersectCapsule(RayPacket &packet, const Float3 &origin, const MetamerInstance &instance, I32 index) {
+  const auto a = toFloat3(instance.beginning);
+  const auto b = toFloat3(instance.end);
+  const auto r2 = instance.width * instance.width;
+  const auto ba = subtract(b, a);
+  const auto farOa = subtract(origin, a);
+  const auto farOb = subtract(origin, b);
+  const auto centerFromOrigin = subtract(scale(add(a, b), 0.5f), origin);
+  const auto baba = dot(ba, ba);
+  // The loop has no branches, so that it vectorizes. Square roots of negative discriminants are taken anyway, as abs
+  // keeps them finite, and their results are discarded.
+  for (U32 i = 0; i < PacketSize; i++) {
+    const auto d = packet.getDirection(i);
+    // Seen from afar, the squared radius of a twig is below the precision of squared distances to it, so the ray starts
+    // again abreast of the capsule, where the terms of the quadratics are as small as the capsule.
+    const auto shift = dot(d, centerFromOrigin);
+    const auto oa = add(farOa, scale(d, shift));
+    const auto ob = add(farOb, scale(d, shift));
+    const auto baoa = dot(ba, oa);
+    const auto oaoa = dot(oa, oa);
+    const auto bard = dot(ba, d);
+    const auto rdoa = dot(d, oa);
+    const auto rdob = dot(d, ob);
+    // Directions are normalized, so the quadratic terms of the cylinder and of the spheres simplify.
+    const auto cylinderA = baba - bard * bard;
+    const auto cylinderB = baba * rdoa - baoa * bard;
+    const auto cylinderC = baba * oaoa - baoa * baoa - r2 * baba;
+    const auto h = cylinderB * cylinderB - cylinderA * cylinderC;
+    const auto cylinderT = (-cylinderB - std::sqrt(std::abs(h))) / cylinderA;
+    const auto y = baoa + cylinderT * bard;
+    const auto hitsCylinder = (h >= 0.0f) & (cylinderA > 0.0f) & (y > 0.0f) & (y < baba);
+    const auto hA = rdoa * rdoa - (oaoa - r2);
+    const auto hB = rdob * rdob - (dot(ob, ob) - r2);
+    const auto hitsA = hA >= 0.0f;
+    const auto hitsB = hB >= 0.0f;
+    const auto sphereAT = -rdoa - std::sqrt(std::abs(hA));
+    const auto sphereBT = -rdob - std::sqrt(std::abs(hB));
+    const auto sphereT = hitsA & (!hitsB | (sphereAT < sphereBT)) ? sphereAT : sphereBT;
+    const auto t = shift + (hitsCylinder ? cylinderT : sphereT);
+    const auto nearer = (hitsCylinder | hitsA | hitsB) & (t >= packet.minimumDistance[i]) & (t < packet.maximumDistance[i]);
+    packet.maximumDistance[i] = nearer ? t : packet.maximumDistance[i];
+    packet.hits[i] = nearer ? index : packet.hits[i];
+  }
+}
+
+static F32 evaluateAttenuation(F32 d) {
+  const auto attenuationFlatCoefficient = 0.1f;
+  const auto attenuationLinearCoefficient = 0.1f;
+  const auto attenuationSquareCoefficient = 0.01f;
+  return std::min(1.0f, 1.0f / (attenuationFlatCoefficient + attenuationLinearCoefficient * d + attenuationSquareCoefficient * d * d));
+}
+
+/**
+ * Shades a point on a capsule as OpenGlFragmentShader.glsl does, with a light one meter above the camera.
+ */
+static Float3 shade(const Float3 &cameraPosition, const Float3 &direction, F32 distance, const MetamerInstance &instance) {
+  // Olive Wood
+  const Color color{0.4588f, 0.3843f, 0.2667f};
+  const Float3 albedo{color.channels[0], color.channels[1], color.channels[2]};
+  const auto p = add(cameraPosition, scale(direction, distance));
+  const auto a = toFloat3(instance.beginning);
+  const auto ba = subtract(toFloat3(instance.end), a);
+  const auto baba = dot(ba, ba);
+  const auto h = baba > 0.0f ? std::clamp(dot(subtract(p, a), ba) / baba, 0.0f, 1.0f) : 0.0f;
+  const auto n = normalize(subtract(p, add(a, scale(ba, h))));
+  const auto lightPosition = add(cameraPosition, Float3{0.0f, 1.0f, 0.0f});
+  const auto l = normalize(subtract(lightPosition, p));
+  const auto r = normalize(subtract(scale(n, 2.0f * dot(n, l)), l));
+  const auto v = normalize(subtract(cameraPosition, p));
+  const auto attenuation = evaluateAttenuation(distance);
+  const auto specularCoefficient = 0.1f;
+  const auto surfaceSpecularity = 0.001f;
+  const auto specularComponent = attenuation * specularCoefficient * std::pow(std::max(0.0f, dot(v, r)), surfaceSpecularity);
+  const auto diffuse = attenuation * std::max(0.0f, dot(n, l));
+  const auto intensity = AmbientLightIntensity + diffuse;
+  return Float3{intensity * albedo.x + specularComponent, intensity * albedo.y + specularComponent, intensity * albedo.z + specularComponent};
+}
+
+/**
+ * Everything the worker threads share to render their tiles.
+ */
+class TileRenderer {
+public:
+  const std::vector<MetamerInstance> &instances;
+  const BoundingVolumeHierarchy &hierarchy;
+  U32 width{};
+  U32 height{};
+  U32 samplesPerSide{};
+  Float3 origin{};
+  Float3 forward{};
+  Float3 right{};
+  Float3 up{};
+  // Half the extent of the image plane one meter in front of the camera.
+  F32 halfWidth{};
+  F32 halfHeight{};
+
+  void preparePacket(RayPacket &packet, U32 left, U32 top, F32 offsetX, F32 offsetY) const {
+    for (U32 i = 0; i < PacketSize; i++) {
+      const auto x = left + i % RayTracer::PacketSide;
+      const auto y = top + i / RayTracer::PacketSide;
+      // Rays past the edges of the image still get a valid direction, but can hit nothing.
+      const auto inside = x < width && y < height;
+      const auto u = (2.0f * (x + offsetX) / width - 1.0f) * halfWidth;
+      const auto v = (1.0f - 2.0f * (y + offsetY) / height) * halfHeight;
+      const auto direction = normalize(add(forward, add(scale(right, u), scale(up, v))));
+      packet.directionX[i] = direction.x;
+      packet.directionY[i] = direction.y;
+      packet.directionZ[i] = direction.z;
+      packet.inverseDirectionX[i] = 1.0f / direction.x;
+      packet.inverseDirectionY[i] = 1.0f / direction.y;
+      packet.inverseDirectionZ[i] = 1.0f / direction.z;
+      // OpenGL clips by the depth along the view direction, not by the distance along the ray.
+      const auto cosine = dot(direction, forward);
+      packet.minimumDistance[i] = inside ? NearPlaneDistance / cosine : Infinity;
+      packet.maximumDistance[i] = inside ? FarPlaneDistance / cosine : 0.0f;
+      packet.hits[i] = -1;
+    }
+  }
+
+  void tracePacket(RayPacket &packet) const {
+    const Point originPoint(origin.x, origin.y, origin.z);
+    const auto accept = [this, &packet](const BoundingBox &boundingBox) { return intersectsAny(packet, origin, boundingBox); };
+    const auto visit = [this, &packet](const std::vector<U32> &leafInstances) {
+      for (const auto index : leafInstances) {
+        intersectCapsule(packet, origin, instances[index], static_cast<I32>(index));
+      }
+    };
+    hierarchy.traverse(originPoint, accept, visit);
+  }
+
+  void renderTile(U32 left, U32 top, std::vector<uint8_t> &pixels) const {
+    const auto samples = samplesPerSide * samplesPerSide;
+    RayPacket packet;
+    for (auto packetTop = top; packetTop < std::min(top + RayTracer::TileSide, height); packetTop += RayTracer::PacketSide) {
+      for (auto packetLeft = left; packetLeft < std::min(left + RayTracer::TileSide, width); packetLeft += RayTracer::PacketSide) {
+        std::array<Float3, PacketSize> sums{};
+        for (U32 sample = 0; sample < samples; sample++) {
+          const auto offsetX = (sample % samplesPerSide + 0.5f) / samplesPerSide;
+          const auto offsetY = (sample / samplesPerSide + 0.5f) / samplesPerSide;
+          preparePacket(packet, packetLeft, packetTop, offsetX, offsetY);
+          tracePacket(packet);
+          for (U32 i = 0; i < PacketSize; i++) {
+            if (packet.hits[i] < 0) {
+              continue;
+            }
+            const auto color = shade(origin, packet.getDirection(i), packet.maximumDistance[i], instances[packet.hits[i]]);
+            // Like a framebuffer, every sample saturates before they are averaged.
+            sums[i] = add(sums[i], Float3{std::min(color.x, 1.0f), std::min(color.y, 1.0f), std::min(color.z, 1.0f)});
+          }
+        }
+        for (U32 i = 0; i < PacketSize; i++) {
+          const auto x = packetLeft + i % RayTracer::PacketSide;
+          const auto y = packetTop + i / RayTracer::PacketSide;
+          if (x >= width || y >= height) {
+            continue;
+          }
+          const auto average = scale(sums[i], 1.0f / samples);
+          auto *pixel = &pixels[(static_cast<std::size_t>(y) * width + x) * 3];
+          pixel[0] = static_cast<uint8_t>(std::lround(average.z * 255.0f));
+          pixel[1] = static_cast<uint8_t>(std::lround(average.y * 255.0f));
+          pixel[2] = static_cast<uint8_t>(std::lround(average.x * 255.0f));
+        }
+      }
+    }
+  }
+};
+
+RayTracer::RayTracer(U32 width, U32 height, U32 samplesPerSide, U32 threadCount)
+    : width(width), height(height), samplesPerSide(samplesPerSide), threadCount(threadCount) {
+  if (width == 0 || height == 0) {
+    throw std::invalid_argument("The image must have at least one pixel.");
+  }
+  if (samplesPerSide == 0) {
+    throw std::invalid_argument("Pixels must have at least one sample.");
+  }
+  if (threadCount == 0) {
+    throw std::invalid_argument("Rendering needs at least one thread.");
+  }
+}
+
+std::vector<uint8_t> RayTracer::render(const TreeSnapshot &snapshot, const Camera &camera) const {
+  TraceScope traceScope("RayTracer::render", "render");
+  BoundingVolumeHierarchy hierarchy;
+  for (const auto &instance : snapshot.instances) {
+    hierarchy.insert(instance.getBoundingBox());
+  }
+  // Insertions leave the hierarchy deeper than needed, and it is traversed by every packet.
+  hierarchy.rebuild();
+  TileRenderer tileRenderer{snapshot.instances, hierarchy};
+  tileRenderer.width = width;
+  tileRenderer.height = height;
+  tileRenderer.samplesPerSide = samplesPerSide;
+  tileRenderer.origin = toFloat3(camera.position);
+  // The same basis as glm::lookAt with the Y axis up.
+  tileRenderer.forward = normalize(subtract(toFloat3(camera.lookAtPosition), tileRenderer.origin));
+  tileRenderer.right = normalize(cross(tileRenderer.forward, Float3{0.0f, 1.0f, 0.0f}));
+  tileRenderer.up = cross(tileRenderer.right, tileRenderer.forward);
+  tileRenderer.halfHeight = std::tan(camera.fov / 2.0f);
+  tileRenderer.halfWidth = tileRenderer.halfHeight * width / height;
+  std::vector<uint8_t> pixels(static_cast<std::size_t>(width) * height * 3);
+  const auto tilesPerRow = (width + TileSide - 1) / TileSide;
+  const auto tiles = static_cast<U64>(tilesPerRow) * ((height + TileSide - 1) / TileSide);
+  // Tiles are handed out one at a time, so threads which get cheap tiles take more of them.
+  std::atomic<U64> nextTile{0};
+  const auto work = [&]() {
+    for (auto tile = nextTile++; tile < tiles; tile = nextTile++) {
+      TraceScope tileTraceScope("RayTracer::renderTile", "render");
+      tileRenderer.renderTile(tile % tilesPerRow * TileSide, tile / tilesPerRow * TileSide, pixels);
+    }
+  };
+  std::vector<std::thread> threads;
+  for (U64 i = 0; i < std::min<U64>(threadCount, tiles); i++) {
+    threads.emplace_back(work);
+  }
+  for (auto &thread : threads) {
+    thread.join();
+  }
+  return pixels;
+}
@@ -0,0 +1,40 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "Camera.hpp"
+#include "TreeSnapshot.hpp"
+#include "Types.hpp"
+
+/**
+ * Renders trees on the CPU by casting rays against the metamers, with the shading of the OpenGL fragment shader.
+ *
+ * Metamers are capsules, cylinders with round ends, found through a bounding volume hierarchy. The image is split into
+ * square tiles which worker threads take one at a time, and the rays of neighboring pixels are traced together as a
+ * packet, which walks the hierarchy once for all of them.
+ */
+class RayTracer {
+  const U32 width;
+  const U32 height;
+  const U32 samplesPerSide;
+  const U32 threadCount;
+
+public:
+  static constexpr U32 TileSide = 16;
+
+  // Packets span a square of pixels, which must evenly divide a tile.
+  static constexpr U32 PacketSide = 4;
+
+  static constexpr U32 DefaultSamplesPerSide = 4;
+
+  /**
+   * Every pixel averages a grid of samples per side squared samples.
+   */
+  RayTracer(U32 width, U32 height, U32 samplesPerSide, U32 threadCount);
+
+  /**
+   * Renders the snapshot as seen by the camera, as BGR values with the top row first.
+   */
+  std::vector<uint8_t> render(const TreeSnapshot &snapshot, const Camera &camera) const;
+};
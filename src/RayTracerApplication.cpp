@@ -0,0 +1,131 @@
+#include <algorithm>
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <optional>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <utility>
+
+#include "Camera.hpp"
+#include "Environment.hpp"
+#include "GrowthParameters.hpp"
+#include "Image.hpp"
+#include "MarkerSet.hpp"
+#include "Random.hpp"
+#include "RayTracer.hpp"
+#include "Trace.hpp"
+#include "Tree.hpp"
+#include "TreeFile.hpp"
+#include "TreeSnapshot.hpp"
+
+static std::string getNextArgument(int argc, char *argv[], int &i) {
+  const auto option = std::string(argv[i]);
+  i++;
+  if (i >= argc) {
+    throw std::invalid_argument("Missing value for " + option + ".");
+  }
+  return std::string(argv[i]);
+}
+
+static float secondsSince(std::chrono::steady_clock::time_point begin) {
+  const std::chrono::duration<float> duration = std::chrono::steady_clock::now() - begin;
+  return duration.count();
+}
+
+static TreeSnapshot growTree(U64 targetMetamers, U64 seed, const GrowthParameters &growthParameters) {
+  SplitMixGenerator splitMixGenerator(seed);
+  MarkerSet markerSet(splitMixGenerator, 2.0f, 10, 1000 * 1000);
+  Environment environment(splitMixGenerator, std::move(markerSet), growthParameters);
+  Tree tree(environment, Point{});
+  auto metamerCount = tree.countMetamers();
+  while (metamerCount < targetMetamers) {
+    tree.performGrowthIteration();
+    const auto previousMetamerCount = metamerCount;
+    metamerCount = tree.countMetamers();
+    if (metamerCount == previousMetamerCount) {
+      std::cout << "Growth stalled before reaching the target." << '\n';
+      break;
+    }
+  }
+  return TreeSnapshot(tree, nullptr, false);
+}
+
+/**
+ * Grows a tree, or loads one written by the headless simulation with --tree-file, and renders it by ray tracing on the
+ * CPU, without any OpenGL dependency.
+ *
+ * The defaults grow the same tree as the interactive application and frame it the same way, so the image matches the
+ * one written with --image.
+ */
+int main(int argc, char *argv[]) {
+  U64 targetMetamers = 5 * 1000;
+  U64 seed = 1;
+  U32 width = 1024;
+  U32 height = 1024;
+  U32 samplesPerSide = RayTracer::DefaultSamplesPerSide;
+  U32 threads = std::max(1U, std::thread::hardware_concurrency());
+  std::optional<BoundingBox> userSpecifiedBoundingBox;
+  std::string outputFilename = "image.png";
+  std::string traceFilename;
+  std::string treeFilename;
+  GrowthParameters growthParameters;
+  for (int i = 1; i < argc; i++) {
+    const auto argument = std::string(argv[i]);
+    if (argument == "--metamers") {
+      targetMetamers = std::stoull(getNextArgument(argc, argv, i));
+    } else if (argument == "--seed") {
+      seed = std::stoull(getNextArgument(argc, argv, i));
+    } else if (argument == "--parameter") {
+      const auto name = getNextArgument(argc, argv, i);
+      growthParameters.set(name, std::stof(getNextArgument(argc, argv, i)));
+    } else if (argument == "--resolution") {
+      width = std::stoul(getNextArgument(argc, argv, i));
+      height = std::stoul(getNextArgument(argc, argv, i));
+    } else if (argument == "--samples") {
+      samplesPerSide = std::stoul(getNextArgument(argc, argv, i));
+    } else if (argument == "--threads") {
+      threads = std::stoul(getNextArgument(argc, argv, i));
+    } else if (argument == "--bounding-box") {
+      std::stringstream values;
+      for (int j = 0; j < 6; j++) {
+        if (j != 0) {
+          values << ' ';
+        }
+        values << getNextArgument(argc, argv, i);
+      }
+      userSpecifiedBoundingBox = BoundingBox(values.str());
+    } else if (argument == "--tree-file") {
+      treeFilename = getNextArgument(argc, argv, i);
+    } else if (argument == "--output") {
+      outputFilename = getNextArgument(argc, argv, i);
+    } else if (argument == "--trace") {
+      traceFilename = getNextArgument(argc, argv, i);
+      Trace::enable();
+    } else {
+      std::cerr << "Unknown argument: " << argument << '\n';
+      return 1;
+    }
+  }
+  std::cout << std::fixed << std::setprecision(3);
+  const auto begin = std::chrono::steady_clock::now();
+  const auto snapshot = treeFilename.empty() ? growTree(targetMetamers, seed, growthParameters) : TreeSnapshot(TreeFile(treeFilename));
+  std::cout << (treeFilename.empty() ? "Growth: " : "Loading: ") << secondsSince(begin) << " s" << '\n';
+  Camera camera;
+  camera.frameBoundingBox(userSpecifiedBoundingBox.value_or(snapshot.boundingBox));
+  const auto renderBegin = std::chrono::steady_clock::now();
+  auto pixels = RayTracer(width, height, samplesPerSide, threads).render(snapshot, camera);
+  std::cout << "Rendering: " << secondsSince(renderBegin) << " s" << '\n';
+  {
+    TraceScope traceScope("Image::writeToFile", "io");
+    Image(pixels, width, height).writeToFile(outputFilename);
+  }
+  std::cout << "Tree bounding box: " << snapshot.boundingBox.toString() << '\n';
+  std::cout << "Metamers: " << snapshot.countMetamers() << '\n';
+  if (!traceFilename.empty()) {
+    Trace::writeChromeJson(traceFilename);
+  }
+  return 0;
+}
@@ -0,0 +1,154 @@
+#include <algorithm>
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <optional>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+
+#include "Camera.hpp"
+#include "FrameEncoder.hpp"
+#include "GrowthLogReader.hpp"
+#include "Image.hpp"
+#include "RayTracer.hpp"
+#include "Trace.hpp"
+#include "TreeSnapshot.hpp"
+#include "VideoSink.hpp"
+
+static constexpr double VideoFramesPerSecond = 30.0;
+
+static std::string getNextArgument(int argc, char *argv[], int &i) {
+  const auto option = std::string(argv[i]);
+  i++;
+  if (i >= argc) {
+    throw std::invalid_argument("Missing value for " + option + ".");
+  }
+  return std::string(argv[i]);
+}
+
+static float secondsSince(std::chrono::steady_clock::time_point begin) {
+  const std::chrono::duration<float> duration = std::chrono::steady_clock::now() - begin;
+  return duration.count();
+}
+
+static Point getNextPoint(int argc, char *argv[], int &i) {
+  const auto x = std::stof(getNextArgument(argc, argv, i));
+  const auto y = std::stof(getNextArgument(argc, argv, i));
+  const auto z = std::stof(getNextArgument(argc, argv, i));
+  return Point(x, y, z);
+}
+
+/**
+ * Renders the states of a tree from a growth log written by the headless simulation, without simulating anything.
+ *
+ * Each state is ray traced across all cores while previous frames are encoded in the background, so a new camera
+ * angle costs reading the log and rendering, not growing the tree again. By default, every state is written as a frame,
+ * with the camera framing it as the interactive application does. With --iteration, only one state is written.
+ */
+int main(int argc, char *argv[]) {
+  std::string growthLogFilename;
+  U32 width = 1024;
+  U32 height = 1024;
+  U32 samplesPerSide = RayTracer::DefaultSamplesPerSide;
+  U32 threads = std::max(1U, std::thread::hardware_concurrency());
+  std::optional<BoundingBox> userSpecifiedBoundingBox;
+  std::optional<Camera> userSpecifiedCamera;
+  std::optional<U64> onlyIteration;
+  std::string outputFilename = "image.png";
+  std::string videoFilename;
+  std::string traceFilename;
+  for (int i = 1; i < argc; i++) {
+    const auto argument = std::string(argv[i]);
+    if (argument == "--growth-log") {
+      growthLogFilename = getNextArgument(argc, argv, i);
+    } else if (argument == "--resolution") {
+      width = std::stoul(getNextArgument(argc, argv, i));
+      height = std::stoul(getNextArgument(argc, argv, i));
+    } else if (argument == "--samples") {
+      samplesPerSide = std::stoul(getNextArgument(argc, argv, i));
+    } else if (argument == "--threads") {
+      threads = std::stoul(getNextArgument(argc, argv, i));
+    } else if (argument == "--bounding-box") {
+      std::stringstream values;
+      for (int j = 0; j < 6; j++) {
+        if (j != 0) {
+          values << ' ';
+        }
+        values << getNextArgument(argc, argv, i);
+      }
+      userSpecifiedBoundingBox = BoundingBox(values.str());
+    } else if (argument == "--camera") {
+      Camera camera;
+      camera.position = getNextPoint(argc, argv, i);
+      camera.lookAtPosition = getNextPoint(argc, argv, i);
+      userSpecifiedCamera = camera;
+    } else if (argument == "--iteration") {
+      onlyIteration = std::stoull(getNextArgument(argc, argv, i));
+    } else if (argument == "--output") {
+      outputFilename = getNextArgument(argc, argv, i);
+    } else if (argument == "--video-file") {
+      videoFilename = getNextArgument(argc, argv, i);
+    } else if (argument == "--trace") {
+      traceFilename = getNextArgument(argc, argv, i);
+      Trace::enable();
+    } else {
+      std::cerr << "Unknown argument: " << argument << '\n';
+      return 1;
+    }
+  }
+  if (growthLogFilename.empty()) {
+    std::cerr << "Specify the growth log to replay with --growth-log." << '\n';
+    return 1;
+  }
+  std::cout << std::fixed << std::setprecision(3);
+  const auto begin = std::chrono::steady_clock::now();
+  GrowthLogReader reader(growthLogFilename);
+  const RayTracer rayTracer(width, height, samplesPerSide, threads);
+  std::unique_ptr<VideoSink> videoSink;
+  if (!videoFilename.empty() && !onlyIteration) {
+    videoSink = std::make_unique<VideoSink>(videoFilename, width, height, VideoFramesPerSecond);
+    std::cout << "Writing " << videoFilename << " with " << videoSink->getCodec() << '\n';
+  }
+  // Rendering already uses every core, so one worker is enough to encode in the background.
+  FrameEncoder frameEncoder(1, 2, videoSink.get());
+  U64 frameIndex = 0;
+  while (reader.readRecord()) {
+    if (onlyIteration && reader.iterations != onlyIteration.value()) {
+      continue;
+    }
+    const TreeSnapshot snapshot(reader.iterations, reader.instances);
+    Camera camera;
+    if (userSpecifiedCamera) {
+      camera = userSpecifiedCamera.value();
+    } else {
+      camera.frameBoundingBox(userSpecifiedBoundingBox.value_or(snapshot.boundingBox));
+    }
+    auto pixels = rayTracer.render(snapshot, camera);
+    if (onlyIteration) {
+      TraceScope traceScope("Image::writeToFile", "io");
+      Image(pixels, width, height).writeToFile(outputFilename);
+      std::cout << "Metamers: " << snapshot.countMetamers() << '\n';
+      frameIndex++;
+      break;
+    }
+    frameIndex++;
+    std::stringstream frameNumber;
+    frameNumber << std::setfill('0') << std::setw(5) << frameIndex;
+    // The ray tracer writes the top row first.
+    frameEncoder.submit(Frame{std::move(pixels), width, height, "video/frame-" + frameNumber.str() + ".png", false});
+    std::cout << "Iteration " << reader.iterations << ": " << snapshot.countMetamers() << " metamers" << '\n';
+  }
+  frameEncoder.finish();
+  if (onlyIteration && frameIndex == 0) {
+    std::cerr << "The growth log has no state after " << onlyIteration.value() << " iterations." << '\n';
+    return 1;
+  }
+  std::cout << "Frames: " << frameIndex << " in " << secondsSince(begin) << " s" << '\n';
+  if (!traceFilename.empty()) {
+    Trace::writeChromeJson(traceFilename);
+  }
+  return 0;
+}
@@ -0,0 +1,25 @@
+#pragma once
+
+#include <glad/glad.h>
+
+/**
+ * The locations of the camera, lighting, and color uniforms which the cylinder and the mesh programs share.
+ */
+class ShadingUniformLocations {
+public:
+  GLint viewMatrix = -1;
+  GLint projectionMatrix = -1;
+  GLint cameraPositionInWorld = -1;
+  GLint lightPositionInWorld = -1;
+  GLint ambientLightIntensity = -1;
+  GLint vertexColor = -1;
+
+  ShadingUniformLocations() = default;
+
+  explicit ShadingUniformLocations(GLuint program)
+      : viewMatrix(glGetUniformLocation(program, "viewMatrix")), projectionMatrix(glGetUniformLocation(program, "projectionMatrix")),
+        cameraPositionInWorld(glGetUniformLocation(program, "cameraPositionInWorld")),
+        lightPositionInWorld(glGetUniformLocation(program, "lightPositionInWorld")),
+        ambientLightIntensity(glGetUniformLocation(program, "ambientLightIntensity")), vertexColor(glGetUniformLocation(program, "vertexColor")) {
+  }
+};
@@ -0,0 +1,162 @@
+#include "ShadowGrid.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <stdexcept>
+
+#include "Trace.hpp"
+
+ShadowGrid::ShadowGrid(float sideLength, U64 resolution)
+    : xRange(-0.5f * sideLength, +0.5f * sideLength), yRange(0.0f, sideLength), zRange(-0.5f * sideLength, +0.5f * sideLength), resolution(resolution) {
+  if (sideLength <= 0.0f) {
+    throw std::domain_error("Side length cannot be <= 0.0f.");
+  }
+  if (resolution < 1) {
+    throw std::domain_error("Resolution must be at least 1.");
+  }
+  if (resolution > static_cast<U64>(std::numeric_limits<I32>::max())) {
+    throw std::domain_error("Resolution is too large.");
+  }
+  shadow.resize(resolution * resolution * resolution);
+}
+
+static bool findCell(Range range, U64 resolution, float value, I32 &cell) {
+  const auto step = range.getLength() / static_cast<float>(resolution);
+  const auto position = std::floor((value - range.minimum) / step);
+  if (!(position >= 0.0f && position < static_cast<float>(resolution))) {
+    return false;
+  }
+  cell = static_cast<I32>(position);
+  return true;
+}
+
+bool ShadowGrid::findVoxel(Point point, I32 &x, I32 &y, I32 &z) const {
+  return findCell(xRange, resolution, point.x, x) && findCell(yRange, resolution, point.y, y) && findCell(zRange, resolution, point.z, z);
+}
+
+bool ShadowGrid::isInside(I32 x, I32 y, I32 z) const {
+  const auto end = static_cast<I32>(resolution);
+  return x >= 0 && x < end && y >= 0 && y < end && z >= 0 && z < end;
+}
+
+U64 ShadowGrid::getIndex(I32 x, I32 y, I32 z) const {
+  return (static_cast<U64>(x) * resolution + static_cast<U64>(y)) * resolution + static_cast<U64>(z);
+}
+
+Point ShadowGrid::getCenter(I32 x, I32 y, I32 z) const {
+  const auto center = [this](Range range, I32 cell) {
+    return range.minimum + (static_cast<float>(cell) + 0.5f) * range.getLength() / static_cast<float>(resolution);
+  };
+  return Point(center(xRange, x), center(yRange, y), center(zRange, z));
+}
+
+float ShadowGrid::getShadow(Point point) const {
+  I32 x{};
+  I32 y{};
+  I32 z{};
+  if (!findVoxel(point, x, y, z)) {
+    return 0.0f;
+  }
+  return shadow[getIndex(x, y, z)];
+}
+
+void ShadowGrid::resetAllocations() {
+}
+
+void ShadowGrid::allocate(BudId, Point, Vector, float, float) {
+}
+
+float ShadowGrid::getLight(BudId, Point origin, Vector, float, float) const {
+  recordQuery(1);
+  return getExposure(origin);
+}
+
+float ShadowGrid::getExposure(Point origin) const {
+  I32 x{};
+  I32 y{};
+  I32 z{};
+  if (!findVoxel(origin, x, y, z)) {
+    return 0.0f;
+  }
+  // The bud does not shade itself, and buds which no metamer shades, such as those of the seedling, get full light.
+  return std::clamp(fullLight - shadow[getIndex(x, y, z)] + shadowIntensity, 0.0f, fullLight);
+}
+
+SpaceAnalysis ShadowGrid::analyze(BudId, Point origin, Vector direction, float theta, float) const {
+  TraceScope traceScope("ShadowGrid::analyze", "marker-query", Trace::shouldSample());
+  SpaceAnalysis spaceAnalysis{};
+  spaceAnalysis.q = getExposure(origin);
+  if (spaceAnalysis.q == 0.0f) {
+    recordQuery(1);
+    return spaceAnalysis;
+  }
+  I32 budX{};
+  I32 budY{};
+  I32 budZ{};
+  findVoxel(origin, budX, budY, budZ);
+  const auto cosTheta = std::cos(theta);
+  const auto normalizedDirection = direction.normalize();
+  auto leastShadow = std::numeric_limits<float>::infinity();
+  auto bestAlignment = -std::numeric_limits<float>::infinity();
+  U64 voxelsVisited = 1;
+  spaceAnalysis.v = normalizedDirection;
+  for (auto x = budX - 1; x <= budX + 1; x++) {
+    for (auto y = budY - 1; y <= budY + 1; y++) {
+      for (auto z = budZ - 1; z <= budZ + 1; z++) {
+        if (!isInside(x, y, z) || (x == budX && y == budY && z == budZ)) {
+          continue;
+        }
+        voxelsVisited++;
+        const auto toVoxel = Vector(origin, getCenter(x, y, z));
+        const auto distance = toVoxel.evaluateNorm();
+        if (distance == 0.0f) {
+          continue;
+        }
+        const auto alignment = toVoxel.dot(normalizedDirection) / distance;
+        if (alignment <= cosTheta) {
+          continue;
+        }
+        const auto voxelShadow = shadow[getIndex(x, y, z)];
+        if (voxelShadow < leastShadow || (voxelShadow == leastShadow && alignment > bestAlignment)) {
+          leastShadow = voxelShadow;
+          bestAlignment = alignment;
+          spaceAnalysis.v = toVoxel.scale(1.0f / distance);
+        }
+      }
+    }
+  }
+  recordQuery(voxelsVisited);
+  return spaceAnalysis;
+}
+
+void ShadowGrid::occupy(Point center, float) {
+  TraceScope traceScope("ShadowGrid::occupy", "marker-query", Trace::shouldSample());
+  I32 budX{};
+  I32 budY{};
+  I32 budZ{};
+  if (!findVoxel(center, budX, budY, budZ)) {
+    recordQuery(0);
+    return;
+  }
+  U64 voxelsVisited = 0;
+  auto delta = shadowIntensity;
+  for (I32 q = 0; q <= static_cast<I32>(pyramidDepth) && budY - q >= 0; q++) {
+    const auto y = budY - q;
+    for (auto x = std::max(budX - q, 0); x <= std::min(budX + q, static_cast<I32>(resolution) - 1); x++) {
+      for (auto z = std::max(budZ - q, 0); z <= std::min(budZ + q, static_cast<I32>(resolution) - 1); z++) {
+        shadow[getIndex(x, y, z)] += delta;
+        voxelsVisited++;
+      }
+    }
+    delta /= shadowAttenuation;
+  }
+  recordQuery(voxelsVisited);
+}
+
+void ShadowGrid::recordQuery(U64 voxelsVisited) const {
+  if (statistics) {
+    statistics->queries++;
+    statistics->cellsVisited += voxelsVisited;
+  }
+}
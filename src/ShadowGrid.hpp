@@ -0,0 +1,92 @@
+#pragma once
+
+#include <vector>
+
+#include "EnvironmentModel.hpp"
+#include "Point.hpp"
+#include "Range.hpp"
+#include "SpaceAnalysis.hpp"
+#include "Types.hpp"
+#include "Vector.hpp"
+
+/**
+ * Computes the environment of buds by shadow propagation, the second model of the paper.
+ *
+ * Space is split into cubic voxels holding shadow values. Every new metamer casts a pyramid of shadow below its end:
+ * the (2q + 1) x (2q + 1) voxels centered q voxels lower receive a * b^-q, for q from 0 to the depth of the pyramid.
+ * The light exposure of a bud is then read from its voxel as Q = max(C - s + a, 0), and its optimal growth direction
+ * points to the least shadowed voxel next to it in its perception cone. As shadow already accounts for the neighbors of
+ * a bud, buds allocate nothing. Buds outside of the grid get no light, as they would find no markers outside of a
+ * marker set.
+ */
+class ShadowGrid : public EnvironmentModel {
+  // Indexed as (x * resolution + y) * resolution + z.
+  std::vector<F32> shadow;
+
+public:
+  Range xRange;
+  Range yRange;
+  Range zRange;
+
+  U64 resolution;
+
+  // The full light exposure C.
+  float fullLight = 1.0f;
+  // The shadow a which a metamer casts on its own voxel.
+  float shadowIntensity = 0.2f;
+  // The base b by which shadow weakens with every voxel below the metamer.
+  float shadowAttenuation = 1.5f;
+  // The number of voxels below the metamer which receive its shadow.
+  U64 pyramidDepth = 8;
+
+  /**
+   * Creates a grid without shadow over the same box as a generated marker set, split into resolution voxels along each
+   * axis.
+   */
+  ShadowGrid(float sideLength, U64 resolution);
+
+  /**
+   * Returns the shadow of the voxel which contains the point, or 0 if the point is outside of the grid.
+   */
+  float getShadow(Point point) const;
+
+  void resetAllocations() override;
+
+  void allocate(BudId budId, Point origin, Vector direction, float theta, float r) override;
+
+  /**
+   * Looks up the voxel of the bud, so its cost does not depend on the size of the tree.
+   */
+  float getLight(BudId budId, Point origin, Vector direction, float theta, float r) const override;
+
+  /**
+   * Also looks for the least shadowed of the voxels next to that of the bud which are within the perception angle, so its
+   * cost does not depend on the size of the tree either. Ties go to the voxel closest to the direction of the bud. As
+   * voxels are about as long as metamers, these are the voxels the next metamer can reach, and r is not used.
+   */
+  SpaceAnalysis analyze(BudId budId, Point origin, Vector direction, float theta, float r) const override;
+
+  /**
+   * Adds the shadow pyramid of the metamer. The radius is not used, as the pyramid sets the extent of the shadow.
+   */
+  void occupy(Point center, float radius) override;
+
+private:
+  /**
+   * Returns the light exposure Q at the point.
+   */
+  float getExposure(Point point) const;
+
+  /**
+   * Finds the voxel of the point, returning false if it is outside of the grid.
+   */
+  bool findVoxel(Point point, I32 &x, I32 &y, I32 &z) const;
+
+  bool isInside(I32 x, I32 y, I32 z) const;
+
+  U64 getIndex(I32 x, I32 y, I32 z) const;
+
+  Point getCenter(I32 x, I32 y, I32 z) const;
+
+  void recordQuery(U64 voxelsVisited) const;
+};
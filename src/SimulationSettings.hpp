@@ -0,0 +1,12 @@
+#pragma once
+
+#include "GrowthParameters.hpp"
+#include "MarkerField.hpp"
+#include "Types.hpp"
+
+class SimulationSettings {
+public:
+  MarkerFieldSettings markerField{};
+  GrowthParameters growthParameters{};
+  U64 targetMetamers = 5 * 1000;
+};
@@ -0,0 +1,101 @@
+#include "SimulationThread.hpp"
+
+#include "Trace.hpp"
+
+SimulationThread::SimulationThread(Tree &tree, U64 targetMetamers, bool includeTubeMeshes, bool keepEverySnapshot)
+    : tree(tree), targetMetamers(targetMetamers), includeTubeMeshes(includeTubeMeshes), keepEverySnapshot(keepEverySnapshot) {
+  publish();
+  thread = std::thread(&SimulationThread::run, this);
+}
+
+SimulationThread::~SimulationThread() {
+  stopThread();
+}
+
+void SimulationThread::stopThread() {
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    stopping = true;
+  }
+  snapshotTaken.notify_all();
+  if (thread.joinable()) {
+    thread.join();
+  }
+}
+
+void SimulationThread::run() {
+  try {
+    while (tree.countMetamers() < targetMetamers) {
+      {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (stopping) {
+          break;
+        }
+      }
+      tree.performGrowthIteration();
+      publish();
+    }
+  } catch (...) {
+    std::lock_guard<std::mutex> lock(mutex);
+    error = std::current_exception();
+  }
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    finished = true;
+  }
+  snapshotPublished.notify_all();
+}
+
+/**
+ * Makes a snapshot of the tree, outside the lock, and hands it over to the render thread.
+ */
+void SimulationThread::publish() {
+  lastSnapshot = std::make_shared<const TreeSnapshot>(tree, lastSnapshot.get(), includeTubeMeshes);
+  {
+    std::unique_lock<std::mutex> lock(mutex);
+    if (keepEverySnapshot) {
+      TraceScope traceScope("SimulationThread::waitForRendering", "simulation");
+      snapshotTaken.wait(lock, [this]() { return stopping || snapshots.size() < KeptSnapshotCapacity; });
+    } else {
+      snapshots.clear();
+    }
+    snapshots.push_back(lastSnapshot);
+  }
+  snapshotPublished.notify_all();
+}
+
+std::shared_ptr<const TreeSnapshot> SimulationThread::takeSnapshot() {
+  std::shared_ptr<const TreeSnapshot> snapshot;
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (snapshots.empty()) {
+      return nullptr;
+    }
+    snapshot = std::move(snapshots.front());
+    snapshots.pop_front();
+  }
+  snapshotTaken.notify_all();
+  return snapshot;
+}
+
+std::shared_ptr<const TreeSnapshot> SimulationThread::waitForSnapshot() {
+  std::shared_ptr<const TreeSnapshot> snapshot;
+  {
+    std::unique_lock<std::mutex> lock(mutex);
+    snapshotPublished.wait(lock, [this]() { return finished || !snapshots.empty(); });
+    if (snapshots.empty()) {
+      return nullptr;
+    }
+    snapshot = std::move(snapshots.front());
+    snapshots.pop_front();
+  }
+  snapshotTaken.notify_all();
+  return snapshot;
+}
+
+void SimulationThread::stop() {
+  stopThread();
+  if (error) {
+    std::rethrow_exception(error);
+  }
+}
@@ -0,0 +1,73 @@
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+#include "Tree.hpp"
+#include "TreeSnapshot.hpp"
+#include "Types.hpp"
+
+/**
+ * Grows a tree on its own thread, publishing a snapshot of it after every growth iteration.
+ *
+ * The tree belongs to the simulation thread until it is stopped, and renderers only draw the snapshots. If every
+ * snapshot is kept, at most two wait to be taken and growth blocks until one is, otherwise only the latest is kept and
+ * growth never waits for rendering.
+ */
+class SimulationThread {
+  static constexpr U64 KeptSnapshotCapacity = 2;
+
+  Tree &tree;
+  const U64 targetMetamers;
+  const bool includeTubeMeshes;
+  const bool keepEverySnapshot;
+  std::shared_ptr<const TreeSnapshot> lastSnapshot;
+  std::deque<std::shared_ptr<const TreeSnapshot>> snapshots;
+  bool stopping = false;
+  bool finished = false;
+  std::exception_ptr error;
+  std::mutex mutex;
+  std::condition_variable snapshotPublished;
+  std::condition_variable snapshotTaken;
+  std::thread thread;
+
+  void run();
+
+  void publish();
+
+  // Lets the current growth iteration finish and waits for the thread.
+  void stopThread();
+
+public:
+  /**
+   * Publishes a snapshot of the tree as it is and starts growing it until it has the target number of metamers.
+   */
+  SimulationThread(Tree &tree, U64 targetMetamers, bool includeTubeMeshes, bool keepEverySnapshot);
+
+  SimulationThread(const SimulationThread &) = delete;
+
+  SimulationThread &operator=(const SimulationThread &) = delete;
+
+  ~SimulationThread();
+
+  /**
+   * Returns the oldest snapshot which was not taken yet, or null if there is none, without waiting.
+   */
+  std::shared_ptr<const TreeSnapshot> takeSnapshot();
+
+  /**
+   * Returns the oldest snapshot which was not taken yet, waiting for it if needed, or null once growth finished.
+   */
+  std::shared_ptr<const TreeSnapshot> waitForSnapshot();
+
+  /**
+   * Stops growth after the current iteration and waits for the thread, rethrowing its error if it had one.
+   *
+   * Afterwards, the tree can be used again by the caller.
+   */
+  void stop();
+};
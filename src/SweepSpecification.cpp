@@ -0,0 +1,70 @@
+#include "SweepSpecification.hpp"
+
+#include <algorithm>
+#include <sstream>
+#include <stdexcept>
+
+#include "Text.hpp"
+
+static void applySetting(SimulationSettings &simulationSettings, const std::string &name, const std::string &value) {
+  if (name == "seed") {
+    simulationSettings.markerField.seed = std::stoull(value);
+  } else if (name == "side-length") {
+    simulationSettings.markerField.sideLength = std::stof(value);
+  } else if (name == "resolution") {
+    simulationSettings.markerField.resolution = std::stoull(value);
+  } else if (name == "markers") {
+    simulationSettings.markerField.markerCount = std::stoull(value);
+  } else if (name == "metamers") {
+    simulationSettings.targetMetamers = std::stoull(value);
+  } else {
+    simulationSettings.growthParameters.set(name, std::stof(value));
+  }
+}
+
+SweepSpecification SweepSpecification::fromFile(const std::string &filename) {
+  return SweepSpecification(readFileContent(filename));
+}
+
+SweepSpecification::SweepSpecification(const std::string &text) {
+  std::stringstream textStream(text);
+  std::string line;
+  while (std::getline(textStream, line)) {
+    std::stringstream lineStream(line);
+    std::string name;
+    if (!(lineStream >> name) || name[0] == '#') {
+      continue;
+    }
+    std::vector<std::string> values;
+    std::string value;
+    while (lineStream >> value) {
+      values.push_back(value);
+    }
+    if (values.empty()) {
+      throw std::invalid_argument("No values for " + name + ".");
+    }
+    // Validate the name and the values early, before any simulation runs.
+    SimulationSettings simulationSettings;
+    for (const auto &v : values) {
+      applySetting(simulationSettings, name, v);
+    }
+    settings.emplace_back(name, values);
+  }
+}
+
+std::vector<SimulationSettings> SweepSpecification::expand() const {
+  std::vector<SimulationSettings> simulations(1);
+  for (const auto &[name, values] : settings) {
+    std::vector<SimulationSettings> expanded;
+    for (const auto &simulation : simulations) {
+      for (const auto &value : values) {
+        expanded.push_back(simulation);
+        applySetting(expanded.back(), name, value);
+      }
+    }
+    simulations = std::move(expanded);
+  }
+  const auto compare = [](const SimulationSettings &a, const SimulationSettings &b) { return a.markerField < b.markerField; };
+  std::stable_sort(std::begin(simulations), std::end(simulations), compare);
+  return simulations;
+}
@@ -0,0 +1,36 @@
+#pragma once
+
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "SimulationSettings.hpp"
+
+/**
+ * A parameter sweep, read from a text file.
+ *
+ * Each non-empty line which does not start with '#' is a setting name followed by one or more values. The simulations
+ * of the sweep are the Cartesian product of all listed values. For example,
+ *
+ *   seed 1 2 3 4
+ *   metamers 20000
+ *   perception-radius-factor 3 4 5
+ *
+ * describes twelve simulations. Besides the growth parameter names, the settings "seed", "side-length", "resolution",
+ * "markers", and "metamers" are accepted.
+ */
+class SweepSpecification {
+  std::vector<std::pair<std::string, std::vector<std::string>>> settings;
+
+public:
+  static SweepSpecification fromFile(const std::string &filename);
+
+  explicit SweepSpecification(const std::string &text);
+
+  /**
+   * Expands the sweep into all of its simulations.
+   *
+   * Simulations which share a marker field are adjacent in the result.
+   */
+  std::vector<SimulationSettings> expand() const;
+};
@@ -0,0 +1,112 @@
+#include "Trace.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <vector>
+
+class TraceBuffer {
+public:
+  U64 threadIndex{};
+  std::vector<TraceEvent> events;
+  // Written only by the owning thread, read by the thread writing the trace.
+  std::atomic<U64> recordedEvents{0};
+};
+
+static std::atomic<bool> traceEnabled{false};
+static std::atomic<U64> traceEventsPerThread{Trace::DefaultEventsPerThread};
+
+static const auto traceEpoch = std::chrono::steady_clock::now();
+
+// Only locked when a thread records its first event and when the trace is written.
+static std::mutex traceBuffersMutex;
+static std::vector<std::unique_ptr<TraceBuffer>> traceBuffers;
+
+static thread_local TraceBuffer *threadTraceBuffer = nullptr;
+static thread_local U64 threadSampleCounter = 0;
+
+void Trace::enable(U64 eventsPerThread) {
+  if (eventsPerThread == 0) {
+    throw std::domain_error("Trace buffers must hold at least one event.");
+  }
+  traceEventsPerThread = eventsPerThread;
+  traceEnabled = true;
+}
+
+bool Trace::isEnabled() {
+  return traceEnabled.load(std::memory_order_relaxed);
+}
+
+bool Trace::shouldSample() {
+  if (!isEnabled()) {
+    return false;
+  }
+  return threadSampleCounter++ % SamplingInterval == 0;
+}
+
+U64 Trace::now() {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - traceEpoch).count();
+}
+
+static TraceBuffer &getThreadTraceBuffer() {
+  if (!threadTraceBuffer) {
+    std::lock_guard<std::mutex> lock(traceBuffersMutex);
+    traceBuffers.push_back(std::make_unique<TraceBuffer>());
+    threadTraceBuffer = traceBuffers.back().get();
+    threadTraceBuffer->threadIndex = traceBuffers.size();
+    threadTraceBuffer->events.resize(traceEventsPerThread);
+  }
+  return *threadTraceBuffer;
+}
+
+void Trace::record(const char *name, const char *category, U64 begin, U64 end) {
+  auto &buffer = getThreadTraceBuffer();
+  const auto index = buffer.recordedEvents.load(std::memory_order_relaxed);
+  buffer.events[index % buffer.events.size()] = TraceEvent{name, category, begin, end - begin};
+  buffer.recordedEvents.store(index + 1, std::memory_order_release);
+}
+
+void Trace::writeChromeJson(const std::string &filename) {
+  std::ofstream stream(filename);
+  if (stream.fail()) {
+    throw std::runtime_error("Could not open " + filename + ".");
+  }
+  stream << std::fixed;
+  stream.precision(3);
+  stream << "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [";
+  auto first = true;
+  std::lock_guard<std::mutex> lock(traceBuffersMutex);
+  for (const auto &buffer : traceBuffers) {
+    stream << (first ? "\n" : ",\n");
+    first = false;
+    stream << "{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 1, \"tid\": " << buffer->threadIndex;
+    stream << ", \"args\": {\"name\": \"Thread " << buffer->threadIndex << "\"}}";
+    const auto recordedEvents = buffer->recordedEvents.load(std::memory_order_acquire);
+    const auto capacity = static_cast<U64>(buffer->events.size());
+    const auto oldestEvent = recordedEvents > capacity ? recordedEvents - capacity : 0;
+    for (auto i = oldestEvent; i < recordedEvents; i++) {
+      const auto &event = buffer->events[i % capacity];
+      stream << ",\n{\"name\": \"" << event.name << "\", \"cat\": \"" << event.category << "\", \"ph\": \"X\", \"pid\": 1";
+      stream << ", \"tid\": " << buffer->threadIndex << ", \"ts\": " << event.begin / 1000.0 << ", \"dur\": " << event.duration / 1000.0 << "}";
+    }
+  }
+  stream << "\n]}\n";
+}
+
+TraceScope::TraceScope(const char *name, const char *category) : TraceScope(name, category, Trace::isEnabled()) {
+}
+
+TraceScope::TraceScope(const char *name, const char *category, bool active) : name(name), category(category), active(active) {
+  if (active) {
+    begin = Trace::now();
+  }
+}
+
+TraceScope::~TraceScope() {
+  if (active) {
+    Trace::record(name, category, begin, Trace::now());
+  }
+}
@@ -0,0 +1,79 @@
+#pragma once
+
+#include <string>
+
+#include "Types.hpp"
+
+class TraceEvent {
+public:
+  const char *name = nullptr;
+  const char *category = nullptr;
+  // In nanoseconds since the trace epoch.
+  U64 begin{};
+  U64 duration{};
+};
+
+/**
+ * Records timed events into per-thread ring buffers and writes them in the Chrome trace event format.
+ *
+ * Each thread only ever writes to its own buffer, so recording an event takes no locks. Once a buffer is full, the
+ * oldest events of that thread are overwritten. The resulting file can be opened by chrome://tracing or Perfetto.
+ *
+ * Tracing is disabled by default, in which case a scope costs a single atomic load.
+ */
+class Trace {
+public:
+  static constexpr U64 DefaultEventsPerThread = 1 << 16;
+
+  // Only one in this many sampled events is recorded.
+  static constexpr U64 SamplingInterval = 64;
+
+  /**
+   * Enables tracing. Buffers of threads which already recorded events keep their size.
+   */
+  static void enable(U64 eventsPerThread = DefaultEventsPerThread);
+
+  static bool isEnabled();
+
+  /**
+   * Returns whether a frequent event, such as a marker query, should be recorded by the calling thread.
+   */
+  static bool shouldSample();
+
+  /**
+   * Returns the number of nanoseconds since the trace epoch.
+   */
+  static U64 now();
+
+  static void record(const char *name, const char *category, U64 begin, U64 end);
+
+  /**
+   * Writes the events of all threads to a file.
+   *
+   * Events recorded while the file is being written may or may not be included.
+   */
+  static void writeChromeJson(const std::string &filename);
+};
+
+/**
+ * Records an event spanning the lifetime of this object.
+ *
+ * The name and the category must be string literals, as only the pointers are stored.
+ */
+class TraceScope {
+  const char *name;
+  const char *category;
+  bool active;
+  U64 begin{};
+
+public:
+  TraceScope(const char *name, const char *category);
+
+  TraceScope(const char *name, const char *category, bool active);
+
+  TraceScope(const TraceScope &) = delete;
+
+  TraceScope &operator=(const TraceScope &) = delete;
+
+  ~TraceScope();
+};
@@ -1,57 +1,113 @@
 #include "Tree.hpp"
 #include "BoundingBox.hpp"
+#include "GrowthLogWriter.hpp"
+#include "Trace.hpp"
 
+#include <atomic>
+#include <chrono>
 #include <iostream>
 
 static constexpr float PipeModelExponent = 2.0f;
 static constexpr float PipeModelLeafValue = 1.0e-8f;
 
-Tree::Tree(Environment &environment, Point seedlingPosition) : environment(environment) {
+static std::atomic<U64> nextTreeId{1};
+
+Tree::Tree(Environment &environment, Point seedlingPosition) : id(nextTreeId++), environment(environment) {
   const auto end = seedlingPosition.translate(0.0f, 1.0f * Environment::MetamerBaseLength, 0.0f);
   root = std::make_unique<Metamer>(environment, seedlingPosition, end);
+  addMetamer(*root);
 }
 
 U64 Tree::countMetamers() const {
-  if (!root) {
-    return 0;
-  }
-  return root->countMetamers();
+  return metamers.size();
+}
+
+void Tree::addMetamer(Metamer &metamer) {
+  metamer.index = metamers.size();
+  metamers.push_back(&metamer);
 }
 
 BoundingBox Tree::getBoundingBox() const {
   return root->getBoundingBox();
 }
 
+/**
+ * Runs a phase of a growth iteration, accounting its wall time and environment work if statistics are being collected.
+ *
+ * The phase is traced unless its name is null.
+ */
+template <typename Function>
+static void runPhase(const char *name, bool collect, EnvironmentModel &model, GrowthPhaseStatistics &phase, Function function) {
+  TraceScope traceScope(name, "growth", name != nullptr && Trace::isEnabled());
+  if (!collect) {
+    function();
+    return;
+  }
+  model.statistics = &phase.markerSet;
+  const auto begin = std::chrono::steady_clock::now();
+  function();
+  const std::chrono::duration<F64> duration = std::chrono::steady_clock::now() - begin;
+  phase.seconds += duration.count();
+  model.statistics = nullptr;
+}
+
 void Tree::performGrowthIteration() {
+  TraceScope traceScope("Tree::performGrowthIteration", "growth");
+  const auto collect = isCollectingStatistics();
+  auto &model = environment.getModel();
+  iterations++;
+  const auto previousMetamers = countMetamers();
+  widthChanges.clear();
+  statistics = GrowthStatistics{};
+  statistics.iteration = iterations;
   // 1. Calculate local environment of all tree buds.
-  environment.markerSet.resetAllocations();
-  allocateMarkers(root);
+  runPhase("Tree::allocateMarkers", collect, model, statistics.allocation, [this, &model]() {
+    model.resetAllocations();
+    allocateMarkers(root);
+  });
   // 2. Determine the fate of each bud (the extended Borchert-Honda model).
-  propagateLightBasipetally(root);
-  root->growthResource = Environment::BorchertHondaAlpha * root->light;
-  propagateResourcesAcropetally(root);
+  runPhase("Tree::propagateLightBasipetally", collect, model, statistics.lightPropagation, [this]() { propagateLightBasipetally(root); });
+  runPhase("Tree::propagateResourcesAcropetally", collect, model, statistics.resourcePropagation, [this]() {
+    root->growthResource = environment.parameters.borchertHondaAlpha * root->light;
+    propagateResourcesAcropetally(root);
+  });
   // 3. Append new shoots.
-  performGrowthIteration(root);
+  runPhase("Tree::appendNewShoots", collect, model, statistics.shootCreation, [this]() { performGrowthIteration(root); });
+  // Occupation, which removes markers or casts shadow, happened during shoot creation, but is accounted separately.
+  statistics.shootCreation.seconds -= statistics.markerRemoval.seconds;
   // 4. Shed branches (not implemented).
   // 5. Update internode width for all internodes.
-  updateInternodeWidths(root);
+  runPhase("Tree::updateInternodeWidths", collect, model, statistics.widthUpdate, [this, previousMetamers]() { updateInternodeWidths(root, previousMetamers); });
   tropismGrowthDirectionWeight *= TropismGrowthDirectionWeightAttenuation;
+  if (collect) {
+    statistics.metamers = countMetamers();
+  }
+  if (statisticsStream) {
+    *statisticsStream << statistics.toJson() << '\n';
+  }
+  if (growthLog) {
+    growthLog->append(*this);
+  }
+}
+
+bool Tree::isCollectingStatistics() const {
+  return collectStatistics || statisticsStream != nullptr;
 }
 
 void Tree::allocateMarkers(std::unique_ptr<Metamer> &metamer) {
   if (!metamer) {
     return;
   }
-  const auto theta = Environment::PerceptionAngle;
-  const auto r = Environment::PerceptionRadiusFactor * metamer->getLength();
+  const auto theta = environment.parameters.perceptionAngle;
+  const auto r = environment.parameters.perceptionRadiusFactor * metamer->getLength();
   if (!metamer->axillary) {
-    environment.markerSet.updateAllocatedInCone(metamer->axillaryId, metamer->end, metamer->axillaryDirection, theta, r);
+    environment.getModel().allocate(metamer->axillaryId, metamer->end, metamer->axillaryDirection, theta, r);
   } else {
     allocateMarkers(metamer->axillary);
   }
   if (!metamer->terminal) {
     const auto direction = Vector(metamer->beginning, metamer->end);
-    environment.markerSet.updateAllocatedInCone(metamer->terminalId, metamer->end, direction, theta, r);
+    environment.getModel().allocate(metamer->terminalId, metamer->end, direction, theta, r);
   } else {
     allocateMarkers(metamer->terminal);
   }
@@ -63,19 +119,19 @@ void Tree::propagateLightBasipetally(std::unique_ptr<Metamer> &metamer) {
   }
   propagateLightBasipetally(metamer->axillary);
   propagateLightBasipetally(metamer->terminal);
-  const auto theta = Environment::PerceptionAngle;
-  const auto r = Environment::PerceptionRadiusFactor * metamer->getLength();
+  const auto theta = environment.parameters.perceptionAngle;
+  const auto r = environment.parameters.perceptionRadiusFactor * metamer->getLength();
   metamer->light = 0.0f;
   if (!metamer->axillary) {
     const auto budId = metamer->axillaryId;
-    metamer->axillaryLight = environment.markerSet.getAllocatedInCone(budId, metamer->end, metamer->axillaryDirection, theta, r).q;
+    metamer->axillaryLight = environment.getModel().getLight(budId, metamer->end, metamer->axillaryDirection, theta, r);
   } else {
     metamer->axillaryLight = metamer->axillary->light;
   }
   if (!metamer->terminal) {
     const auto direction = Vector(metamer->beginning, metamer->end);
     const auto budId = metamer->terminalId;
-    metamer->terminalLight = environment.markerSet.getAllocatedInCone(budId, metamer->end, direction, theta, r).q;
+    metamer->terminalLight = environment.getModel().getLight(budId, metamer->end, direction, theta, r);
   } else {
     metamer->terminalLight = metamer->terminal->light;
   }
@@ -93,7 +149,7 @@ void Tree::propagateResourcesAcropetally(std::unique_ptr<Metamer> &metamer) {
     return;
   }
   const auto v = metamer->growthResource;
-  const auto lambda = Environment::BorchertHondaLambda;
+  const auto lambda = environment.parameters.borchertHondaLambda;
   const auto denominator = lambda * qM + (1.0f - lambda) * qL;
   const auto vM = v * (lambda * qM) / denominator;
   const auto vL = v * ((1.0f - lambda) * qL) / denominator;
@@ -132,15 +188,16 @@ void Tree::performGrowthIteration(std::unique_ptr<Metamer> &metamer) {
 }
 
 std::unique_ptr<Metamer> Tree::addNewShoot(BudId budId, float supportingMetamerLength, Point origin, Vector direction, float resource) {
-  const auto theta = Environment::PerceptionAngle;
-  const auto r = Environment::PerceptionRadiusFactor * supportingMetamerLength;
-  const auto spaceAnalysis = environment.markerSet.getAllocatedInCone(budId, origin, direction, theta, r);
+  const auto theta = environment.parameters.perceptionAngle;
+  const auto r = environment.parameters.perceptionRadiusFactor * supportingMetamerLength;
+  const auto spaceAnalysis = environment.getModel().analyze(budId, origin, direction, theta, r);
   if (spaceAnalysis.q == 0.0f) {
     return nullptr;
   }
   if (std::floor(resource) == 0.0f) {
     return nullptr;
   }
+  statistics.shootsCreated++;
   std::unique_ptr<Metamer> headMetamer;
   std::unique_ptr<Metamer> *nextMetamer = &headMetamer;
   auto metamerEnd = origin;
@@ -149,31 +206,50 @@ std::unique_ptr<Metamer> Tree::addNewShoot(BudId budId, float supportingMetamerL
   const auto tropismDirection = Vector(0.0f, 1.0f, 0.0f).normalize();
   const auto metamerLength = resource / static_cast<int>(std::floor(resource)) * Environment::MetamerBaseLength;
   for (auto metamers = static_cast<int>(std::floor(resource)); metamers > 0; metamers--) {
-    metamerDirection = metamerDirection.add(optimalGrowthDirection.scale(Environment::OptimalGrowthDirectionWeight));
+    metamerDirection = metamerDirection.add(optimalGrowthDirection.scale(environment.parameters.optimalGrowthDirectionWeight));
     metamerDirection = metamerDirection.add(tropismDirection.scale(tropismGrowthDirectionWeight));
     metamerDirection = metamerDirection.normalize();
     const auto metamerVector = metamerDirection.scale(metamerLength);
     const auto previousMetamerEnd = metamerEnd;
     metamerEnd = metamerEnd.translate(metamerVector.x, metamerVector.y, metamerVector.z);
-    environment.markerSet.removeMarkersInSphere(metamerEnd, Environment::OccupancyRadiusFactor * metamerLength);
+    occupy(metamerEnd, environment.parameters.occupancyRadiusFactor * metamerLength);
     *nextMetamer = std::make_unique<Metamer>(environment, previousMetamerEnd, metamerEnd);
+    addMetamer(**nextMetamer);
+    statistics.metamersCreated++;
     nextMetamer = &(*nextMetamer)->terminal;
   }
   return headMetamer;
 }
 
-void Tree::updateInternodeWidths(std::unique_ptr<Metamer> &metamer) {
+void Tree::occupy(Point center, float radius) {
+  auto &model = environment.getModel();
+  if (!isCollectingStatistics()) {
+    model.occupy(center, radius);
+    return;
+  }
+  const auto shootCreationStatistics = model.statistics;
+  // Occupations are too frequent to trace individually, the models sample them instead.
+  runPhase(nullptr, true, model, statistics.markerRemoval, [&]() { model.occupy(center, radius); });
+  model.statistics = shootCreationStatistics;
+}
+
+void Tree::updateInternodeWidths(std::unique_ptr<Metamer> &metamer, U64 previousMetamers) {
   if (!metamer) {
     return;
   }
   auto total = PipeModelLeafValue;
-  updateInternodeWidths(metamer->axillary);
+  updateInternodeWidths(metamer->axillary, previousMetamers);
   if (metamer->axillary) {
     total += std::pow(metamer->axillary->width, PipeModelExponent);
   }
-  updateInternodeWidths(metamer->terminal);
+  updateInternodeWidths(metamer->terminal, previousMetamers);
   if (metamer->terminal) {
     total += std::pow(metamer->terminal->width, PipeModelExponent);
   }
-  metamer->width = std::pow(total, 1.0f / PipeModelExponent);
+  const auto width = std::pow(total, 1.0f / PipeModelExponent);
+  // Metamers created by this iteration are new in their entirety, so their widths are not reported as changes.
+  if (width != metamer->width && metamer->index < previousMetamers) {
+    widthChanges.push_back(metamer->index);
+  }
+  metamer->width = width;
 }
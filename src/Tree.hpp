@@ -1,22 +1,50 @@
 #pragma once
 
 #include <memory>
+#include <ostream>
+#include <vector>
 
 #include "BoundingBox.hpp"
 #include "Environment.hpp"
+#include "GrowthStatistics.hpp"
 #include "Metamer.hpp"
 #include "Point.hpp"
 #include "Types.hpp"
 
+class GrowthLogWriter;
+
 static constexpr float TropismGrowthDirectionWeightAttenuation = 0.95f;
 
 class Tree {
 public:
+  // Unique among all trees created by this process, so that renderers can tell trees apart.
+  const U64 id;
+
   std::unique_ptr<Metamer> root;
   Environment &environment;
 
+  // All metamers in creation order. As branches are never shed, this only ever grows.
+  std::vector<Metamer *> metamers;
+
+  // The indices of the metamers which existed before the last growth iteration and had their width changed by it.
+  std::vector<U64> widthChanges;
+
   float tropismGrowthDirectionWeight = 0.5f;
 
+  U64 iterations = 0;
+
+  // If true, the statistics of every growth iteration are collected.
+  bool collectStatistics = false;
+
+  // If not null, the statistics of every growth iteration are collected and written to this stream as one JSON object per line.
+  std::ostream *statisticsStream = nullptr;
+
+  // If not null, the metamers and width changes of every growth iteration are appended to this log.
+  GrowthLogWriter *growthLog = nullptr;
+
+  // The statistics of the last growth iteration, if they were collected.
+  GrowthStatistics statistics{};
+
   Tree(Environment &environment, Point seedlingPosition);
 
   U64 countMetamers() const;
@@ -35,15 +63,24 @@ public:
   void performGrowthIteration();
 
 private:
+  // Allows the benchmarks to time each pass of a growth iteration in isolation.
+  friend class TreeBenchmark;
+
   void allocateMarkers(std::unique_ptr<Metamer> &metamer);
 
   void propagateLightBasipetally(std::unique_ptr<Metamer> &metamer);
 
-  static void propagateResourcesAcropetally(std::unique_ptr<Metamer> &metamer);
+  void propagateResourcesAcropetally(std::unique_ptr<Metamer> &metamer);
 
   void performGrowthIteration(std::unique_ptr<Metamer> &metamer);
 
   std::unique_ptr<Metamer> addNewShoot(BudId budId, float supportingMetamerLength, Point origin, Vector direction, float resource);
 
-  static void updateInternodeWidths(std::unique_ptr<Metamer> &metamer);
+  void occupy(Point center, float radius);
+
+  bool isCollectingStatistics() const;
+
+  void updateInternodeWidths(std::unique_ptr<Metamer> &metamer, U64 previousMetamers);
+
+  void addMetamer(Metamer &metamer);
 };
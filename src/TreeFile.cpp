@@ -0,0 +1,191 @@
+#include "TreeFile.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <limits>
+#include <stdexcept>
+#include <type_traits>
+
+#include "Trace.hpp"
+
+static constexpr char TreeFileMagic[8] = {'S', 'O', 'T', 'M', 'T', 'R', 'E', 'E'};
+static constexpr U32 TreeFileVersion = 1;
+
+// Ends are quantized relative to the decoded end of their parent, which is within half a step of the true end, so the
+// deltas may exceed the longest metamer by a step. The range leaves room for that.
+static constexpr float LargestDelta = 32000.0f;
+
+// Width code zero stands for no width, so logarithmic codes start at one.
+static constexpr U32 LargestWidthCode = 65535;
+
+/**
+ * The beginning of every tree file, followed by the arrays at the specified offsets.
+ */
+class TreeFileHeader {
+public:
+  char magic[8];
+  U32 version;
+  U32 reserved;
+  U64 metamerCount;
+  U64 iterations;
+  F32 rootBeginning[3];
+  F32 positionStep;
+  F32 minimumWidth;
+  F32 widthLogStep;
+  U64 deltasOffset;
+  U64 widthsOffset;
+  U64 parentsOffset;
+  U64 axillaryOffset;
+};
+
+static_assert(sizeof(TreeFileHeader) == 88);
+static_assert(std::is_trivially_copyable_v<TreeFileHeader>);
+
+static U64 alignOffset(U64 offset) {
+  return (offset + 7) / 8 * 8;
+}
+
+static Point translateByDelta(Point point, const I16 *delta, float step) {
+  return point.translate(step * delta[0], step * delta[1], step * delta[2]);
+}
+
+static I16 quantizeDelta(float delta, float step) {
+  const auto quantized = std::lround(delta / step);
+  return static_cast<I16>(std::clamp<long>(quantized, std::numeric_limits<I16>::min(), std::numeric_limits<I16>::max()));
+}
+
+template <typename T> static void writeArray(std::ofstream &stream, const std::vector<T> &array, U64 offset) {
+  const auto padding = offset - static_cast<U64>(stream.tellp());
+  for (U64 i = 0; i < padding; i++) {
+    stream.put('\0');
+  }
+  stream.write(reinterpret_cast<const char *>(array.data()), static_cast<std::streamsize>(array.size() * sizeof(T)));
+}
+
+TreeFile::TreeFile(const std::string &filename) : file(filename) {
+  TraceScope traceScope("TreeFile::TreeFile", "io");
+  const auto *data = file.getData();
+  const auto size = file.getSize();
+  TreeFileHeader header{};
+  if (size < sizeof(header)) {
+    throw std::runtime_error(filename + " is not a tree file.");
+  }
+  std::memcpy(&header, data, sizeof(header));
+  const auto fits = [size](U64 offset, U64 bytes, U64 alignment) { return offset % alignment == 0 && offset <= size && bytes <= size - offset; };
+  const auto n = header.metamerCount;
+  const auto valid = std::memcmp(header.magic, TreeFileMagic, sizeof(TreeFileMagic)) == 0 && header.version == TreeFileVersion && n > 0 &&
+                     n < NoParent && fits(header.deltasOffset, 3 * n * sizeof(I16), alignof(I16)) &&
+                     fits(header.widthsOffset, n * sizeof(U16), alignof(U16)) && fits(header.parentsOffset, n * sizeof(U32), alignof(U32)) &&
+                     fits(header.axillaryOffset, n, 1);
+  if (!valid) {
+    throw std::runtime_error(filename + " is not a tree file of version " + std::to_string(TreeFileVersion) + ".");
+  }
+  metamerCount = n;
+  iterations = header.iterations;
+  rootBeginning = Point(header.rootBeginning[0], header.rootBeginning[1], header.rootBeginning[2]);
+  positionStep = header.positionStep;
+  minimumWidth = header.minimumWidth;
+  widthLogStep = header.widthLogStep;
+  deltas = reinterpret_cast<const I16 *>(data + header.deltasOffset);
+  widths = reinterpret_cast<const U16 *>(data + header.widthsOffset);
+  parents = reinterpret_cast<const U32 *>(data + header.parentsOffset);
+  axillary = data + header.axillaryOffset;
+}
+
+void TreeFile::write(const Tree &tree, const std::string &filename) {
+  TraceScope traceScope("TreeFile::write", "io");
+  const auto n = static_cast<U64>(tree.metamers.size());
+  if (n == 0 || n >= NoParent) {
+    throw std::invalid_argument("Tree files hold between one and " + std::to_string(NoParent - 1) + " metamers.");
+  }
+  TreeFileHeader header{};
+  std::memcpy(header.magic, TreeFileMagic, sizeof(TreeFileMagic));
+  header.version = TreeFileVersion;
+  header.metamerCount = n;
+  header.iterations = tree.iterations;
+  const auto &root = *tree.metamers.front();
+  header.rootBeginning[0] = root.beginning.x;
+  header.rootBeginning[1] = root.beginning.y;
+  header.rootBeginning[2] = root.beginning.z;
+  std::vector<U32> parents(n, NoParent);
+  std::vector<U8> axillary(n);
+  auto largestComponent = 0.0f;
+  auto minimumWidth = std::numeric_limits<float>::infinity();
+  auto maximumWidth = 0.0f;
+  for (U64 i = 0; i < n; i++) {
+    const auto &metamer = *tree.metamers[i];
+    if (metamer.axillary) {
+      parents[metamer.axillary->index] = static_cast<U32>(i);
+      axillary[metamer.axillary->index] = 1;
+    }
+    if (metamer.terminal) {
+      parents[metamer.terminal->index] = static_cast<U32>(i);
+    }
+    const Vector vector(metamer.beginning, metamer.end);
+    largestComponent = std::max({largestComponent, std::abs(vector.x), std::abs(vector.y), std::abs(vector.z)});
+    if (metamer.width > 0.0f) {
+      minimumWidth = std::min(minimumWidth, metamer.width);
+      maximumWidth = std::max(maximumWidth, metamer.width);
+    }
+  }
+  header.positionStep = largestComponent > 0.0f ? largestComponent / LargestDelta : 1.0f;
+  header.minimumWidth = maximumWidth > 0.0f ? minimumWidth : 0.0f;
+  header.widthLogStep = maximumWidth > minimumWidth ? std::log(maximumWidth / minimumWidth) / (LargestWidthCode - 1) : 0.0f;
+  // Every end is quantized against the end the reader will decode for its parent, which parents precede.
+  std::vector<Point> decodedEnds(n);
+  std::vector<I16> deltas(3 * n);
+  std::vector<U16> widths(n);
+  for (U64 i = 0; i < n; i++) {
+    const auto &metamer = *tree.metamers[i];
+    const auto beginning = i == 0 ? root.beginning : decodedEnds[parents[i]];
+    auto *delta = deltas.data() + 3 * i;
+    delta[0] = quantizeDelta(metamer.end.x - beginning.x, header.positionStep);
+    delta[1] = quantizeDelta(metamer.end.y - beginning.y, header.positionStep);
+    delta[2] = quantizeDelta(metamer.end.z - beginning.z, header.positionStep);
+    decodedEnds[i] = translateByDelta(beginning, delta, header.positionStep);
+    if (metamer.width > 0.0f) {
+      const auto code = header.widthLogStep > 0.0f ? std::lround(std::log(metamer.width / header.minimumWidth) / header.widthLogStep) : 0;
+      widths[i] = static_cast<U16>(1 + std::clamp<long>(code, 0, LargestWidthCode - 1));
+    }
+  }
+  header.deltasOffset = alignOffset(sizeof(header));
+  header.widthsOffset = alignOffset(header.deltasOffset + deltas.size() * sizeof(I16));
+  header.parentsOffset = alignOffset(header.widthsOffset + widths.size() * sizeof(U16));
+  header.axillaryOffset = alignOffset(header.parentsOffset + parents.size() * sizeof(U32));
+  std::ofstream stream(filename, std::ios::binary | std::ios::trunc);
+  if (stream.fail()) {
+    throw std::runtime_error("Could not open " + filename + ".");
+  }
+  stream.write(reinterpret_cast<const char *>(&header), sizeof(header));
+  writeArray(stream, deltas, header.deltasOffset);
+  writeArray(stream, widths, header.widthsOffset);
+  writeArray(stream, parents, header.parentsOffset);
+  writeArray(stream, axillary, header.axillaryOffset);
+  stream.close();
+  if (stream.fail()) {
+    throw std::runtime_error("Could not write " + filename + ".");
+  }
+}
+
+float TreeFile::decodeWidth(U64 index) const {
+  const auto code = widths[index];
+  return code == 0 ? 0.0f : minimumWidth * std::exp(widthLogStep * (code - 1));
+}
+
+std::vector<MetamerInstance> TreeFile::decodeInstances() const {
+  TraceScope traceScope("TreeFile::decodeInstances", "io");
+  std::vector<MetamerInstance> instances(metamerCount);
+  for (U64 i = 0; i < metamerCount; i++) {
+    const auto parent = parents[i];
+    if ((i == 0) != (parent == NoParent) || (i != 0 && parent >= i)) {
+      throw std::runtime_error("The tree file has a metamer which does not come after its parent.");
+    }
+    auto &instance = instances[i];
+    instance.beginning = i == 0 ? rootBeginning : instances[parent].end;
+    instance.end = translateByDelta(instance.beginning, deltas + 3 * i, positionStep);
+    instance.width = decodeWidth(i);
+  }
+  return instances;
+}
@@ -0,0 +1,56 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "MappedFile.hpp"
+#include "MetamerInstance.hpp"
+#include "Point.hpp"
+#include "Tree.hpp"
+#include "Types.hpp"
+
+/**
+ * A compact tree file, mapped into memory rather than parsed.
+ *
+ * Metamers are stored in creation order, so every metamer comes after its parent, as four arrays:
+ *
+ * - the end of each metamer relative to the end of its parent, where it begins, as three 16-bit multiples of a step;
+ * - the width of each metamer, as a 16-bit logarithmic code, with zero for no width;
+ * - the index of the parent of each metamer, with NoParent for the root;
+ * - whether each metamer is the axillary (one) or the terminal (zero) child of its parent.
+ *
+ * Ends are quantized relative to the decoded end of the parent, so errors do not add up along branches. That is 13 bytes
+ * per metamer, and all arrays are little-endian and aligned, so they are used in place once mapped.
+ */
+class TreeFile {
+  const MappedFile file;
+
+public:
+  static constexpr U32 NoParent = 0xFFFFFFFF;
+
+  U64 metamerCount{};
+  U64 iterations{};
+  Point rootBeginning{};
+  F32 positionStep{};
+  F32 minimumWidth{};
+  F32 widthLogStep{};
+
+  const I16 *deltas = nullptr;
+  const U16 *widths = nullptr;
+  const U32 *parents = nullptr;
+  const U8 *axillary = nullptr;
+
+  /**
+   * Maps the file, checking that it is a tree file whose arrays fit in it.
+   */
+  explicit TreeFile(const std::string &filename);
+
+  static void write(const Tree &tree, const std::string &filename);
+
+  float decodeWidth(U64 index) const;
+
+  /**
+   * Decodes every metamer, in creation order, resolving ends through the parents.
+   */
+  std::vector<MetamerInstance> decodeInstances() const;
+};
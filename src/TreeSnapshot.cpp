@@ -0,0 +1,42 @@
+#include "TreeSnapshot.hpp"
+
+#include <utility>
+
+#include "Trace.hpp"
+#include "TubeMeshBuilder.hpp"
+
+TreeSnapshot::TreeSnapshot(const Tree &tree, const TreeSnapshot *previous, bool includeTubeMesh)
+    : treeId(tree.id), iterations(tree.iterations), boundingBox(tree.getBoundingBox()), widthChanges(tree.widthChanges) {
+  TraceScope traceScope("TreeSnapshot::TreeSnapshot", "simulation");
+  U64 unchanged = 0;
+  if (previous && previous->treeId == tree.id && previous->iterations + 1 == tree.iterations) {
+    instances.reserve(tree.metamers.size());
+    instances.assign(previous->instances.begin(), previous->instances.end());
+    for (const auto index : widthChanges) {
+      instances[index].width = tree.metamers[index]->width;
+    }
+    unchanged = instances.size();
+  }
+  instances.resize(tree.metamers.size());
+  for (auto i = unchanged; i < tree.metamers.size(); i++) {
+    const auto &metamer = *tree.metamers[i];
+    instances[i] = MetamerInstance{metamer.beginning, metamer.end, metamer.width};
+  }
+  if (includeTubeMesh) {
+    tubeMesh = TubeMeshBuilder().build(tree);
+  }
+}
+
+TreeSnapshot::TreeSnapshot(U64 iterations, std::vector<MetamerInstance> instances) : iterations(iterations), instances(std::move(instances)) {
+  for (const auto &instance : this->instances) {
+    boundingBox.include(instance.beginning);
+    boundingBox.include(instance.end);
+  }
+}
+
+TreeSnapshot::TreeSnapshot(const TreeFile &treeFile) : TreeSnapshot(treeFile.iterations, treeFile.decodeInstances()) {
+}
+
+U64 TreeSnapshot::countMetamers() const {
+  return instances.size();
+}
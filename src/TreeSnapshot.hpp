@@ -0,0 +1,50 @@
+#pragma once
+
+#include <optional>
+#include <vector>
+
+#include "BoundingBox.hpp"
+#include "Mesh.hpp"
+#include "MetamerInstance.hpp"
+#include "Tree.hpp"
+#include "TreeFile.hpp"
+#include "Types.hpp"
+
+/**
+ * The geometry of a tree after a growth iteration, which a renderer can draw while the tree keeps growing.
+ *
+ * Snapshots are immutable once made, so they can be shared between the simulation and the render threads.
+ */
+class TreeSnapshot {
+public:
+  U64 treeId{};
+  U64 iterations{};
+  BoundingBox boundingBox{};
+
+  // One instance per metamer, in creation order.
+  std::vector<MetamerInstance> instances;
+
+  // The indices of the instances which existed before the last growth iteration and had their width changed by it.
+  std::vector<U64> widthChanges;
+
+  // The tree as one tube per axis, if it was requested.
+  std::optional<Mesh> tubeMesh;
+
+  /**
+   * Captures the tree.
+   *
+   * If the previous snapshot is of the same tree one growth iteration earlier, its instances are updated with what that
+   * iteration changed rather than captured again.
+   */
+  TreeSnapshot(const Tree &tree, const TreeSnapshot *previous, bool includeTubeMesh);
+
+  /**
+   * Captures metamers which were not grown by this process, such as those of a tree file or a growth log. The
+   * identifier is zero, which no tree of this process has.
+   */
+  TreeSnapshot(U64 iterations, std::vector<MetamerInstance> instances);
+
+  explicit TreeSnapshot(const TreeFile &treeFile);
+
+  U64 countMetamers() const;
+};
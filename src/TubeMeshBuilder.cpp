@@ -0,0 +1,127 @@
+#include "TubeMeshBuilder.hpp"
+
+#include <cmath>
+
+static Vector getAnyPerpendicular(Vector vector) {
+  // Crossing with the axis the vector is least aligned with is numerically safe.
+  const auto ax = std::abs(vector.x);
+  const auto ay = std::abs(vector.y);
+  const auto az = std::abs(vector.z);
+  if (ax <= ay && ax <= az) {
+    return vector.cross(Vector(1.0f, 0.0f, 0.0f)).normalize();
+  }
+  if (ay <= az) {
+    return vector.cross(Vector(0.0f, 1.0f, 0.0f)).normalize();
+  }
+  return vector.cross(Vector(0.0f, 0.0f, 1.0f)).normalize();
+}
+
+/**
+ * Moves the reference vector of the previous ring to the plane of the next ring, so that the rings do not twist.
+ */
+static Vector transportReference(Vector u, Vector tangent) {
+  const auto projected = u.add(tangent.scale(-u.dot(tangent)));
+  if (projected.evaluateNorm() < 1.0e-6f) {
+    return getAnyPerpendicular(tangent);
+  }
+  return projected.normalize();
+}
+
+static Point translate(Point point, Vector vector) {
+  return point.translate(vector.x, vector.y, vector.z);
+}
+
+static Vector getRingDirection(Vector u, Vector v, U32 i, U32 ringVertices) {
+  const auto theta = 2.0f * 4.0f * std::atan(1.0f) / ringVertices * i;
+  return u.scale(std::cos(theta)).add(v.scale(std::sin(theta)));
+}
+
+Mesh TubeMeshBuilder::build(const Tree &tree) const {
+  Mesh mesh;
+  if (!tree.root) {
+    return mesh;
+  }
+  // Every axis is built on its own, so an explicit stack avoids recursing through the whole tree.
+  std::vector<const Metamer *> axisStarts{tree.root.get()};
+  std::vector<const Metamer *> axis;
+  while (!axisStarts.empty()) {
+    axis.clear();
+    for (const Metamer *metamer = axisStarts.back(); metamer != nullptr; metamer = metamer->terminal.get()) {
+      axis.push_back(metamer);
+    }
+    axisStarts.pop_back();
+    for (const auto metamer : axis) {
+      if (metamer->axillary) {
+        axisStarts.push_back(metamer->axillary.get());
+      }
+    }
+    addAxis(mesh, axis);
+  }
+  return mesh;
+}
+
+void TubeMeshBuilder::addAxis(Mesh &mesh, const std::vector<const Metamer *> &axis) const {
+  std::vector<Vector> directions;
+  for (const auto metamer : axis) {
+    const Vector direction(metamer->beginning, metamer->end);
+    if (direction.evaluateNorm() > 0.0f) {
+      directions.push_back(direction.normalize());
+    } else {
+      directions.push_back(directions.empty() ? Vector(0.0f, 1.0f, 0.0f) : directions.back());
+    }
+  }
+  auto u = getAnyPerpendicular(directions.front());
+  addCap(mesh, axis.front()->beginning, directions.front().scale(-1.0f), u, axis.front()->width);
+  const auto firstSideVertex = static_cast<U32>(mesh.vertices.size());
+  // One ring at the beginning of each metamer and one at the end of the axis.
+  for (std::size_t i = 0; i <= axis.size(); i++) {
+    auto tangent = i < axis.size() ? directions[i] : directions.back();
+    if (i > 0 && i < axis.size()) {
+      // Rings between metamers are perpendicular to the bisector of their directions.
+      const auto bisector = directions[i - 1].add(directions[i]);
+      if (bisector.evaluateNorm() > 1.0e-6f) {
+        tangent = bisector.normalize();
+      }
+    }
+    u = transportReference(u, tangent);
+    const auto center = i < axis.size() ? axis[i]->beginning : axis.back()->end;
+    addRing(mesh, center, tangent, u, axis[std::min(i, axis.size() - 1)]->width);
+  }
+  for (std::size_t i = 0; i < axis.size(); i++) {
+    const auto a = firstSideVertex + static_cast<U32>(i) * ringVertices;
+    const auto b = a + ringVertices;
+    for (U32 j = 0; j < ringVertices; j++) {
+      const auto k = (j + 1) % ringVertices;
+      mesh.indices.insert(std::end(mesh.indices), {a + j, a + k, b + k, b + k, b + j, a + j});
+    }
+  }
+  addCap(mesh, axis.back()->end, directions.back(), u, axis.back()->width);
+}
+
+U64 TubeMeshBuilder::countAxisVertices(U64 axisMetamers) const {
+  // Two caps, with a center each, and one ring more than there are metamers.
+  return 2 * (ringVertices + 1) + (axisMetamers + 1) * ringVertices;
+}
+
+U64 TubeMeshBuilder::countAxisIndices(U64 axisMetamers) const {
+  return 2 * 3 * ringVertices + axisMetamers * 6 * ringVertices;
+}
+
+void TubeMeshBuilder::addRing(Mesh &mesh, Point center, Vector tangent, Vector u, float radius) const {
+  const auto v = tangent.cross(u);
+  for (U32 i = 0; i < ringVertices; i++) {
+    const auto direction = getRingDirection(u, v, i, ringVertices);
+    mesh.vertices.push_back(Vertex{translate(center, direction.scale(radius)), direction});
+  }
+}
+
+void TubeMeshBuilder::addCap(Mesh &mesh, Point center, Vector normal, Vector u, float radius) const {
+  const auto v = normal.cross(u);
+  const auto centerIndex = static_cast<U32>(mesh.vertices.size());
+  mesh.vertices.push_back(Vertex{center, normal});
+  for (U32 i = 0; i < ringVertices; i++) {
+    const auto direction = getRingDirection(u, v, i, ringVertices);
+    mesh.vertices.push_back(Vertex{translate(center, direction.scale(radius)), normal});
+    mesh.indices.insert(std::end(mesh.indices), {centerIndex, centerIndex + 1 + i, centerIndex + 1 + (i + 1) % ringVertices});
+  }
+}
@@ -0,0 +1,38 @@
+#pragma once
+
+#include <vector>
+
+#include "Mesh.hpp"
+#include "Metamer.hpp"
+#include "Tree.hpp"
+#include "Types.hpp"
+
+/**
+ * Builds a single mesh for a tree, with one generalized cylinder (a tube) per axis.
+ *
+ * An axis starts at the root or at an axillary metamer and follows the terminal links. Consecutive metamers of an axis
+ * share the ring of vertices between them, so there are no internal caps or doubled seams. The radius of the tube is
+ * interpolated between the widths of consecutive metamers.
+ */
+class TubeMeshBuilder {
+public:
+  // The number of vertices around each ring.
+  U32 ringVertices = 16;
+
+  Mesh build(const Tree &tree) const;
+
+  /**
+   * Appends the tube of an axis, the metamers from its first one along the terminal links.
+   */
+  void addAxis(Mesh &mesh, const std::vector<const Metamer *> &axis) const;
+
+  U64 countAxisVertices(U64 axisMetamers) const;
+
+  U64 countAxisIndices(U64 axisMetamers) const;
+
+private:
+
+  void addRing(Mesh &mesh, Point center, Vector tangent, Vector u, float radius) const;
+
+  void addCap(Mesh &mesh, Point center, Vector normal, Vector u, float radius) const;
+};
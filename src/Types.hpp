@@ -3,9 +3,14 @@
 #include <cstdint>
 #include <limits>
 
+using U8 = uint8_t;
+using U16 = uint16_t;
 using U32 = uint32_t;
 using U64 = uint64_t;
 
+using I16 = int16_t;
+using I32 = int32_t;
+
 using F32 = float;
 using F64 = double;
 
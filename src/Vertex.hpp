@@ -1,8 +1,12 @@
 #pragma once
 
 #include "Point.hpp"
+#include "Vector.hpp"
 
 class Vertex {
 public:
   Point position;
+  Vector normal;
 };
+
+static_assert(sizeof(Vertex) == 6 * sizeof(float));
@@ -0,0 +1,24 @@
+#include "VideoSink.hpp"
+
+#include <array>
+#include <stdexcept>
+
+VideoSink::VideoSink(const std::string &filename, U32 width, U32 height, double framesPerSecond) {
+  const std::array<std::string, 2> codecs = {"FFV1", "MJPG"};
+  for (const auto &candidate : codecs) {
+    const auto fourcc = cv::VideoWriter::fourcc(candidate[0], candidate[1], candidate[2], candidate[3]);
+    if (writer.open(filename, fourcc, framesPerSecond, cv::Size(width, height))) {
+      codec = candidate;
+      return;
+    }
+  }
+  throw std::runtime_error("Could not open " + filename + " for writing with any of the FFV1 or MJPG codecs.");
+}
+
+const std::string &VideoSink::getCodec() const {
+  return codec;
+}
+
+void VideoSink::write(const Image &image) {
+  writer.write(image.getMat());
+}
@@ -0,0 +1,28 @@
+#pragma once
+
+#include <string>
+
+#include <opencv2/videoio.hpp>
+
+#include "Image.hpp"
+#include "Types.hpp"
+
+/**
+ * Appends frames to a single video container instead of writing one image file per frame.
+ *
+ * The first codec which OpenCV can open for the filename is used: lossless FFV1, then MJPG.
+ */
+class VideoSink {
+  cv::VideoWriter writer;
+  std::string codec;
+
+public:
+  VideoSink(const std::string &filename, U32 width, U32 height, double framesPerSecond);
+
+  const std::string &getCodec() const;
+
+  /**
+   * Appends a frame, which must have the size specified at construction.
+   */
+  void write(const Image &image);
+};